@@ -6,7 +6,9 @@ inline ellipsoid_t *ellipsoid_create( const double x, const double y, const doub
 	e->radii.x = x, e->radii.y = y; e->radii.z = z;
 	vec3d_mul( &e->radii, &e->radii, &e->radii_squared );
 	vec3d_mul( &e->radii_squared, &e->radii_squared, &e->radii_to_the_fourth );
-	vec3d_div_s( &e->radii_squared, 1.0, &e->one_over_radii_squared );
+	e->one_over_radii_squared.x = 1.0 / e->radii_squared.x;
+	e->one_over_radii_squared.y = 1.0 / e->radii_squared.y;
+	e->one_over_radii_squared.z = 1.0 / e->radii_squared.z;
 	return e;
 }
 
@@ -92,16 +94,10 @@ unsigned int Intersections(
 	return 2;
 }
 
-// @todo convert an array of cartesian positions to geodetic
-/*public ICollection<Geodetic3D> ToGeodetic3D(IEnumerable<Vector3D> positions) {
-	IList<Geodetic3D> geodetics = new List<Geodetic3D>(CollectionAlgorithms.EnumerableCount(positions));
-	foreach (Vector3D position in positions)
-	geodetics.Add(ToGeodetic3D(position));
-	return geodetics;
-}*/
+// Arrays of cartesian positions are converted to geodetic by ellipsoid_cartesian_to_geodetic, see ellipsoid_batch.h
 
 vec3d *ScaleToGeodeticSurface( const vec3d *const position, const ellipsoid_t *const e, vec3d *scaled_pos ) {
-	double beta = 1.0f / sqrt(
+	double beta = 1.0 / sqrt(
 			position->x * position->x * e->one_over_radii_squared.x +
 			position->y * position->y * e->one_over_radii_squared.y +
 			position->z * position->z * e->one_over_radii_squared.z );
@@ -111,7 +107,7 @@ vec3d *ScaleToGeodeticSurface( const vec3d *const position, const ellipsoid_t *c
 			beta * position->z * e->one_over_radii_squared.z
 	};
 	double n = vec3d_magnitude(&temp);
-	double alpha = (1.0f-beta) * ( vec3d_magnitude(position) / n );
+	double alpha = (1.0-beta) * ( vec3d_magnitude(position) / n );
 	double x2 = position->x * position->x;
 	double y2 = position->y * position->y;
 	double z2 = position->z * position->z;
@@ -120,25 +116,26 @@ vec3d *ScaleToGeodeticSurface( const vec3d *const position, const ellipsoid_t *c
 	double dc = 0.0;
 	double s = 0.0;
 	double dSdA = 1.0;
+	unsigned iterations = 0;
 	do {
 		alpha -= (s / dSdA);
-		da = 1.0f + (alpha * e->one_over_radii_squared.x);
-		db = 1.0f + (alpha * e->one_over_radii_squared.y);
-		dc = 1.0f + (alpha * e->one_over_radii_squared.z);
+		da = 1.0 + (alpha * e->one_over_radii_squared.x);
+		db = 1.0 + (alpha * e->one_over_radii_squared.y);
+		dc = 1.0 + (alpha * e->one_over_radii_squared.z);
 		double da2 = da * da;
 		double db2 = db * db;
 		double dc2 = dc * dc;
 		double da3 = da * da2;
 		double db3 = db * db2;
 		double dc3 = dc * dc2;
-		s = x2/(e->radii_squared.x*da2) + y2/(e->radii_squared.y*db2) + z2/(e->radii_squared.z*dc2) - 1.0f;
-		dSdA = -2.0f * (
+		s = x2/(e->radii_squared.x*da2) + y2/(e->radii_squared.y*db2) + z2/(e->radii_squared.z*dc2) - 1.0;
+		dSdA = -2.0 * (
 				x2/(e->radii_to_the_fourth.x*da3) +
 				y2/(e->radii_to_the_fourth.y*db3) +
 				z2/(e->radii_to_the_fourth.z*dc3)
 		);
 	}
-	while( fabs(s) > 1e-10 );
+	while( fabs(s) > 1e-10 && ++iterations < ELLIPSOID_MAX_ITERATIONS );
 	scaled_pos->x = position->x / da;
 	scaled_pos->y = position->y / db;
 	scaled_pos->z = position->z / dc;
@@ -156,16 +153,16 @@ geodetic_t *ToGeodetic3D( const vec3d *const position, const ellipsoid_t *const
 	vec3d p, h, n;
 	ScaleToGeodeticSurface( position, e, &p );
 	vec3d_sub( position, &p, &h );
-	double height = ( vec3d_dot( &h, position ) < 0.0f ? -1.0f : 1.0f ) * vec3d_magnitude(&h);
+	double height = ( vec3d_dot( &h, position ) < 0.0 ? -1.0 : 1.0 ) * vec3d_magnitude(&h);
 	GeodeticSurfaceNormal( &p, e, &n );
-	geo->lon = atan2( n.y, n.x );
-	geo->lat = asin( n.z / vec3d_magnitude(&n) );
+	geo->lon = degreesd( atan2( n.y, n.x ) );
+	geo->lat = degreesd( asin( n.z / vec3d_magnitude(&n) ) );
 	geo->height = height;
 	return geo;
 }
 
 inline vec3d *ScaleToGeocentricSurface( const vec3d *const position, const ellipsoid_t *const e, vec3d *scaled ) {
-	double beta = 1.0f / sqrt(
+	double beta = 1.0 / sqrt(
 			position->x * position->x * e->one_over_radii_squared.x +
 			position->y * position->y * e->one_over_radii_squared.y +
 			position->z * position->z * e->one_over_radii_squared.z );
@@ -173,6 +170,13 @@ inline vec3d *ScaleToGeocentricSurface( const vec3d *const position, const ellip
 	return scaled;
 }
 
+vec2d *ellipsoid_compute_tex_coord( const vec3d *const normal, const ellipsoid_t *const e, vec2d *tc ) {
+	(void)e;
+	tc->x = atan2( normal->y, normal->x ) * ONE_OVER_TWO_PI + 0.5;
+	tc->y = asin( normal->z ) * ONE_OVER_PI + 0.5;
+	return tc;
+}
+
 // granularity must be > 0.0
 /*void ComputeCurve( const vec3d *const start, const vec3d *const stop, const double granularity ) {
 	vec3d normal, temp;
@@ -20,6 +20,9 @@
 #include "vec3.h"
 #include "vec2.h"
 
+// Newton steps of ScaleToGeodeticSurface at most, e.g. for positions near the center
+#define ELLIPSOID_MAX_ITERATIONS 16
+
 typedef struct ellipsoid_t {
 	vec3d position;
 	vec3d radii;
@@ -57,12 +60,12 @@ unsigned int Intersections(
 		const vec3d *const origin, const vec3d *const direction,
 		const ellipsoid_t *const e, double *intersections[2] );
 
-// Cartesian to geodetic conversion
+// Cartesian to geodetic conversion, lon/lat in degrees like ellipsoid_to_cartesian takes them
 geodetic_t *ToGeodetic3D( const vec3d *const position, const ellipsoid_t *const e, geodetic_t *geo );
 
 /* Determine surface point of a cartesian coordinate along its geodetic normal. Iterative, should
- * converge quickly (1-4 iterations). Could take several iterations for mor oblate ellipsoids.
- * Assumes the ellipsoid is centered at the origin. */
+ * converge quickly (1-4 iterations). Could take several iterations for mor oblate ellipsoids,
+ * stops after ELLIPSOID_MAX_ITERATIONS. Assumes the ellipsoid is centered at the origin. */
 extern vec3d *ScaleToGeodeticSurface( const vec3d *const position, const ellipsoid_t *const e, vec3d *scaled_pos );
 
 /* Determine surface point of a cartesian coordinate along its geocentric normal.
@@ -0,0 +1,248 @@
+#include "ellipsoid_batch.h"
+#include <stdlib.h>
+#include <tgmath.h>
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#endif
+
+/* The surface point along the geodetic normal n = ( cos lat cos lon, cos lat sin lon, sin lat ) is
+ * radii_squared * n / gamma with gamma = sqrt( n . ( radii_squared * n ) ), see ellipsoid_to_cartesian.
+ * gamma^2 = cos^2 lat * ( rx^2 cos^2 lon + ry^2 sin^2 lon ) + rz^2 sin^2 lat, the part in brackets
+ * is kept per column as q. */
+static void column_post( const ellipsoid_columns_t *const t, const size_t c, const double cos_lat, const double sin_lat,
+		const double rz2_sin2_lat, const double height, const ellipsoid_t *const e, double *x, double *y, double *z ) {
+	const double inv_gamma = 1.0 / sqrt( cos_lat * cos_lat * t->q[c] + rz2_sin2_lat );
+	*x = cos_lat * t->cos_lon[c] * ( e->radii_squared.x * inv_gamma + height );
+	*y = cos_lat * t->sin_lon[c] * ( e->radii_squared.y * inv_gamma + height );
+	*z = sin_lat * ( e->radii_squared.z * inv_gamma + height );
+}
+
+#if defined(__AVX2__) && defined(__FMA__)
+// 4 posts from c on
+static inline __m256d load_heights( const uint16_t *const row, const size_t c ) {
+	if( !row )
+		return _mm256_setzero_pd();
+	const __m128i h = _mm_loadl_epi64( (const __m128i *)( row + c ) );
+	return _mm256_cvtepi32_pd( _mm_cvtepu16_epi32( h ) );
+}
+
+static void row_to_cartesian( const ellipsoid_columns_t *const t, const size_t num_columns, const double cos_lat,
+		const double sin_lat, const uint16_t *const heights, const ellipsoid_t *const e,
+		double *x, double *y, double *z ) {
+	const double rz2_sin2_lat = e->radii_squared.z * sin_lat * sin_lat;
+	const __m256d vcos_lat = _mm256_set1_pd( cos_lat );
+	const __m256d vcos2_lat = _mm256_set1_pd( cos_lat * cos_lat );
+	const __m256d vsin_lat = _mm256_set1_pd( sin_lat );
+	const __m256d vrz2_sin2_lat = _mm256_set1_pd( rz2_sin2_lat );
+	const __m256d rx2 = _mm256_set1_pd( e->radii_squared.x );
+	const __m256d ry2 = _mm256_set1_pd( e->radii_squared.y );
+	const __m256d rz2 = _mm256_set1_pd( e->radii_squared.z );
+	const __m256d one = _mm256_set1_pd( 1.0 );
+	size_t c = 0;
+	for( ; c + 4 <= num_columns; c += 4 ) {
+		const __m256d gamma2 = _mm256_fmadd_pd( vcos2_lat, _mm256_loadu_pd( t->q + c ), vrz2_sin2_lat );
+		const __m256d inv_gamma = _mm256_div_pd( one, _mm256_sqrt_pd( gamma2 ) );
+		const __m256d h = load_heights( heights, c );
+		const __m256d nx = _mm256_mul_pd( vcos_lat, _mm256_loadu_pd( t->cos_lon + c ) );
+		const __m256d ny = _mm256_mul_pd( vcos_lat, _mm256_loadu_pd( t->sin_lon + c ) );
+		_mm256_storeu_pd( x + c, _mm256_mul_pd( nx, _mm256_fmadd_pd( rx2, inv_gamma, h ) ) );
+		_mm256_storeu_pd( y + c, _mm256_mul_pd( ny, _mm256_fmadd_pd( ry2, inv_gamma, h ) ) );
+		_mm256_storeu_pd( z + c, _mm256_mul_pd( vsin_lat, _mm256_fmadd_pd( rz2, inv_gamma, h ) ) );
+	}
+	for( ; c < num_columns; ++c )
+		column_post( t, c, cos_lat, sin_lat, rz2_sin2_lat, heights ? heights[c] : 0.0, e, &x[c], &y[c], &z[c] );
+}
+#else
+static void row_to_cartesian( const ellipsoid_columns_t *const t, const size_t num_columns, const double cos_lat,
+		const double sin_lat, const uint16_t *const heights, const ellipsoid_t *const e,
+		double *x, double *y, double *z ) {
+	const double rz2_sin2_lat = e->radii_squared.z * sin_lat * sin_lat;
+	for( size_t c = 0; c < num_columns; ++c )
+		column_post( t, c, cos_lat, sin_lat, rz2_sin2_lat, heights ? heights[c] : 0.0, e, &x[c], &y[c], &z[c] );
+}
+#endif
+
+bool ellipsoid_columns_create( const uint32_t num_columns, ellipsoid_columns_t *columns ) {
+	double *const memory = malloc( 3 * (size_t)( num_columns > 0 ? num_columns : 1 ) * sizeof(double) );
+	if( !memory ) {
+		*columns = (ellipsoid_columns_t){ 0 };
+		return false;
+	}
+	*columns = (ellipsoid_columns_t){ memory, memory + num_columns, memory + 2 * (size_t)num_columns, num_columns, memory };
+	return true;
+}
+
+void ellipsoid_columns_fill( const geodetic_grid_t *const grid, const ellipsoid_t *const e,
+		ellipsoid_columns_t *columns ) {
+	for( size_t c = 0; c < grid->num_columns; ++c ) {
+		const double lon = radiansd( grid->lon + (double)c * grid->lon_step );
+		columns->cos_lon[c] = cos( lon );
+		columns->sin_lon[c] = sin( lon );
+		columns->q[c] = e->radii_squared.x * columns->cos_lon[c] * columns->cos_lon[c] +
+				e->radii_squared.y * columns->sin_lon[c] * columns->sin_lon[c];
+	}
+}
+
+void ellipsoid_columns_destroy( ellipsoid_columns_t *columns ) {
+	free( columns->memory );
+	*columns = (ellipsoid_columns_t){ 0 };
+}
+
+ellipsoid_columns_t *ellipsoid_columns_view( const ellipsoid_columns_t *const columns, const uint32_t first,
+		const uint32_t num_columns, ellipsoid_columns_t *view ) {
+	*view = (ellipsoid_columns_t){
+			columns->cos_lon + first, columns->sin_lon + first, columns->q + first, num_columns, NULL
+	};
+	return view;
+}
+
+void ellipsoid_grid_to_cartesian_columns( const geodetic_grid_t *const grid,
+		const ellipsoid_columns_t *const columns, const uint16_t *const heights, const size_t height_stride,
+		const ellipsoid_t *const e, vec3d_soa_t *out ) {
+	const size_t num_columns = grid->num_columns;
+	for( uint32_t r = 0; r < grid->num_rows; ++r ) {
+		const double lat = radiansd( grid->lat + (double)r * grid->lat_step );
+		const size_t first = (size_t)r * num_columns;
+		row_to_cartesian( columns, num_columns, cos( lat ), sin( lat ), heights ? heights + r * height_stride : NULL, e,
+				out->x + first, out->y + first, out->z + first );
+	}
+}
+
+bool ellipsoid_grid_to_cartesian( const geodetic_grid_t *const grid, const uint16_t *const heights,
+		const size_t height_stride, const ellipsoid_t *const e, vec3d_soa_t *out ) {
+	ellipsoid_columns_t columns;
+	if( !ellipsoid_columns_create( grid->num_columns, &columns ) )
+		return false;
+	ellipsoid_columns_fill( grid, e, &columns );
+	ellipsoid_grid_to_cartesian_columns( grid, &columns, heights, height_stride, e, out );
+	ellipsoid_columns_destroy( &columns );
+	return true;
+}
+
+/* H. Vermeille, Direct transformation from geocentric coordinates to geodetic coordinates,
+ * J Geod 2002. With a2 the squared equatorial radius and e2 the squared eccentricity, per position:
+ *   p = ( x^2 + y^2 ) / a2, q = ( 1 - e2 ) / a2 * z^2, r = ( p + q - e2^2 ) / 6,
+ *   s = e2^2 * p * q / ( 4 r^3 ), t = cbrt( 1 + s + sqrt( s ( 2 + s ) ) ), u = r ( 1 + t + 1 / t ),
+ *   v = sqrt( u^2 + e2^2 q ), w = e2 ( u + v - q ) / ( 2 v ), k = sqrt( u + v + w^2 ) - w,
+ *   d = k sqrt( x^2 + y^2 ) / ( k + e2 ), lat = atan2( z, d ), height = ( k + e2 - 1 ) / k * sqrt( d^2 + z^2 )
+ * The cube root's argument is in [1, 8] for positions farther than a few hundred km from the
+ * center; it starts from the chord and takes 3 Halley steps. Closer positions, and those with
+ * r <= 0 where the cubic has no usable root, are left to the fallback. d goes to lat until the
+ * angles are taken, the height of a position left over is NAN. */
+#define CUBE_ROOT_MAX 8.0
+
+static inline double cube_root( const double x ) {
+	double t = 1.0 + ( x - 1.0 ) / 7.0;
+	for( unsigned i = 0; i < 3; ++i ) {
+		const double t3 = t * t * t;
+		t *= ( t3 + 2.0 * x ) / ( 2.0 * t3 + x );
+	}
+	return t;
+}
+
+static inline bool vermeille( const double x, const double y, const double z, const double a2, const double e2,
+		double *d, double *height ) {
+	const double e4 = e2 * e2;
+	const double xy2 = x * x + y * y;
+	const double p = xy2 / a2;
+	const double q = ( 1.0 - e2 ) / a2 * z * z;
+	const double r = ( p + q - e4 ) / 6.0;
+	const double s = e4 * p * q / ( 4.0 * r * r * r );
+	const double c = 1.0 + s + sqrt( s * ( 2.0 + s ) );
+	if( !( r > 0.0 && c <= CUBE_ROOT_MAX ) ) {
+		*height = NAN;
+		return false;
+	}
+	const double t = cube_root( c );
+	const double u = r * ( 1.0 + t + 1.0 / t );
+	const double v = sqrt( u * u + e4 * q );
+	const double w = e2 * ( u + v - q ) / ( 2.0 * v );
+	const double k = sqrt( u + v + w * w ) - w;
+	*d = k * sqrt( xy2 ) / ( k + e2 );
+	*height = ( k + e2 - 1.0 ) / k * sqrt( *d * *d + z * z );
+	return true;
+}
+
+#if defined(__AVX2__) && defined(__FMA__)
+// The same for 4 positions, returns the mask of the solved ones
+static inline int vermeille_4( const __m256d x, const __m256d y, const __m256d z, const double a2, const double e2,
+		double *d, double *height ) {
+	const __m256d one = _mm256_set1_pd( 1.0 );
+	const __m256d two = _mm256_set1_pd( 2.0 );
+	const __m256d ve2 = _mm256_set1_pd( e2 );
+	const __m256d e4 = _mm256_set1_pd( e2 * e2 );
+	const __m256d xy2 = _mm256_fmadd_pd( x, x, _mm256_mul_pd( y, y ) );
+	const __m256d p = _mm256_mul_pd( xy2, _mm256_set1_pd( 1.0 / a2 ) );
+	const __m256d q = _mm256_mul_pd( _mm256_set1_pd( ( 1.0 - e2 ) / a2 ), _mm256_mul_pd( z, z ) );
+	const __m256d r = _mm256_mul_pd( _mm256_sub_pd( _mm256_add_pd( p, q ), e4 ), _mm256_set1_pd( 1.0 / 6.0 ) );
+	const __m256d r3 = _mm256_mul_pd( _mm256_mul_pd( r, r ), _mm256_mul_pd( _mm256_set1_pd( 4.0 ), r ) );
+	const __m256d s = _mm256_div_pd( _mm256_mul_pd( e4, _mm256_mul_pd( p, q ) ), r3 );
+	const __m256d c = _mm256_add_pd( _mm256_add_pd( one, s ), _mm256_sqrt_pd( _mm256_mul_pd( s, _mm256_add_pd( two, s ) ) ) );
+	const __m256d solved = _mm256_and_pd( _mm256_cmp_pd( r, _mm256_setzero_pd(), _CMP_GT_OQ ),
+			_mm256_cmp_pd( c, _mm256_set1_pd( CUBE_ROOT_MAX ), _CMP_LE_OQ ) );
+	__m256d t = _mm256_fmadd_pd( _mm256_sub_pd( c, one ), _mm256_set1_pd( 1.0 / 7.0 ), one );
+	for( unsigned i = 0; i < 3; ++i ) {
+		const __m256d t3 = _mm256_mul_pd( _mm256_mul_pd( t, t ), t );
+		t = _mm256_mul_pd( t, _mm256_div_pd( _mm256_fmadd_pd( two, c, t3 ), _mm256_fmadd_pd( two, t3, c ) ) );
+	}
+	const __m256d u = _mm256_mul_pd( r, _mm256_add_pd( _mm256_add_pd( one, t ), _mm256_div_pd( one, t ) ) );
+	const __m256d v = _mm256_sqrt_pd( _mm256_fmadd_pd( u, u, _mm256_mul_pd( e4, q ) ) );
+	const __m256d w = _mm256_div_pd( _mm256_mul_pd( ve2, _mm256_sub_pd( _mm256_add_pd( u, v ), q ) ),
+			_mm256_mul_pd( two, v ) );
+	const __m256d k = _mm256_sub_pd( _mm256_sqrt_pd( _mm256_fmadd_pd( w, w, _mm256_add_pd( u, v ) ) ), w );
+	const __m256d vd = _mm256_div_pd( _mm256_mul_pd( k, _mm256_sqrt_pd( xy2 ) ), _mm256_add_pd( k, ve2 ) );
+	const __m256d h = _mm256_mul_pd( _mm256_div_pd( _mm256_sub_pd( _mm256_add_pd( k, ve2 ), one ), k ),
+			_mm256_sqrt_pd( _mm256_fmadd_pd( vd, vd, _mm256_mul_pd( z, z ) ) ) );
+	_mm256_storeu_pd( d, vd );
+	_mm256_storeu_pd( height, _mm256_blendv_pd( _mm256_set1_pd( NAN ), h, solved ) );
+	return _mm256_movemask_pd( solved );
+}
+
+// Solves what it can of count positions, returns how many
+static size_t solve_oblate( const vec3d_soa_t *const in, const size_t count, const double a2, const double e2,
+		geodetic_soa_t *out ) {
+	size_t num_solved = 0;
+	size_t i = 0;
+	for( ; i + 4 <= count; i += 4 ) {
+		const int mask = vermeille_4( _mm256_loadu_pd( in->x + i ), _mm256_loadu_pd( in->y + i ),
+				_mm256_loadu_pd( in->z + i ), a2, e2, out->lat + i, out->height + i );
+		num_solved += (size_t)__builtin_popcount( (unsigned)mask );
+	}
+	for( ; i < count; ++i )
+		num_solved += vermeille( in->x[i], in->y[i], in->z[i], a2, e2, &out->lat[i], &out->height[i] );
+	return num_solved;
+}
+#else
+static size_t solve_oblate( const vec3d_soa_t *const in, const size_t count, const double a2, const double e2,
+		geodetic_soa_t *out ) {
+	size_t num_solved = 0;
+	for( size_t i = 0; i < count; ++i )
+		num_solved += vermeille( in->x[i], in->y[i], in->z[i], a2, e2, &out->lat[i], &out->height[i] );
+	return num_solved;
+}
+#endif
+
+size_t ellipsoid_cartesian_to_geodetic( const vec3d_soa_t *const in, const size_t count,
+		const ellipsoid_t *const e, geodetic_soa_t *out ) {
+	const double to_degrees = 180.0 / PI;
+	const bool oblate = e->radii.x == e->radii.y;
+	size_t num_solved = 0;
+	if( oblate ) {
+		num_solved = solve_oblate( in, count, e->radii_squared.x, 1.0 - e->radii_squared.z / e->radii_squared.x, out );
+		for( size_t i = 0; i < count; ++i ) {
+			out->lon[i] = atan2( in->y[i], in->x[i] ) * to_degrees;
+			out->lat[i] = atan2( in->z[i], out->lat[i] ) * to_degrees;
+		}
+	}
+	for( size_t i = 0; num_solved < count && i < count; ++i ) {
+		if( oblate && !isnan( out->height[i] ) )
+			continue;
+		const vec3d position = { in->x[i], in->y[i], in->z[i] };
+		geodetic_t geo;
+		ToGeodetic3D( &position, e, &geo );
+		out->lon[i] = geo.lon;
+		out->lat[i] = geo.lat;
+		out->height[i] = geo.height;
+	}
+	return count - num_solved;
+}
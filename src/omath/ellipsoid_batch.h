@@ -0,0 +1,82 @@
+
+/* Conversions of many positions at once, for whole grids of posts. Positions are kept as
+ * structure of arrays, one array per axis, so the loops run over contiguous doubles.
+ * AVX2 with FMA or plain C, chosen at compile time. */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "ellipsoid.h"
+
+// Cartesian positions, the i-th one is x[i], y[i], z[i]
+typedef struct vec3d_soa_t {
+	double *x;
+	double *y;
+	double *z;
+} vec3d_soa_t;
+
+// Geodetic positions, lon/lat in degrees, the i-th one is lon[i], lat[i], height[i]
+typedef struct geodetic_soa_t {
+	double *lon;
+	double *lat;
+	double *height;
+} geodetic_soa_t;
+
+/* A regular grid of geodetic positions in degrees. Post c of row r is at longitude lon + c * lon_step
+ * and latitude lat + r * lat_step; lat_step is negative for rows from north to south. */
+typedef struct geodetic_grid_t {
+	double lon;
+	double lat;
+	double lon_step;
+	double lat_step;
+	uint32_t num_columns;
+	uint32_t num_rows;
+} geodetic_grid_t;
+
+/* Per column of a grid the sine and cosine of its longitude, and rx^2 cos^2 lon + ry^2 sin^2 lon, the
+ * part of the conversion that doesn't change from row to row. Built once, it serves all rows and
+ * strips of rows of the grid. */
+typedef struct ellipsoid_columns_t {
+	double *cos_lon;
+	double *sin_lon;
+	double *q;
+	uint32_t num_columns;
+	// NULL for views
+	double *memory;
+} ellipsoid_columns_t;
+
+// Allocates an unfilled table of num_columns columns
+extern bool ellipsoid_columns_create( const uint32_t num_columns, ellipsoid_columns_t *columns );
+
+// Fills the table with the columns of grid, which has no more columns than the table
+extern void ellipsoid_columns_fill( const geodetic_grid_t *const grid, const ellipsoid_t *const e,
+		ellipsoid_columns_t *columns );
+
+extern void ellipsoid_columns_destroy( ellipsoid_columns_t *columns );
+
+// num_columns columns from first on that share the memory of columns
+extern ellipsoid_columns_t *ellipsoid_columns_view( const ellipsoid_columns_t *const columns, const uint32_t first,
+		const uint32_t num_columns, ellipsoid_columns_t *view );
+
+/* Converts all posts of grid to cartesian, row by row into out, post c of row r at
+ * r * num_columns + c. Heights in metres are taken from heights, rows height_stride posts apart,
+ * or 0 if heights is NULL. Sine and cosine are computed once per row and column.
+ * Returns false if the tables of the columns can't be allocated. */
+extern bool ellipsoid_grid_to_cartesian( const geodetic_grid_t *const grid, const uint16_t *const heights,
+		const size_t height_stride, const ellipsoid_t *const e, vec3d_soa_t *out );
+
+/* Same with the table of grid's columns built beforehand, so nothing is allocated and only the
+ * sine and cosine of each row's latitude are computed. The longitudes of grid aren't used. */
+extern void ellipsoid_grid_to_cartesian_columns( const geodetic_grid_t *const grid,
+		const ellipsoid_columns_t *const columns, const uint16_t *const heights, const size_t height_stride,
+		const ellipsoid_t *const e, vec3d_soa_t *out );
+
+/* Converts count cartesian positions of in to geodetic ones in out. Ellipsoids with equal x and y
+ * radii take Vermeille's closed form with a fixed number of steps, 4 positions at a time with AVX2.
+ * Positions within a few hundred km of the center, where it isn't reliable, and all positions on
+ * triaxial ellipsoids go through ToGeodetic3D, whose iteration is capped; the center itself has
+ * no geodetic position and comes out as NAN. Returns how many took that fallback. */
+extern size_t ellipsoid_cartesian_to_geodetic( const vec3d_soa_t *const in, const size_t count,
+		const ellipsoid_t *const e, geodetic_soa_t *out );
@@ -0,0 +1,132 @@
+#include "asc_parallel.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+typedef struct chunk_job_t {
+	const char *begin;
+	const char *end;
+	uint32_t num_newlines;
+	uint32_t first_row;
+	uint32_t num_rows;
+	uint32_t num_columns;
+	int no_data;
+	uint16_t *data;
+	size_t stride;
+	asc_parse_stats_t stats;
+	// Row where parsing went wrong, UINT32_MAX if all went well
+	uint32_t failed_row;
+} chunk_job_t;
+
+static void *count_newlines( void *arg ) {
+	chunk_job_t *job = arg;
+	uint32_t count = 0;
+	for( const char *p = job->begin; p < job->end; ++p, ++count )
+		if( !( p = memchr( p, '\n', (size_t)( job->end - p ) ) ) )
+			break;
+	job->num_newlines = count;
+	return NULL;
+}
+
+static void *parse_chunk( void *arg ) {
+	chunk_job_t *job = arg;
+	const char *pos = job->begin;
+	job->failed_row = UINT32_MAX;
+	for( uint32_t row = job->first_row; row < job->first_row + job->num_rows; ++row ) {
+		size_t parsed;
+		pos = asc_parse_values( pos, job->end, true, job->no_data,
+				job->data + (size_t)row * job->stride, job->num_columns, &parsed, &job->stats );
+		if( !pos || parsed != job->num_columns ) {
+			job->failed_row = row;
+			return NULL;
+		}
+	}
+	// Only whitespace may be left, anything else means the rows are not one per line
+	while( pos < job->end && ( *pos == ' ' || ( *pos >= '\t' && *pos <= '\r' ) ) )
+		++pos;
+	if( pos != job->end )
+		job->failed_row = job->first_row + job->num_rows;
+	return NULL;
+}
+
+// Runs func on all jobs, one thread each
+static void run_jobs( void *(*func)( void * ), chunk_job_t *jobs, const unsigned num_jobs ) {
+	pthread_t threads[num_jobs];
+	unsigned started = 0;
+	for( ; started < num_jobs; ++started )
+		if( pthread_create( &threads[started], NULL, func, &jobs[started] ) != 0 )
+			break;
+	// Whatever could not be started runs here
+	for( unsigned i = started; i < num_jobs; ++i )
+		func( &jobs[i] );
+	for( unsigned i = 0; i < started; ++i )
+		pthread_join( threads[i], NULL );
+}
+
+void asc_parse_stats_merge( asc_parse_stats_t *stats, const asc_parse_stats_t *const part ) {
+	stats->min_value = part->min_value < stats->min_value ? part->min_value : stats->min_value;
+	stats->max_value = part->max_value > stats->max_value ? part->max_value : stats->max_value;
+	stats->value_count += part->value_count;
+	stats->no_data_count += part->no_data_count;
+	stats->negative_count += part->negative_count;
+}
+
+bool asc_parse_rows_parallel(
+		const char *const begin, const char *const end, const uint32_t num_rows, const uint32_t num_columns,
+		const int no_data, uint16_t *data, const size_t stride, const unsigned num_threads,
+		asc_parse_stats_t *stats ) {
+	const unsigned num_jobs = num_threads < 1 ? 1 : num_threads > num_rows ? num_rows : num_threads;
+	chunk_job_t *jobs = calloc( num_jobs, sizeof(chunk_job_t) );
+	if( !jobs )
+		return false;
+	// Equal byte ranges, each moved forward to the start of the next line
+	const size_t size = (size_t)( end - begin );
+	const char *chunk_begin = begin;
+	for( unsigned i = 0; i < num_jobs; ++i ) {
+		const char *chunk_end = end;
+		if( i + 1 < num_jobs ) {
+			chunk_end = begin + size / num_jobs * ( i + 1 );
+			chunk_end = chunk_end < chunk_begin ? chunk_begin : chunk_end;
+			const char *newline = memchr( chunk_end, '\n', (size_t)( end - chunk_end ) );
+			chunk_end = newline ? newline + 1 : end;
+		}
+		jobs[i].begin = chunk_begin;
+		jobs[i].end = chunk_end;
+		jobs[i].num_columns = num_columns;
+		jobs[i].no_data = no_data;
+		jobs[i].data = data;
+		jobs[i].stride = stride;
+		asc_parse_stats_init( &jobs[i].stats );
+		chunk_begin = chunk_end;
+	}
+	run_jobs( count_newlines, jobs, num_jobs );
+	// Prefix sum over the newlines gives the first row of each range
+	uint32_t row = 0;
+	bool ok = true;
+	for( unsigned i = 0; i < num_jobs; ++i ) {
+		jobs[i].first_row = row;
+		// The last line may come without newline, or be followed by empty ones
+		jobs[i].num_rows = i + 1 < num_jobs ? jobs[i].num_newlines : num_rows - row;
+		row += jobs[i].num_rows;
+		if( row > num_rows ) {
+			ok = false;
+			break;
+		}
+	}
+	if( ok ) {
+		run_jobs( parse_chunk, jobs, num_jobs );
+		asc_parse_stats_t merged = *stats;
+		for( unsigned i = 0; ok && i < num_jobs; ++i ) {
+			if( jobs[i].failed_row != UINT32_MAX ) {
+				fprintf( stderr, "Error parsing row %u in parallel\n", jobs[i].failed_row );
+				ok = false;
+			}
+			asc_parse_stats_merge( &merged, &jobs[i].stats );
+		}
+		if( ok )
+			*stats = merged;
+	}
+	free( jobs );
+	return ok;
+}
@@ -0,0 +1,19 @@
+/* Parses the body of a mapped ascii file with several threads. The body is cut into
+ * byte ranges at line ends; the newlines in front of each range give its first row. */
+
+#pragma once
+
+#include "asc_parser.h"
+
+/* Parses num_rows rows of num_columns values, one line per row, from [begin, end) into data,
+ * with rows stride posts apart.
+ * Returns false if a value can't be parsed or a line doesn't hold exactly one row; the
+ * body can still be read sequentially then if it wraps rows differently. */
+extern bool asc_parse_rows_parallel(
+		const char *const begin, const char *const end, const uint32_t num_rows, const uint32_t num_columns,
+		const int no_data, uint16_t *data, const size_t stride, const unsigned num_threads,
+		asc_parse_stats_t *stats
+);
+
+// Merges the statistics of a part of the data into stats
+extern void asc_parse_stats_merge( asc_parse_stats_t *stats, const asc_parse_stats_t *const part );
@@ -0,0 +1,234 @@
+#include "asc_parser.h"
+#include "height_clamp.h"
+#include <limits.h>
+#include <string.h>
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// Bytes classified at once, and bytes that must be readable behind a window for the digit loads
+#define WINDOW 64
+#define SLACK 16
+// Heights have 5 digits at most, everything longer than this is treated as garbage
+#define MAX_DIGITS 8
+// Raw values gathered before they are clamped at once; a window holds at most WINDOW / 2
+#define STAGE_SIZE 256
+
+static const uint64_t ASCII_ZEROS = 0x3030303030303030ULL;
+
+// Bit masks for one window, bit i stands for byte i
+typedef struct masks_t {
+	uint64_t token;		// digits and '-'
+	uint64_t minus;
+	uint64_t invalid;	// neither token nor whitespace
+} masks_t;
+
+static inline bool is_space( const char c ) {
+	return c == ' ' || ( c >= '\t' && c <= '\r' );
+}
+
+static inline bool is_digit( const char c ) {
+	return (unsigned char)( c - '0' ) <= 9;
+}
+
+#if defined(__AVX2__)
+static inline void classify_32( const char *p, uint64_t *token, uint64_t *minus, uint64_t *space ) {
+	const __m256i v = _mm256_loadu_si256( (const __m256i *)p );
+	// unsigned (c - '0') <= 9
+	const __m256i d = _mm256_sub_epi8( v, _mm256_set1_epi8( '0' ) );
+	const __m256i digit = _mm256_cmpeq_epi8( _mm256_min_epu8( d, _mm256_set1_epi8( 9 ) ), d );
+	const __m256i dash = _mm256_cmpeq_epi8( v, _mm256_set1_epi8( '-' ) );
+	// ' ' or unsigned (c - '\t') <= 4
+	const __m256i w = _mm256_sub_epi8( v, _mm256_set1_epi8( '\t' ) );
+	const __m256i ws = _mm256_or_si256(
+			_mm256_cmpeq_epi8( v, _mm256_set1_epi8( ' ' ) ),
+			_mm256_cmpeq_epi8( _mm256_min_epu8( w, _mm256_set1_epi8( 4 ) ), w ) );
+	*token = (uint32_t)_mm256_movemask_epi8( _mm256_or_si256( digit, dash ) );
+	*minus = (uint32_t)_mm256_movemask_epi8( dash );
+	*space = (uint32_t)_mm256_movemask_epi8( ws );
+}
+
+static inline void classify( const char *p, masks_t *m ) {
+	uint64_t t0, m0, s0, t1, m1, s1;
+	classify_32( p, &t0, &m0, &s0 );
+	classify_32( p + 32, &t1, &m1, &s1 );
+	m->token = t0 | t1 << 32;
+	m->minus = m0 | m1 << 32;
+	m->invalid = ~( m->token | s0 | s1 << 32 );
+}
+
+const char *asc_parser_isa( void ) {
+	return "avx2";
+}
+#elif defined(__SSE2__)
+static inline void classify_16( const char *p, uint64_t *token, uint64_t *minus, uint64_t *space ) {
+	const __m128i v = _mm_loadu_si128( (const __m128i *)p );
+	const __m128i d = _mm_sub_epi8( v, _mm_set1_epi8( '0' ) );
+	const __m128i digit = _mm_cmpeq_epi8( _mm_min_epu8( d, _mm_set1_epi8( 9 ) ), d );
+	const __m128i dash = _mm_cmpeq_epi8( v, _mm_set1_epi8( '-' ) );
+	const __m128i w = _mm_sub_epi8( v, _mm_set1_epi8( '\t' ) );
+	const __m128i ws = _mm_or_si128(
+			_mm_cmpeq_epi8( v, _mm_set1_epi8( ' ' ) ),
+			_mm_cmpeq_epi8( _mm_min_epu8( w, _mm_set1_epi8( 4 ) ), w ) );
+	*token = (uint32_t)_mm_movemask_epi8( _mm_or_si128( digit, dash ) );
+	*minus = (uint32_t)_mm_movemask_epi8( dash );
+	*space = (uint32_t)_mm_movemask_epi8( ws );
+}
+
+static inline void classify( const char *p, masks_t *m ) {
+	uint64_t space = 0;
+	m->token = m->minus = 0;
+	for( unsigned i = 0; i < WINDOW; i += 16 ) {
+		uint64_t t, d, s;
+		classify_16( p + i, &t, &d, &s );
+		m->token |= t << i;
+		m->minus |= d << i;
+		space |= s << i;
+	}
+	m->invalid = ~( m->token | space );
+}
+
+const char *asc_parser_isa( void ) {
+	return "sse2";
+}
+#else
+static inline void classify( const char *p, masks_t *m ) {
+	uint64_t space = 0;
+	m->token = m->minus = 0;
+	for( unsigned i = 0; i < WINDOW; ++i ) {
+		const uint64_t bit = (uint64_t)1 << i;
+		m->token |= is_digit( p[i] ) || p[i] == '-' ? bit : 0;
+		m->minus |= p[i] == '-' ? bit : 0;
+		space |= is_space( p[i] ) ? bit : 0;
+	}
+	m->invalid = ~( m->token | space );
+}
+
+const char *asc_parser_isa( void ) {
+	return "scalar";
+}
+#endif
+
+/* Converts 1 to 8 ascii digits to their value. 8 bytes must be readable at digits.
+ * The digits are padded with leading '0's and combined pairwise (swar). */
+static inline uint32_t digits_to_u32( const char *digits, const unsigned len ) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	uint64_t val;
+	memcpy( &val, digits, sizeof(val) );
+	const unsigned shift = ( 8 - len ) * 8;
+	val = ( val << shift ) | ( ASCII_ZEROS & ( ( (uint64_t)1 << shift ) - 1 ) );
+	val -= ASCII_ZEROS;
+	val = val * 10 + ( val >> 8 );
+	val = ( ( val & 0x000000FF000000FFULL ) * 0x000F424000000064ULL +
+			( ( val >> 16 ) & 0x000000FF000000FFULL ) * 0x0000271000000001ULL ) >> 32;
+	return (uint32_t)val;
+#else
+	uint32_t val = 0;
+	for( unsigned i = 0; i < len; ++i )
+		val = val * 10 + (uint32_t)( digits[i] - '0' );
+	return val;
+#endif
+}
+
+static inline uint64_t bits_below( const unsigned n ) {
+	return n >= 64 ? ~(uint64_t)0 : ( (uint64_t)1 << n ) - 1;
+}
+
+void asc_parse_stats_init( asc_parse_stats_t *stats ) {
+	stats->min_value = INT_MAX;
+	stats->max_value = INT_MIN;
+	stats->value_count = 0;
+	stats->no_data_count = 0;
+	stats->negative_count = 0;
+}
+
+const char *asc_parse_values(
+		const char *begin, const char *end, const bool last, const int no_data,
+		uint16_t *out, const size_t count, size_t *num_parsed, asc_parse_stats_t *stats ) {
+	const char *p = begin;
+	size_t n = 0;
+	// The last staged values go to out from n - staged on
+	int32_t stage[STAGE_SIZE + WINDOW];
+	size_t staged = 0;
+	bool failed = false;
+	/* Vectorized part. p is always on whitespace or the first byte of a value here,
+	 * so a token byte at bit 0 starts a value. */
+	while( n < count && end - p >= WINDOW + SLACK ) {
+		masks_t m;
+		classify( p, &m );
+		uint64_t starts = m.token & ~( m.token << 1 );
+		// first whitespace behind a value
+		uint64_t ends = ~m.token & ( m.token << 1 );
+		// a '-' anywhere but in front of a value is garbage
+		m.invalid |= m.minus & ~starts;
+		unsigned stop = WINDOW;
+		while( starts ) {
+			const unsigned s = (unsigned)__builtin_ctzll( starts );
+			if( !ends ) {
+				// the value continues in the next window
+				stop = s;
+				break;
+			}
+			const unsigned e = (unsigned)__builtin_ctzll( ends );
+			const bool neg = m.minus >> s & 1;
+			const unsigned len = e - s - neg;
+			if( len == 0 || len > MAX_DIGITS ) {
+				failed = true;
+				stop = s;
+				break;
+			}
+			const uint32_t d = digits_to_u32( p + s + neg, len );
+			stage[staged++] = neg ? -(int32_t)d : (int32_t)d;
+			if( ++n == count ) {
+				stop = e;
+				break;
+			}
+			starts &= starts - 1;
+			ends &= ends - 1;
+		}
+		if( failed || m.invalid & bits_below( stop ) || stop == 0 ) {
+			// garbage, or a single value longer than the window
+			failed = true;
+			break;
+		}
+		p += stop;
+		if( staged >= STAGE_SIZE ) {
+			height_clamp_i32( stage, staged, no_data, out + n - staged, stats );
+			staged = 0;
+		}
+	}
+	// Scalar rest at the end of the buffer
+	while( !failed && n < count ) {
+		while( p < end && is_space( *p ) )
+			++p;
+		if( p == end )
+			break;
+		const char *const token = p;
+		const bool neg = *p == '-';
+		p += neg;
+		uint32_t d = 0;
+		const char *const digits = p;
+		while( p < end && is_digit( *p ) && p - digits <= MAX_DIGITS )
+			d = d * 10 + (uint32_t)( *p++ - '0' );
+		if( p == end && !last ) {
+			// may continue in the next buffer
+			p = token;
+			break;
+		}
+		if( p == digits || p - digits > MAX_DIGITS || ( p < end && !is_space( *p ) ) ) {
+			failed = true;
+			break;
+		}
+		stage[staged++] = neg ? -(int32_t)d : (int32_t)d;
+		++n;
+		if( staged == STAGE_SIZE ) {
+			height_clamp_i32( stage, staged, no_data, out + n - staged, stats );
+			staged = 0;
+		}
+	}
+	if( staged > 0 )
+		height_clamp_i32( stage, staged, no_data, out + n - staged, stats );
+	stats->value_count += n;
+	*num_parsed = n;
+	return failed ? NULL : p;
+}
@@ -0,0 +1,36 @@
+/* Parser for the body of an ESRI ascii grid as written for the srtm data:
+ * whitespace separated signed integers, one line per row.
+ * Classifies 64 bytes at a time into token and delimiter bytes (AVX2, SSE2 or
+ * plain C, chosen at compile time) and converts up to 8 digits at once. */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Statistics of the raw values as they are read, before no data and negatives are clipped
+typedef struct asc_parse_stats_t {
+	int min_value;
+	int max_value;
+	uint64_t value_count;
+	// Posts set to 0, no data and the other negative values
+	uint64_t no_data_count;
+	uint64_t negative_count;
+} asc_parse_stats_t;
+
+extern void asc_parse_stats_init( asc_parse_stats_t *stats );
+
+/* Parses up to count values from [begin, end) into out. No data and negative values are set
+ * to 0, heights above 65535 saturate. Returns the position behind the last consumed value and
+ * the number of values in num_parsed, or NULL if the data contains something that is not an
+ * integer or whitespace.
+ * Unless last is set a value touching end is not consumed, it may continue in the next buffer.
+ * Whitespace behind the last value is not consumed. */
+extern const char *asc_parse_values(
+		const char *begin, const char *end, const bool last, const int no_data,
+		uint16_t *out, const size_t count, size_t *num_parsed, asc_parse_stats_t *stats
+);
+
+// Name of the classifier compiled in, for the logs
+extern const char *asc_parser_isa( void );
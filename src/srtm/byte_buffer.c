@@ -0,0 +1,42 @@
+#include "byte_buffer.h"
+#include <stdlib.h>
+#include <string.h>
+
+void byte_buffer_init( byte_buffer_t *buffer ) {
+	buffer->data = NULL;
+	buffer->size = 0;
+	buffer->capacity = 0;
+}
+
+bool byte_buffer_reserve( byte_buffer_t *buffer, const size_t capacity ) {
+	if( capacity <= buffer->capacity )
+		return true;
+	unsigned char *grown = realloc( buffer->data, capacity );
+	if( !grown )
+		return false;
+	buffer->data = grown;
+	buffer->capacity = capacity;
+	return true;
+}
+
+bool byte_buffer_append( byte_buffer_t *buffer, const void *const data, const size_t size ) {
+	if( buffer->size + size > buffer->capacity ) {
+		size_t capacity = buffer->capacity ? buffer->capacity : 4096;
+		while( capacity < buffer->size + size )
+			capacity *= 2;
+		if( !byte_buffer_reserve( buffer, capacity ) )
+			return false;
+	}
+	memcpy( buffer->data + buffer->size, data, size );
+	buffer->size += size;
+	return true;
+}
+
+void byte_buffer_clear( byte_buffer_t *buffer ) {
+	buffer->size = 0;
+}
+
+void byte_buffer_free( byte_buffer_t *buffer ) {
+	free( buffer->data );
+	byte_buffer_init( buffer );
+}
@@ -0,0 +1,25 @@
+/* A growing block of memory that encoded tiles are written into. */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdbool.h>
+
+typedef struct byte_buffer_t {
+	unsigned char *data;
+	size_t size;
+	size_t capacity;
+} byte_buffer_t;
+
+extern void byte_buffer_init( byte_buffer_t *buffer );
+
+// Appends size bytes, growing the buffer as needed
+extern bool byte_buffer_append( byte_buffer_t *buffer, const void *const data, const size_t size );
+
+// Makes room for at least capacity bytes in total
+extern bool byte_buffer_reserve( byte_buffer_t *buffer, const size_t capacity );
+
+// Empties the buffer but keeps the memory for reuse
+extern void byte_buffer_clear( byte_buffer_t *buffer );
+
+extern void byte_buffer_free( byte_buffer_t *buffer );
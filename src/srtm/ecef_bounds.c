@@ -0,0 +1,91 @@
+#include "ecef_bounds.h"
+#include <stdlib.h>
+#include <math.h>
+#include <float.h>
+
+// Rows converted at a time
+#define STRIP_ROWS 16
+
+// The rows of geodetic from row on, at most STRIP_ROWS
+static uint32_t strip_to_cartesian( const height_grid_t *const grid, const geodetic_grid_t *const geodetic,
+		const ellipsoid_columns_t *const columns, const uint32_t row, const ellipsoid_t *const e, vec3d_soa_t *strip ) {
+	geodetic_grid_t part = *geodetic;
+	part.lat = geodetic->lat + (double)row * geodetic->lat_step;
+	part.num_rows = geodetic->num_rows - row < STRIP_ROWS ? geodetic->num_rows - row : STRIP_ROWS;
+	ellipsoid_grid_to_cartesian_columns( &part, columns, height_grid_row( grid, row ), grid->stride, e, strip );
+	return part.num_rows;
+}
+
+static inline double dot( const vec3d *const a, const double x, const double y, const double z ) {
+	return a->x * x + a->y * y + a->z * z;
+}
+
+static inline double distance_sq( const vec3d *const a, const double x, const double y, const double z ) {
+	return ( x - a->x ) * ( x - a->x ) + ( y - a->y ) * ( y - a->y ) + ( z - a->z ) * ( z - a->z );
+}
+
+bool ecef_bounds_compute( const height_grid_t *const grid, const geodetic_grid_t *const geodetic,
+		const ellipsoid_columns_t *const columns, const ellipsoid_t *const e, ecef_bounds_t *bounds ) {
+	const size_t strip_posts = (size_t)STRIP_ROWS * geodetic->num_columns;
+	double *const memory = malloc( 3 * strip_posts * sizeof(double) );
+	if( !memory )
+		return false;
+	vec3d_soa_t strip = { memory, memory + strip_posts, memory + 2 * strip_posts };
+	// East, north and up at the center post
+	const geodetic_t middle = {
+			geodetic->lon + 0.5 * ( geodetic->num_columns - 1 ) * geodetic->lon_step,
+			geodetic->lat + 0.5 * ( geodetic->num_rows - 1 ) * geodetic->lat_step, 0.0
+	};
+	vec3d *const axes = bounds->axes;
+	ellipsoid_geodetic_normal_from_geodetic( &middle, &axes[2] );
+	const double lon = radiansd( middle.lon );
+	const double sin_lat = axes[2].z;
+	axes[0] = (vec3d){ -sin( lon ), cos( lon ), 0.0 };
+	axes[1] = (vec3d){ -sin_lat * cos( lon ), -sin_lat * sin( lon ), sqrt( 1.0 - sin_lat * sin_lat ) };
+	// Box extents, and the extents along the axes from the origin
+	double lo[6] = { DBL_MAX, DBL_MAX, DBL_MAX, DBL_MAX, DBL_MAX, DBL_MAX };
+	double hi[6] = { -DBL_MAX, -DBL_MAX, -DBL_MAX, -DBL_MAX, -DBL_MAX, -DBL_MAX };
+	for( uint32_t row = 0; row < geodetic->num_rows; row += STRIP_ROWS ) {
+		const uint32_t num_rows = strip_to_cartesian( grid, geodetic, columns, row, e, &strip );
+		const size_t count = (size_t)num_rows * geodetic->num_columns;
+		for( size_t i = 0; i < count; ++i ) {
+			const double p[6] = {
+					strip.x[i], strip.y[i], strip.z[i],
+					dot( &axes[0], strip.x[i], strip.y[i], strip.z[i] ),
+					dot( &axes[1], strip.x[i], strip.y[i], strip.z[i] ),
+					dot( &axes[2], strip.x[i], strip.y[i], strip.z[i] )
+			};
+			for( unsigned k = 0; k < 6; ++k ) {
+				lo[k] = p[k] < lo[k] ? p[k] : lo[k];
+				hi[k] = p[k] > hi[k] ? p[k] : hi[k];
+			}
+		}
+	}
+	bounds->min = (vec3d){ lo[0], lo[1], lo[2] };
+	bounds->max = (vec3d){ hi[0], hi[1], hi[2] };
+	bounds->half_extents = (vec3d){ 0.5 * ( hi[3] - lo[3] ), 0.5 * ( hi[4] - lo[4] ), 0.5 * ( hi[5] - lo[5] ) };
+	const double mid[3] = { 0.5 * ( lo[3] + hi[3] ), 0.5 * ( lo[4] + hi[4] ), 0.5 * ( lo[5] + hi[5] ) };
+	bounds->box_center = (vec3d){
+			axes[0].x * mid[0] + axes[1].x * mid[1] + axes[2].x * mid[2],
+			axes[0].y * mid[0] + axes[1].y * mid[1] + axes[2].y * mid[2],
+			axes[0].z * mid[0] + axes[1].z * mid[1] + axes[2].z * mid[2]
+	};
+	// Second pass for the radius around either center
+	const vec3d aabb_center = { 0.5 * ( lo[0] + hi[0] ), 0.5 * ( lo[1] + hi[1] ), 0.5 * ( lo[2] + hi[2] ) };
+	double aabb_radius_sq = 0.0;
+	double box_radius_sq = 0.0;
+	for( uint32_t row = 0; row < geodetic->num_rows; row += STRIP_ROWS ) {
+		const uint32_t num_rows = strip_to_cartesian( grid, geodetic, columns, row, e, &strip );
+		const size_t count = (size_t)num_rows * geodetic->num_columns;
+		for( size_t i = 0; i < count; ++i ) {
+			const double a = distance_sq( &aabb_center, strip.x[i], strip.y[i], strip.z[i] );
+			const double b = distance_sq( &bounds->box_center, strip.x[i], strip.y[i], strip.z[i] );
+			aabb_radius_sq = a > aabb_radius_sq ? a : aabb_radius_sq;
+			box_radius_sq = b > box_radius_sq ? b : box_radius_sq;
+		}
+	}
+	bounds->center = aabb_radius_sq < box_radius_sq ? aabb_center : bounds->box_center;
+	bounds->radius = sqrt( aabb_radius_sq < box_radius_sq ? aabb_radius_sq : box_radius_sq );
+	free( memory );
+	return true;
+}
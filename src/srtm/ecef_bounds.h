@@ -0,0 +1,30 @@
+/* Bounding volumes of a tile in earth centered, earth fixed cartesian coordinates of the ellipsoid,
+ * so a renderer can cull tiles without converting their corners first. They are computed from the
+ * positions of all posts with their heights, so they hold the surface between posts as well and
+ * follow the curvature of the ellipsoid. Positions come from ellipsoid_grid_to_cartesian_columns, a
+ * strip of rows at a time, with the table of the columns the caller shares with the mesh of the tile. */
+
+#pragma once
+
+#include <stdbool.h>
+#include "height_grid.h"
+#include "../omath/ellipsoid_batch.h"
+
+typedef struct ecef_bounds_t {
+	// axis aligned box
+	vec3d min;
+	vec3d max;
+	// sphere
+	vec3d center;
+	double radius;
+	// oriented box, its unit axes are east, north and up at the tile's center post
+	vec3d box_center;
+	vec3d axes[3];
+	vec3d half_extents;
+} ecef_bounds_t;
+
+/* Bounds of the posts of grid, which lie at the positions of geodetic; columns is the table of its
+ * columns. The sphere is centered on whichever box center gives the smaller radius. Returns false if
+ * memory can't be allocated. */
+extern bool ecef_bounds_compute( const height_grid_t *const grid, const geodetic_grid_t *const geodetic,
+		const ellipsoid_columns_t *const columns, const ellipsoid_t *const e, ecef_bounds_t *bounds );
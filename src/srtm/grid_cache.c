@@ -0,0 +1,201 @@
+#include "grid_cache.h"
+#include "le_bytes.h"
+#include "mosaic.h"
+#include "xxhash64.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Posts are mapped as they are, which needs a little endian host
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define GRID_CACHE_USABLE 1
+#else
+#define GRID_CACHE_USABLE 0
+#endif
+
+#define FNV_OFFSET 0xcbf29ce484222325ull
+#define FNV_PRIME 0x100000001b3ull
+
+static uint64_t fnv1a( uint64_t h, const void *const data, const size_t size ) {
+	const unsigned char *const p = data;
+	for( size_t i = 0; i < size; ++i )
+		h = ( h ^ p[i] ) * FNV_PRIME;
+	return h;
+}
+
+static bool fingerprint_file( const char *const path, uint64_t *h ) {
+	struct stat st;
+	if( stat( path, &st ) != 0 || !S_ISREG( st.st_mode ) )
+		return false;
+	unsigned char fields[20];
+	store_u64( fields, (uint64_t)st.st_size );
+	store_u64( fields + 8, (uint64_t)st.st_mtim.tv_sec );
+	store_u32( fields + 16, (uint32_t)st.st_mtim.tv_nsec );
+	*h = fnv1a( fnv1a( *h, path, strlen( path ) + 1 ), fields, sizeof(fields) );
+	return true;
+}
+
+bool grid_cache_fingerprint( const char *const path, const bool mosaic, uint64_t *fingerprint ) {
+	uint64_t h = FNV_OFFSET;
+	if( !fingerprint_file( path, &h ) )
+		return false;
+	if( mosaic ) {
+		// The inputs as mosaic_open reads them from the list
+		FILE *list = fopen( path, "r" );
+		if( !list )
+			return false;
+		char *line = NULL;
+		size_t capacity = 0;
+		ssize_t length;
+		bool ok = true;
+		while( ok && ( length = getline( &line, &capacity, list ) ) >= 0 ) {
+			while( length > 0 && ( line[length-1] == '\n' || line[length-1] == '\r' || line[length-1] == ' ' ) )
+				line[--length] = '\0';
+			if( length > 0 ) {
+				char *const input = mosaic_input_path( path, line );
+				ok = input && fingerprint_file( input, &h );
+				free( input );
+			}
+		}
+		free( line );
+		fclose( list );
+		if( !ok )
+			return false;
+	}
+	*fingerprint = h;
+	return true;
+}
+
+// xxHash64 of the posts row by row, padding excluded
+static uint64_t posts_checksum( const height_grid_t *const grid ) {
+	xxh64_state_t state;
+	xxh64_init( &state, 0 );
+	for( uint32_t r = 0; r < grid->height; ++r )
+		xxh64_update( &state, height_grid_row( grid, r ), grid->width * sizeof(uint16_t) );
+	return xxh64_digest( &state );
+}
+
+static char *cache_path( const char *const path, const char *const suffix ) {
+	const size_t length = strlen( path );
+	const size_t suffix_length = strlen( suffix );
+	char *cache = malloc( length + suffix_length + 1 );
+	if( cache ) {
+		memcpy( cache, path, length );
+		memcpy( cache + length, suffix, suffix_length + 1 );
+	}
+	return cache;
+}
+
+static inline size_t posts_offset( void ) {
+	return GRID_CACHE_HEADER_SIZE > GRID_CACHE_ALIGNMENT ? GRID_CACHE_HEADER_SIZE : GRID_CACHE_ALIGNMENT;
+}
+
+bool grid_cache_open( const char *const path, const uint64_t fingerprint, const bool verify,
+		grid_cache_t *cache ) {
+	memset( cache, 0, sizeof(*cache) );
+	char *const file_path = cache_path( path, ".int16" );
+	const int fd = GRID_CACHE_USABLE && file_path ? open( file_path, O_RDONLY ) : -1;
+	struct stat st;
+	if( fd < 0 || fstat( fd, &st ) != 0 || (size_t)st.st_size < posts_offset() ) {
+		if( fd >= 0 )
+			close( fd );
+		free( file_path );
+		return false;
+	}
+	void *map = mmap( NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+	close( fd );
+	if( map == MAP_FAILED ) {
+		fprintf( stderr, "Error mapping grid cache '%s': %s\n", file_path, strerror(errno) );
+		free( file_path );
+		return false;
+	}
+	cache->map = map;
+	cache->map_size = (size_t)st.st_size;
+	const unsigned char *const h = map;
+	srtm_header_t *const header = &cache->header;
+	header->num_columns = load_u32( h + 16 );
+	header->num_rows = load_u32( h + 20 );
+	header->longitude = load_f64( h + 24 );
+	header->latitude = load_f64( h + 32 );
+	header->cellsize = load_f64( h + 40 );
+	header->no_data = (int)load_u32( h + 48 );
+	const size_t stride = load_u32( h + 52 );
+	const uint64_t offset = load_u64( h + 72 );
+	const char *reason = NULL;
+	if( memcmp( h, GRID_CACHE_MAGIC, 8 ) != 0 || load_u32( h + 8 ) != GRID_CACHE_VERSION ||
+		stride < header->num_columns || offset % GRID_CACHE_ALIGNMENT != 0 ||
+		offset + (uint64_t)stride * header->num_rows * sizeof(uint16_t) > cache->map_size )
+		reason = "broken header";
+	else if( load_u64( h + 56 ) != fingerprint )
+		reason = "made from other input";
+	if( !reason ) {
+		cache->grid.width = header->num_columns;
+		cache->grid.height = header->num_rows;
+		cache->grid.stride = stride;
+		cache->grid.data = (uint16_t *)( (unsigned char *)map + offset );
+		if( verify && posts_checksum( &cache->grid ) != load_u64( h + 64 ) )
+			reason = "checksum mismatch";
+	}
+	if( reason ) {
+		printf( "Not using grid cache '%s': %s\n", file_path, reason );
+		grid_cache_close( cache );
+	}
+	free( file_path );
+	return reason == NULL;
+}
+
+bool grid_cache_save( const char *const path, const srtm_header_t *const header,
+		const height_grid_t *const grid, const uint64_t fingerprint ) {
+	if( !GRID_CACHE_USABLE )
+		return false;
+	// Rows as height_grid_create lays them out
+	const size_t posts_per_line = HEIGHT_GRID_ALIGNMENT / sizeof(uint16_t);
+	const size_t stride = ( (size_t)grid->width + posts_per_line - 1 ) / posts_per_line * posts_per_line;
+	unsigned char *const h = calloc( 1, posts_offset() );
+	uint16_t *const padding = calloc( stride - grid->width + 1, sizeof(uint16_t) );
+	char *const file_path = cache_path( path, ".int16" );
+	char *const temp_path = cache_path( path, ".int16.tmp" );
+	FILE *file = h && padding && file_path && temp_path ? fopen( temp_path, "wb" ) : NULL;
+	bool ok = file != NULL;
+	if( ok ) {
+		memcpy( h, GRID_CACHE_MAGIC, 8 );
+		store_u32( h + 8, GRID_CACHE_VERSION );
+		store_u32( h + 12, GRID_CACHE_HEADER_SIZE );
+		store_u32( h + 16, header->num_columns );
+		store_u32( h + 20, header->num_rows );
+		store_f64( h + 24, header->longitude );
+		store_f64( h + 32, header->latitude );
+		store_f64( h + 40, header->cellsize );
+		store_u32( h + 48, (uint32_t)header->no_data );
+		store_u32( h + 52, (uint32_t)stride );
+		store_u64( h + 56, fingerprint );
+		store_u64( h + 64, posts_checksum( grid ) );
+		store_u64( h + 72, posts_offset() );
+		ok = fwrite( h, posts_offset(), 1, file ) == 1;
+	}
+	for( uint32_t r = 0; ok && r < grid->height; ++r )
+		ok = fwrite( height_grid_row( grid, r ), sizeof(uint16_t), grid->width, file ) == grid->width &&
+				fwrite( padding, sizeof(uint16_t), stride - grid->width, file ) == stride - grid->width;
+	if( file && fclose( file ) != 0 )
+		ok = false;
+	if( file && ( !ok || rename( temp_path, file_path ) != 0 ) ) {
+		remove( temp_path );
+		ok = false;
+	}
+	free( h );
+	free( padding );
+	free( file_path );
+	free( temp_path );
+	return ok;
+}
+
+void grid_cache_close( grid_cache_t *cache ) {
+	if( cache->map )
+		munmap( cache->map, cache->map_size );
+	memset( cache, 0, sizeof(*cache) );
+}
@@ -0,0 +1,49 @@
+/* Binary cache of the parsed height grid of an input, saved next to it as <input>.int16 so
+ * later runs map it instead of parsing the text again. The posts are those the converter
+ * uses, unsigned 16 bit with no data and negatives set to 0. A cache is only taken while its
+ * fingerprint matches the input, or for a mosaic the list and all inputs it names.
+ * Layout, all values little endian:
+ *    0 magic "SRTMGRID", 8 uint32 version, 12 uint32 header size,
+ *   16 uint32 columns, 20 uint32 rows, 24 double longitude, 32 double latitude,
+ *   40 double cellsize, 48 int32 no data of the input, 52 uint32 row stride in posts,
+ *   56 uint64 fingerprint of the source, 64 uint64 checksum of the posts,
+ *   72 uint64 offset of the posts
+ * - posts, row after row stride posts apart from the offset on, which is a multiple of the
+ *   page size so the mapped rows keep the alignment of height_grid_t */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "height_grid.h"
+#include "srtm_header.h"
+
+#define GRID_CACHE_MAGIC "SRTMGRID"
+#define GRID_CACHE_VERSION 1
+#define GRID_CACHE_HEADER_SIZE 80
+#define GRID_CACHE_ALIGNMENT 4096
+
+typedef struct grid_cache_t {
+	// tilesize is 0
+	srtm_header_t header;
+	// the mapped posts, read only
+	height_grid_t grid;
+	void *map;
+	size_t map_size;
+} grid_cache_t;
+
+/* Fingerprint of the input at path from the names, sizes and mtimes of its files: the file
+ * itself, or with mosaic set the list and every file it names. */
+extern bool grid_cache_fingerprint( const char *const path, const bool mosaic, uint64_t *fingerprint );
+
+/* Maps the cache of the input at path. Fails if there is none, its fingerprint differs or,
+ * with verify set, the checksum of its posts does. */
+extern bool grid_cache_open( const char *const path, const uint64_t fingerprint, const bool verify,
+		grid_cache_t *cache );
+
+// Saves grid as the cache of the input at path, via a temporary file so readers never see half of it
+extern bool grid_cache_save( const char *const path, const srtm_header_t *const header,
+		const height_grid_t *const grid, const uint64_t fingerprint );
+
+extern void grid_cache_close( grid_cache_t *cache );
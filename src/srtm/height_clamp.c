@@ -0,0 +1,156 @@
+#include "height_clamp.h"
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+static inline void clamp_scalar( const int value, const int no_data, uint16_t *out, int *min, int *max,
+		uint64_t *num_no_data, uint64_t *num_negative ) {
+	*min = value < *min ? value : *min;
+	*max = value > *max ? value : *max;
+	*num_no_data += value == no_data;
+	*num_negative += value < 0 && value != no_data;
+	*out = value < 0 || value == no_data ? 0 : value > 65535 ? 65535 : (uint16_t)value;
+}
+
+#if defined(__AVX2__)
+// Lowest and highest of the 8 lanes
+static inline int reduce_min_i32( const __m256i v ) {
+	__m128i m = _mm_min_epi32( _mm256_castsi256_si128( v ), _mm256_extracti128_si256( v, 1 ) );
+	m = _mm_min_epi32( m, _mm_shuffle_epi32( m, _MM_SHUFFLE( 1, 0, 3, 2 ) ) );
+	m = _mm_min_epi32( m, _mm_shuffle_epi32( m, _MM_SHUFFLE( 2, 3, 0, 1 ) ) );
+	return _mm_cvtsi128_si32( m );
+}
+
+static inline int reduce_max_i32( const __m256i v ) {
+	__m128i m = _mm_max_epi32( _mm256_castsi256_si128( v ), _mm256_extracti128_si256( v, 1 ) );
+	m = _mm_max_epi32( m, _mm_shuffle_epi32( m, _MM_SHUFFLE( 1, 0, 3, 2 ) ) );
+	m = _mm_max_epi32( m, _mm_shuffle_epi32( m, _MM_SHUFFLE( 2, 3, 0, 1 ) ) );
+	return _mm_cvtsi128_si32( m );
+}
+
+/* 8 values with no data and negatives set to 0; counts take the byte mask of the lanes,
+ * 4 bits per lane */
+static inline __m256i clamp_8( const __m256i v, const __m256i no_data, __m256i *min, __m256i *max,
+		uint64_t *no_data_bits, uint64_t *negative_bits ) {
+	*min = _mm256_min_epi32( *min, v );
+	*max = _mm256_max_epi32( *max, v );
+	const __m256i is_no_data = _mm256_cmpeq_epi32( v, no_data );
+	const __m256i is_negative = _mm256_cmpgt_epi32( _mm256_setzero_si256(), v );
+	*no_data_bits += (uint64_t)__builtin_popcount( (uint32_t)_mm256_movemask_epi8( is_no_data ) );
+	*negative_bits += (uint64_t)__builtin_popcount(
+			(uint32_t)_mm256_movemask_epi8( _mm256_andnot_si256( is_no_data, is_negative ) ) );
+	return _mm256_andnot_si256( _mm256_or_si256( is_no_data, is_negative ), v );
+}
+
+void height_clamp_i32( const int32_t *values, const size_t count, const int no_data, uint16_t *out,
+		asc_parse_stats_t *stats ) {
+	int min = stats->min_value;
+	int max = stats->max_value;
+	uint64_t num_no_data = 0;
+	uint64_t num_negative = 0;
+	size_t i = 0;
+	if( count >= 16 ) {
+		const __m256i vno_data = _mm256_set1_epi32( no_data );
+		__m256i vmin = _mm256_set1_epi32( min );
+		__m256i vmax = _mm256_set1_epi32( max );
+		uint64_t no_data_bits = 0;
+		uint64_t negative_bits = 0;
+		for( ; i + 16 <= count; i += 16 ) {
+			const __m256i a = clamp_8( _mm256_loadu_si256( (const __m256i *)( values + i ) ), vno_data,
+					&vmin, &vmax, &no_data_bits, &negative_bits );
+			const __m256i b = clamp_8( _mm256_loadu_si256( (const __m256i *)( values + i + 8 ) ), vno_data,
+					&vmin, &vmax, &no_data_bits, &negative_bits );
+			// Saturating pack works within 128 bit lanes, the permute puts a before b
+			const __m256i packed = _mm256_permute4x64_epi64( _mm256_packus_epi32( a, b ), _MM_SHUFFLE( 3, 1, 2, 0 ) );
+			_mm256_storeu_si256( (__m256i *)( out + i ), packed );
+		}
+		min = reduce_min_i32( vmin );
+		max = reduce_max_i32( vmax );
+		num_no_data = no_data_bits / 4;
+		num_negative = negative_bits / 4;
+	}
+	for( ; i < count; ++i )
+		clamp_scalar( values[i], no_data, &out[i], &min, &max, &num_no_data, &num_negative );
+	stats->min_value = min;
+	stats->max_value = max;
+	stats->no_data_count += num_no_data;
+	stats->negative_count += num_negative;
+}
+
+void height_clamp_i16( const int16_t *values, const size_t count, const int no_data, uint16_t *out,
+		asc_parse_stats_t *stats ) {
+	int min = stats->min_value;
+	int max = stats->max_value;
+	uint64_t num_no_data = 0;
+	uint64_t num_negative = 0;
+	size_t i = 0;
+	if( count >= 16 ) {
+		// A no data value beyond 16 bits never matches
+		const bool no_data_fits = no_data >= INT16_MIN && no_data <= INT16_MAX;
+		const __m256i vno_data = _mm256_set1_epi16( (int16_t)( no_data_fits ? no_data : 0 ) );
+		const __m256i match = _mm256_set1_epi16( no_data_fits ? -1 : 0 );
+		__m256i vmin = _mm256_set1_epi16( INT16_MAX );
+		__m256i vmax = _mm256_set1_epi16( INT16_MIN );
+		uint64_t no_data_bits = 0;
+		uint64_t negative_bits = 0;
+		for( ; i + 16 <= count; i += 16 ) {
+			const __m256i v = _mm256_loadu_si256( (const __m256i *)( values + i ) );
+			vmin = _mm256_min_epi16( vmin, v );
+			vmax = _mm256_max_epi16( vmax, v );
+			const __m256i is_no_data = _mm256_and_si256( _mm256_cmpeq_epi16( v, vno_data ), match );
+			const __m256i is_negative = _mm256_cmpgt_epi16( _mm256_setzero_si256(), v );
+			no_data_bits += (uint64_t)__builtin_popcount( (uint32_t)_mm256_movemask_epi8( is_no_data ) );
+			negative_bits += (uint64_t)__builtin_popcount(
+					(uint32_t)_mm256_movemask_epi8( _mm256_andnot_si256( is_no_data, is_negative ) ) );
+			_mm256_storeu_si256( (__m256i *)( out + i ),
+					_mm256_andnot_si256( _mm256_or_si256( is_no_data, is_negative ), v ) );
+		}
+		int16_t lanes_min[16], lanes_max[16];
+		_mm256_storeu_si256( (__m256i *)lanes_min, vmin );
+		_mm256_storeu_si256( (__m256i *)lanes_max, vmax );
+		int lo = INT16_MAX, hi = INT16_MIN;
+		for( unsigned k = 0; k < 16; ++k ) {
+			lo = lanes_min[k] < lo ? lanes_min[k] : lo;
+			hi = lanes_max[k] > hi ? lanes_max[k] : hi;
+		}
+		min = lo < min ? lo : min;
+		max = hi > max ? hi : max;
+		num_no_data = no_data_bits / 2;
+		num_negative = negative_bits / 2;
+	}
+	for( ; i < count; ++i )
+		clamp_scalar( values[i], no_data, &out[i], &min, &max, &num_no_data, &num_negative );
+	stats->min_value = min;
+	stats->max_value = max;
+	stats->no_data_count += num_no_data;
+	stats->negative_count += num_negative;
+}
+#else
+void height_clamp_i32( const int32_t *values, const size_t count, const int no_data, uint16_t *out,
+		asc_parse_stats_t *stats ) {
+	int min = stats->min_value;
+	int max = stats->max_value;
+	uint64_t num_no_data = 0;
+	uint64_t num_negative = 0;
+	for( size_t i = 0; i < count; ++i )
+		clamp_scalar( values[i], no_data, &out[i], &min, &max, &num_no_data, &num_negative );
+	stats->min_value = min;
+	stats->max_value = max;
+	stats->no_data_count += num_no_data;
+	stats->negative_count += num_negative;
+}
+
+void height_clamp_i16( const int16_t *values, const size_t count, const int no_data, uint16_t *out,
+		asc_parse_stats_t *stats ) {
+	int min = stats->min_value;
+	int max = stats->max_value;
+	uint64_t num_no_data = 0;
+	uint64_t num_negative = 0;
+	for( size_t i = 0; i < count; ++i )
+		clamp_scalar( values[i], no_data, &out[i], &min, &max, &num_no_data, &num_negative );
+	stats->min_value = min;
+	stats->max_value = max;
+	stats->no_data_count += num_no_data;
+	stats->negative_count += num_negative;
+}
+#endif
@@ -0,0 +1,19 @@
+/* Turns raw heights into the posts the converter keeps: no data and negative values, which
+ * is mostly sea, become 0 and heights above 65535 saturate. In the same pass it gathers the
+ * statistics of the raw values, min/max and the number of no data and negative posts.
+ * AVX2 or plain C, chosen at compile time. */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "asc_parser.h"
+
+/* Clamps count values into out and merges their min/max and no data and negative counts into
+ * stats. The value count of stats is left to the caller. */
+extern void height_clamp_i32( const int32_t *values, const size_t count, const int no_data, uint16_t *out,
+		asc_parse_stats_t *stats );
+
+// The same for 16 bit input, e.g. binary srtm tiles
+extern void height_clamp_i16( const int16_t *values, const size_t count, const int no_data, uint16_t *out,
+		asc_parse_stats_t *stats );
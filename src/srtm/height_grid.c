@@ -0,0 +1,209 @@
+#define _GNU_SOURCE		// MADV_HUGEPAGE
+#include "height_grid.h"
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// Below this size huge pages are of no use
+#define HUGE_PAGE_SIZE ( 2u << 20 )
+
+bool height_grid_create(
+		const uint32_t width, const uint32_t height, const bool huge_pages, height_grid_t *grid ) {
+	const size_t posts_per_line = HEIGHT_GRID_ALIGNMENT / sizeof(uint16_t);
+	memset( grid, 0, sizeof(*grid) );
+	grid->width = width;
+	grid->height = height;
+	grid->stride = ( (size_t)width + posts_per_line - 1 ) / posts_per_line * posts_per_line;
+	const size_t size = grid->stride * height * sizeof(uint16_t);
+	if( size == 0 )
+		return false;
+	if( huge_pages && size >= HUGE_PAGE_SIZE ) {
+		const size_t mapped_size = ( size + HUGE_PAGE_SIZE - 1 ) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+		void *data = mmap( NULL, mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+		if( data != MAP_FAILED ) {
+#ifdef MADV_HUGEPAGE
+			madvise( data, mapped_size, MADV_HUGEPAGE );
+#endif
+			grid->data = data;
+			grid->alloc_size = mapped_size;
+			grid->mapped = true;
+			return true;
+		}
+	}
+	// aligned_alloc wants a multiple of the alignment, which size is
+	grid->data = aligned_alloc( HEIGHT_GRID_ALIGNMENT, size );
+	grid->alloc_size = grid->data ? size : 0;
+	return grid->data != NULL;
+}
+
+void height_grid_destroy( height_grid_t *grid ) {
+	if( grid->mapped )
+		munmap( grid->data, grid->alloc_size );
+	else if( grid->alloc_size )
+		free( grid->data );
+	memset( grid, 0, sizeof(*grid) );
+}
+
+height_grid_t *height_grid_view( const height_grid_t *const grid, const uint32_t col, const uint32_t row,
+		const uint32_t width, const uint32_t height, height_grid_t *view ) {
+	memset( view, 0, sizeof(*view) );
+	view->width = width;
+	view->height = height;
+	view->stride = grid->stride;
+	view->data = height_grid_row( grid, row ) + col;
+	return view;
+}
+
+// Min and max of n posts, n > 0
+#if defined(__AVX2__)
+static inline void posts_min_max( const uint16_t *p, const uint32_t n, uint16_t *min, uint16_t *max ) {
+	uint32_t i = 0;
+	uint16_t lo = p[0];
+	uint16_t hi = p[0];
+	if( n >= 16 ) {
+		__m256i vmin = _mm256_loadu_si256( (const __m256i *)p );
+		__m256i vmax = vmin;
+		for( i = 16; i + 16 <= n; i += 16 ) {
+			const __m256i v = _mm256_loadu_si256( (const __m256i *)( p + i ) );
+			vmin = _mm256_min_epu16( vmin, v );
+			vmax = _mm256_max_epu16( vmax, v );
+		}
+		// Reduce, the unsigned min of 8 lanes is a single instruction
+		__m128i m = _mm_min_epu16( _mm256_castsi256_si128( vmin ), _mm256_extracti128_si256( vmin, 1 ) );
+		lo = (uint16_t)_mm_cvtsi128_si32( _mm_minpos_epu16( m ) );
+		// max(x) = ~min(~x)
+		m = _mm_max_epu16( _mm256_castsi256_si128( vmax ), _mm256_extracti128_si256( vmax, 1 ) );
+		hi = (uint16_t)~_mm_cvtsi128_si32( _mm_minpos_epu16( _mm_xor_si128( m, _mm_set1_epi16( -1 ) ) ) );
+	}
+	for( ; i < n; ++i ) {
+		lo = lo > p[i] ? p[i] : lo;
+		hi = hi < p[i] ? p[i] : hi;
+	}
+	*min = lo;
+	*max = hi;
+}
+#else
+static inline void posts_min_max( const uint16_t *p, const uint32_t n, uint16_t *min, uint16_t *max ) {
+	uint16_t lo = p[0];
+	uint16_t hi = p[0];
+	for( uint32_t i = 1; i < n; ++i ) {
+		lo = lo > p[i] ? p[i] : lo;
+		hi = hi < p[i] ? p[i] : hi;
+	}
+	*min = lo;
+	*max = hi;
+}
+#endif
+
+// Number of the n posts at value
+#if defined(__AVX2__)
+static inline uint32_t posts_count( const uint16_t *p, const uint32_t n, const uint16_t value ) {
+	const __m256i v = _mm256_set1_epi16( (int16_t)value );
+	uint32_t i = 0;
+	// two mask bits per post
+	uint32_t bits = 0;
+	for( ; i + 16 <= n; i += 16 ) {
+		const __m256i eq = _mm256_cmpeq_epi16( _mm256_loadu_si256( (const __m256i *)( p + i ) ), v );
+		bits += (uint32_t)__builtin_popcount( (uint32_t)_mm256_movemask_epi8( eq ) );
+	}
+	uint32_t count = bits / 2;
+	for( ; i < n; ++i )
+		count += p[i] == value;
+	return count;
+}
+#else
+static inline uint32_t posts_count( const uint16_t *p, const uint32_t n, const uint16_t value ) {
+	uint32_t count = 0;
+	for( uint32_t i = 0; i < n; ++i )
+		count += p[i] == value;
+	return count;
+}
+#endif
+
+uint64_t height_grid_count( const height_grid_t *const grid, const uint16_t value ) {
+	uint64_t count = 0;
+	for( uint32_t r = 0; r < grid->height; ++r )
+		count += posts_count( height_grid_row( grid, r ), grid->width, value );
+	return count;
+}
+
+void height_grid_copy_window( const height_grid_t *const src, const uint32_t col, const uint32_t row,
+		height_grid_t *dst, uint16_t *min, uint16_t *max ) {
+	uint16_t min_y = 65535;
+	uint16_t max_y = 0;
+	for( uint32_t r = 0; r < dst->height; ++r ) {
+		const uint16_t *const from = height_grid_row( src, row + r ) + col;
+		uint16_t *const to = height_grid_row( dst, r );
+		memcpy( to, from, dst->width * sizeof(uint16_t) );
+		uint16_t lo, hi;
+		posts_min_max( to, dst->width, &lo, &hi );
+		min_y = min_y > lo ? lo : min_y;
+		max_y = max_y < hi ? hi : max_y;
+	}
+	*min = min_y;
+	*max = max_y;
+}
+
+void height_grid_copy_clamped( const height_grid_t *const src, const int64_t col, const int64_t row,
+		const uint32_t num_columns, const uint32_t num_rows, height_grid_t *dst ) {
+	const int64_t last_col = ( num_columns < src->width ? num_columns : src->width ) - 1;
+	const int64_t last_row = ( num_rows < src->height ? num_rows : src->height ) - 1;
+	// Columns of dst before, in and after the inside of src
+	const int64_t past = col + dst->width - last_col - 1;
+	const uint32_t before = col < 0 ? (uint32_t)( -col < dst->width ? -col : dst->width ) : 0;
+	const uint32_t after = past > 0 ? (uint32_t)( past < dst->width ? past : dst->width ) : 0;
+	const uint32_t inside = before + after < dst->width ? dst->width - before - after : 0;
+	for( uint32_t r = 0; r < dst->height; ++r ) {
+		const int64_t source_row = row + r < 0 ? 0 : row + r > last_row ? last_row : row + r;
+		const uint16_t *const from = height_grid_row( src, (uint32_t)source_row );
+		uint16_t *const to = height_grid_row( dst, r );
+		for( uint32_t c = 0; c < before; ++c )
+			to[c] = from[0];
+		if( inside > 0 )
+			memcpy( to + before, from + col + before, inside * sizeof(uint16_t) );
+		for( uint32_t c = dst->width - after; c < dst->width; ++c )
+			to[c] = from[last_col];
+	}
+}
+
+void height_grid_copy_window_patches( const height_grid_t *const src, const uint32_t col, const uint32_t row,
+		height_grid_t *dst, const uint32_t patch_size, uint16_t *patch_min, uint16_t *patch_max,
+		uint16_t *min, uint16_t *max ) {
+	const uint32_t num_patches = ( dst->width - 1 + patch_size - 1 ) / patch_size;
+	const uint32_t num_patch_rows = ( dst->height - 1 + patch_size - 1 ) / patch_size;
+	for( uint32_t i = 0; i < num_patches * num_patch_rows; ++i ) {
+		patch_min[i] = 65535;
+		patch_max[i] = 0;
+	}
+	for( uint32_t r = 0; r < dst->height; ++r ) {
+		const uint16_t *const from = height_grid_row( src, row + r ) + col;
+		uint16_t *const to = height_grid_row( dst, r );
+		memcpy( to, from, dst->width * sizeof(uint16_t) );
+		// The row is in the patch row below it, and the one above if it is its last row
+		const uint32_t patch_row = r / patch_size < num_patch_rows ? r / patch_size : num_patch_rows - 1;
+		const bool shared = r > 0 && r % patch_size == 0 && r / patch_size < num_patch_rows;
+		for( uint32_t p = 0; p < num_patches; ++p ) {
+			const uint32_t first = p * patch_size;
+			const uint32_t last = first + patch_size < dst->width - 1 ? first + patch_size : dst->width - 1;
+			uint16_t lo, hi;
+			posts_min_max( to + first, last - first + 1, &lo, &hi );
+			for( uint32_t i = shared ? patch_row - 1 : patch_row; i <= patch_row; ++i ) {
+				uint16_t *const pmin = &patch_min[i * num_patches + p];
+				uint16_t *const pmax = &patch_max[i * num_patches + p];
+				*pmin = *pmin > lo ? lo : *pmin;
+				*pmax = *pmax < hi ? hi : *pmax;
+			}
+		}
+	}
+	uint16_t min_y = 65535;
+	uint16_t max_y = 0;
+	for( uint32_t i = 0; i < num_patches * num_patch_rows; ++i ) {
+		min_y = min_y > patch_min[i] ? patch_min[i] : min_y;
+		max_y = max_y < patch_max[i] ? patch_max[i] : max_y;
+	}
+	*min = min_y;
+	*max = max_y;
+}
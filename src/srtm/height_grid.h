@@ -0,0 +1,59 @@
+/* A rectangle of 16 bit height posts in row major order. Rows are stride posts apart
+ * and start on 64 byte boundaries when the grid owns its memory; views into another
+ * grid share the memory of that grid. */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Row alignment in bytes
+#define HEIGHT_GRID_ALIGNMENT 64
+
+typedef struct height_grid_t {
+	uint32_t width;
+	uint32_t height;
+	// distance between the starts of two rows in posts
+	size_t stride;
+	uint16_t *data;
+	// bytes owned by the grid, 0 for views
+	size_t alloc_size;
+	bool mapped;
+} height_grid_t;
+
+/* Allocates an uninitialized grid. With huge_pages the memory is mapped and transparent
+ * huge pages are requested, which spares tlb misses on large grids. */
+extern bool height_grid_create(
+		const uint32_t width, const uint32_t height, const bool huge_pages, height_grid_t *grid );
+
+extern void height_grid_destroy( height_grid_t *grid );
+
+// A window of width x height posts starting at col/row that shares the memory of grid
+extern height_grid_t *height_grid_view( const height_grid_t *const grid, const uint32_t col, const uint32_t row,
+		const uint32_t width, const uint32_t height, height_grid_t *view );
+
+/* Copies the window of the size of dst starting at col/row of src into dst, row by row.
+ * Returns the min and max height of the window in min/max. */
+extern void height_grid_copy_window( const height_grid_t *const src, const uint32_t col, const uint32_t row,
+		height_grid_t *dst, uint16_t *min, uint16_t *max );
+
+/* Same as height_grid_copy_window, and the min/max of the patches of patch_size x patch_size posts
+ * of dst, row by row in patch_min/patch_max. A patch includes the first row and column of the next
+ * one; there are ( width - 1 + patch_size - 1 ) / patch_size patches per row. */
+extern void height_grid_copy_window_patches( const height_grid_t *const src, const uint32_t col, const uint32_t row,
+		height_grid_t *dst, const uint32_t patch_size, uint16_t *patch_min, uint16_t *patch_max,
+		uint16_t *min, uint16_t *max );
+
+/* Copies the window of the size of dst starting at col/row of src into dst, row by row. The window
+ * may reach beyond the first num_columns/num_rows posts of src, also to negative col/row; posts
+ * beyond them repeat the nearest one inside. */
+extern void height_grid_copy_clamped( const height_grid_t *const src, const int64_t col, const int64_t row,
+		const uint32_t num_columns, const uint32_t num_rows, height_grid_t *dst );
+
+// Number of posts of grid at value, e.g. 0 for no data and sea
+extern uint64_t height_grid_count( const height_grid_t *const grid, const uint16_t value );
+
+static inline uint16_t *height_grid_row( const height_grid_t *const grid, const uint32_t row ) {
+	return grid->data + (size_t)row * grid->stride;
+}
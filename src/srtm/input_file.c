@@ -0,0 +1,84 @@
+#define _GNU_SOURCE		// MADV_HUGEPAGE
+#include "input_file.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Size of the buffer for streamed input
+#define READ_CHUNK_SIZE ( 16u << 20 )
+
+bool input_file_open( const char *const path, input_file_t *in ) {
+	memset( in, 0, sizeof(*in) );
+	in->fd = strcmp( path, "-" ) == 0 ? STDIN_FILENO : open( path, O_RDONLY );
+	if( in->fd < 0 ) {
+		fprintf( stderr, "Error opening input file '%s': %s\n", path, strerror(errno) );
+		return false;
+	}
+	struct stat st;
+	if( fstat( in->fd, &st ) == 0 && S_ISREG( st.st_mode ) && st.st_size > 0 ) {
+		void *map = mmap( NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, in->fd, 0 );
+		if( map != MAP_FAILED ) {
+			// Only hints, the kernel may ignore both
+			madvise( map, (size_t)st.st_size, MADV_SEQUENTIAL );
+#ifdef MADV_HUGEPAGE
+			madvise( map, (size_t)st.st_size, MADV_HUGEPAGE );
+#endif
+			in->data = map;
+			in->size = (size_t)st.st_size;
+			in->bytes_read = in->size;
+			in->mapped = true;
+			in->eof = true;
+			return true;
+		}
+	}
+	// Pipes and anything that can't be mapped are streamed
+	in->capacity = READ_CHUNK_SIZE;
+	in->buffer = malloc( in->capacity );
+	in->data = in->buffer;
+	const char *pos = in->data;
+	if( !in->buffer || ( !input_file_refill( in, &pos ) && in->size == 0 ) ) {
+		fprintf( stderr, "Error reading input file '%s'\n", path );
+		input_file_close( in );
+		return false;
+	}
+	return true;
+}
+
+bool input_file_refill( input_file_t *in, const char **pos ) {
+	if( in->eof )
+		return false;
+	const size_t rest = (size_t)( in->data + in->size - *pos );
+	memmove( in->buffer, *pos, rest );
+	size_t filled = rest;
+	while( filled < in->capacity ) {
+		const ssize_t n = read( in->fd, in->buffer + filled, in->capacity - filled );
+		if( n < 0 && errno == EINTR )
+			continue;
+		if( n <= 0 ) {
+			if( n < 0 )
+				fprintf( stderr, "Error reading input: %s\n", strerror(errno) );
+			in->eof = true;
+			break;
+		}
+		filled += (size_t)n;
+	}
+	in->bytes_read += filled - rest;
+	in->size = filled;
+	*pos = in->data;
+	return filled > rest;
+}
+
+void input_file_close( input_file_t *in ) {
+	if( in->mapped )
+		munmap( (void *)in->data, in->size );
+	free( in->buffer );
+	if( in->fd > STDIN_FILENO )
+		close( in->fd );
+	memset( in, 0, sizeof(*in) );
+	in->fd = -1;
+}
@@ -0,0 +1,32 @@
+/* Read access to an input file. Regular files are memory mapped as a whole and parsed
+ * in place, pipes and stdin ("-") are read in chunks into a buffer. */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef struct input_file_t {
+	int fd;
+	// The whole file when mapped, otherwise the current chunk
+	const char *data;
+	size_t size;
+	// Streaming buffer
+	char *buffer;
+	size_t capacity;
+	// Bytes delivered so far
+	uint64_t bytes_read;
+	bool mapped;
+	bool eof;
+} input_file_t;
+
+// Maps or opens the file and makes the first bytes available in data
+extern bool input_file_open( const char *const path, input_file_t *in );
+
+/* Streaming only: keeps the bytes from *pos to the end of data, appends the next chunk of
+ * the file and points *pos to the kept bytes again. Returns false at the end of the file
+ * or on error. A mapped file is always at its end. */
+extern bool input_file_refill( input_file_t *in, const char **pos );
+
+extern void input_file_close( input_file_t *in );
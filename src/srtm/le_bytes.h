@@ -0,0 +1,52 @@
+/* Stores and loads little endian values at unaligned positions, for file headers. */
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+static inline void store_u16( unsigned char *p, const uint16_t v ) {
+	p[0] = (unsigned char)v;
+	p[1] = (unsigned char)( v >> 8 );
+}
+
+static inline void store_u32( unsigned char *p, const uint32_t v ) {
+	for( unsigned i = 0; i < 4; ++i )
+		p[i] = (unsigned char)( v >> 8*i );
+}
+
+static inline void store_u64( unsigned char *p, const uint64_t v ) {
+	for( unsigned i = 0; i < 8; ++i )
+		p[i] = (unsigned char)( v >> 8*i );
+}
+
+static inline void store_f64( unsigned char *p, const double d ) {
+	uint64_t v;
+	memcpy( &v, &d, sizeof(v) );
+	store_u64( p, v );
+}
+
+static inline uint16_t load_u16( const unsigned char *p ) {
+	return (uint16_t)( p[0] | p[1] << 8 );
+}
+
+static inline uint32_t load_u32( const unsigned char *p ) {
+	uint32_t v = 0;
+	for( unsigned i = 0; i < 4; ++i )
+		v |= (uint32_t)p[i] << 8*i;
+	return v;
+}
+
+static inline uint64_t load_u64( const unsigned char *p ) {
+	uint64_t v = 0;
+	for( unsigned i = 0; i < 8; ++i )
+		v |= (uint64_t)p[i] << 8*i;
+	return v;
+}
+
+static inline double load_f64( const unsigned char *p ) {
+	const uint64_t v = load_u64( p );
+	double d;
+	memcpy( &d, &v, sizeof(d) );
+	return d;
+}
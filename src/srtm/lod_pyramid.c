@@ -0,0 +1,134 @@
+#include "lod_pyramid.h"
+#include "tile_pool.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Rows of the coarser level per job
+#define BAND_ROWS 64
+
+const char *lod_filter_name( const lod_filter_t filter ) {
+	return filter == LOD_FILTER_MAX ? "max" : "box";
+}
+
+bool lod_filter_find( const char *const name, lod_filter_t *filter ) {
+	if( strcmp( name, "box" ) == 0 )
+		*filter = LOD_FILTER_BOX;
+	else if( strcmp( name, "max" ) == 0 )
+		*filter = LOD_FILTER_MAX;
+	else
+		return false;
+	return true;
+}
+
+uint32_t lod_num_levels( const uint32_t num_h_tiles, const uint32_t num_v_tiles ) {
+	uint32_t levels = 1;
+	while( lod_level_tiles( num_h_tiles, levels - 1 ) > 1 || lod_level_tiles( num_v_tiles, levels - 1 ) > 1 )
+		++levels;
+	return levels;
+}
+
+static inline uint32_t clamp_post( const int64_t i, const uint32_t size ) {
+	return i < 0 ? 0 : i >= size ? size - 1 : (uint32_t)i;
+}
+
+static inline uint32_t combine( const lod_filter_t filter, const uint32_t a, const uint32_t b, const uint32_t c ) {
+	if( filter == LOD_FILTER_MAX ) {
+		const uint32_t ab = a > b ? a : b;
+		return ab > c ? ab : c;
+	}
+	return a + b + c;
+}
+
+// Sum or max of three rows, kept simple so the compiler vectorizes it
+static void combine_rows( const lod_filter_t filter, const uint16_t *a, const uint16_t *b, const uint16_t *c,
+		const uint32_t width, uint32_t *out ) {
+	if( filter == LOD_FILTER_MAX ) {
+		for( uint32_t i = 0; i < width; ++i ) {
+			const uint16_t ab = a[i] > b[i] ? a[i] : b[i];
+			out[i] = ab > c[i] ? ab : c[i];
+		}
+	} else {
+		for( uint32_t i = 0; i < width; ++i )
+			out[i] = (uint32_t)a[i] + b[i] + c[i];
+	}
+}
+
+static inline uint16_t finish( const lod_filter_t filter, const uint32_t value ) {
+	return filter == LOD_FILTER_MAX ? (uint16_t)value : (uint16_t)( ( value + 4 ) / 9 );
+}
+
+// Post i from posts 2i-1, 2i, 2i+1 of the combined rows, clamped to the posts there are
+static inline uint16_t clamped_post( const lod_filter_t filter, const uint32_t *rows, const uint32_t width,
+		const uint32_t i ) {
+	const int64_t c = 2 * (int64_t)i;
+	return finish( filter, combine( filter, rows[clamp_post( c - 1, width )], rows[clamp_post( c, width )],
+			rows[clamp_post( c + 1, width )] ) );
+}
+
+static void filter_row( const lod_filter_t filter, const uint32_t *rows, const uint32_t width,
+		uint16_t *out, const uint32_t out_width ) {
+	// Inside all three posts exist
+	const uint32_t inner_end = width / 2 < out_width ? width / 2 : out_width;
+	for( uint32_t i = 1; i < inner_end; ++i )
+		out[i] = finish( filter, combine( filter, rows[2*i-1], rows[2*i], rows[2*i+1] ) );
+	// Edges and padding
+	out[0] = clamped_post( filter, rows, width, 0 );
+	for( uint32_t i = inner_end > 1 ? inner_end : 1; i < out_width; ++i )
+		out[i] = clamped_post( filter, rows, width, i );
+}
+
+typedef struct downsample_jobs_t {
+	const height_grid_t *src;
+	height_grid_t *dst;
+	lod_filter_t filter;
+	// a combined row per worker
+	uint32_t **rows;
+} downsample_jobs_t;
+
+static bool downsample_band( void *context, const unsigned worker, const uint32_t job, FILE *log ) {
+	(void)log;
+	const downsample_jobs_t *const jobs = context;
+	const height_grid_t *const src = jobs->src;
+	uint32_t *const rows = jobs->rows[worker];
+	const uint32_t first = job * BAND_ROWS;
+	const uint32_t last = first + BAND_ROWS < jobs->dst->height ? first + BAND_ROWS : jobs->dst->height;
+	for( uint32_t r = first; r < last; ++r ) {
+		const int64_t s = 2 * (int64_t)r;
+		combine_rows( jobs->filter, height_grid_row( src, clamp_post( s - 1, src->height ) ),
+				height_grid_row( src, clamp_post( s, src->height ) ),
+				height_grid_row( src, clamp_post( s + 1, src->height ) ), src->width, rows );
+		filter_row( jobs->filter, rows, src->width, height_grid_row( jobs->dst, r ), jobs->dst->width );
+	}
+	return true;
+}
+
+bool lod_downsample( const height_grid_t *const src, const lod_filter_t filter,
+		height_grid_t *dst, const unsigned num_threads ) {
+	uint32_t *rows[num_threads];
+	bool ok = true;
+	for( unsigned i = 0; i < num_threads; ++i )
+		ok &= ( rows[i] = malloc( src->width * sizeof(uint32_t) ) ) != NULL;
+	downsample_jobs_t jobs = { src, dst, filter, rows };
+	ok = ok && tile_pool_run( num_threads, ( dst->height + BAND_ROWS - 1 ) / BAND_ROWS, downsample_band, &jobs );
+	for( unsigned i = 0; i < num_threads; ++i )
+		free( rows[i] );
+	return ok;
+}
+
+bool lod_downsample_bordered( const height_grid_t *const src, const lod_filter_t filter,
+		height_grid_t *dst ) {
+	if( src->width < 2 * dst->width + 1 || src->height < 2 * dst->height + 1 )
+		return false;
+	uint32_t *rows = malloc( src->width * sizeof(uint32_t) );
+	if( !rows )
+		return false;
+	for( uint32_t r = 0; r < dst->height; ++r ) {
+		combine_rows( filter, height_grid_row( src, 2 * r ), height_grid_row( src, 2 * r + 1 ),
+				height_grid_row( src, 2 * r + 2 ), src->width, rows );
+		uint16_t *const out = height_grid_row( dst, r );
+		for( uint32_t i = 0; i < dst->width; ++i )
+			out[i] = finish( filter, combine( filter, rows[2*i], rows[2*i+1], rows[2*i+2] ) );
+	}
+	free( rows );
+	return true;
+}
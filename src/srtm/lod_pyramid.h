@@ -0,0 +1,41 @@
+/* Coarser levels of detail of the height grid for the terrain lod. Level 0 is the input,
+ * post i of level n+1 sits on post 2i of level n, so a level n+1 tile covers 2x2 tiles of
+ * level n and keeps their 1 post overlap. Levels are padded to whole tiles by repeating
+ * the last post of the level below. */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "height_grid.h"
+
+typedef enum lod_filter_t {
+	// average of the 3x3 posts around the post of the level below
+	LOD_FILTER_BOX = 0,
+	// maximum of these, keeps peaks and ridges
+	LOD_FILTER_MAX = 1
+} lod_filter_t;
+
+extern const char *lod_filter_name( const lod_filter_t filter );
+
+extern bool lod_filter_find( const char *const name, lod_filter_t *filter );
+
+// Tiles along one axis at level when level 0 has num_tiles, which must be > 0
+static inline uint32_t lod_level_tiles( const uint32_t num_tiles, const uint32_t level ) {
+	return ( ( num_tiles - 1 ) >> level ) + 1;
+}
+
+// Number of levels down to a single tile, including level 0
+extern uint32_t lod_num_levels( const uint32_t num_h_tiles, const uint32_t num_v_tiles );
+
+/* Fills dst, the next coarser level, from src with num_threads threads. dst is created
+ * by the caller and may be larger than half of src, posts beyond src repeat its edge. */
+extern bool lod_downsample( const height_grid_t *const src, const lod_filter_t filter,
+		height_grid_t *dst, const unsigned num_threads );
+
+/* Fills dst from a window of the level below that has a border of one post around the posts
+ * dst sits on: post i of dst is filtered around post 2i+1 of src, which needs at least
+ * 2 * width + 1 columns and 2 * height + 1 rows. Edges are not clamped, for tiles that are
+ * made one at a time from windows the caller clamped to the level below. */
+extern bool lod_downsample_bordered( const height_grid_t *const src, const lod_filter_t filter,
+		height_grid_t *dst );
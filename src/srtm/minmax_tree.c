@@ -0,0 +1,112 @@
+#include "minmax_tree.h"
+#include "le_bytes.h"
+#include <stdlib.h>
+#include <string.h>
+
+bool minmax_tree_create( const uint32_t tilesize, const uint32_t patch_size, minmax_tree_t *tree ) {
+	memset( tree, 0, sizeof(*tree) );
+	tree->patch_size = patch_size;
+	tree->leaves = minmax_tree_leaves( tilesize, patch_size );
+	if( tree->leaves == 0 || ( tree->leaves & ( tree->leaves - 1 ) ) != 0 )
+		return false;
+	tree->num_levels = (uint32_t)__builtin_ctz( tree->leaves ) + 1;
+	const uint32_t num_nodes = minmax_tree_level_offset( tree->num_levels );
+	tree->min = malloc( 2 * num_nodes * sizeof(uint16_t) );
+	tree->max = tree->min ? tree->min + num_nodes : NULL;
+	return tree->min != NULL;
+}
+
+void minmax_tree_destroy( minmax_tree_t *tree ) {
+	free( tree->min );
+	memset( tree, 0, sizeof(*tree) );
+}
+
+void minmax_tree_build( minmax_tree_t *tree ) {
+	for( uint32_t level = tree->num_levels - 1; level > 0; --level ) {
+		const uint32_t n = 1u << level;
+		const uint16_t *const min = tree->min + minmax_tree_level_offset( level );
+		const uint16_t *const max = tree->max + minmax_tree_level_offset( level );
+		uint16_t *const up_min = tree->min + minmax_tree_level_offset( level - 1 );
+		uint16_t *const up_max = tree->max + minmax_tree_level_offset( level - 1 );
+		for( uint32_t r = 0; r < n / 2; ++r ) {
+			for( uint32_t c = 0; c < n / 2; ++c ) {
+				const uint32_t i = 2 * r * n + 2 * c;
+				uint16_t lo = min[i] < min[i+1] ? min[i] : min[i+1];
+				lo = lo < min[i+n] ? lo : min[i+n];
+				up_min[r * n / 2 + c] = lo < min[i+n+1] ? lo : min[i+n+1];
+				uint16_t hi = max[i] > max[i+1] ? max[i] : max[i+1];
+				hi = hi > max[i+n] ? hi : max[i+n];
+				up_max[r * n / 2 + c] = hi > max[i+n+1] ? hi : max[i+n+1];
+			}
+		}
+	}
+}
+
+bool minmax_tree_encode( const minmax_tree_t *const tree, byte_buffer_t *out ) {
+	const uint32_t num_nodes = minmax_tree_level_offset( tree->num_levels );
+	unsigned char h[MINMAX_TREE_HEADER_SIZE];
+	memcpy( h, MINMAX_TREE_MAGIC, 8 );
+	store_u32( h + 8, MINMAX_TREE_VERSION );
+	store_u32( h + 12, tree->patch_size );
+	store_u32( h + 16, tree->leaves );
+	store_u32( h + 20, tree->num_levels );
+	byte_buffer_clear( out );
+	if( !byte_buffer_append( out, h, sizeof(h) ) )
+		return false;
+	for( uint32_t i = 0; i < num_nodes; ++i ) {
+		unsigned char node[4];
+		store_u16( node, tree->min[i] );
+		store_u16( node + 2, tree->max[i] );
+		if( !byte_buffer_append( out, node, sizeof(node) ) )
+			return false;
+	}
+	return true;
+}
+
+/* Range of leaves of a child tile along one axis that share posts with the posts [first, last]
+ * of the level below, counted from the parent's origin. Returns false if there are none. */
+static bool child_leaf_range( const uint32_t tilesize, const uint32_t patch_size, const uint32_t leaves,
+		const uint32_t child, int64_t first, int64_t last, uint32_t *leaf_first, uint32_t *leaf_last ) {
+	first -= (int64_t)child * ( tilesize - 1 );
+	last -= (int64_t)child * ( tilesize - 1 );
+	first = first < 0 ? 0 : first;
+	last = last > tilesize - 1 ? tilesize - 1 : last;
+	if( first > last )
+		return false;
+	// Leaf k covers posts k * patch_size to ( k + 1 ) * patch_size
+	*leaf_first = first > 0 ? (uint32_t)( first - 1 ) / patch_size : 0;
+	*leaf_last = (uint32_t)last / patch_size < leaves - 1 ? (uint32_t)last / patch_size : leaves - 1;
+	return true;
+}
+
+void minmax_tree_leaves_from_children( const uint32_t tilesize, const minmax_tree_t *const tree,
+		const uint16_t *const child_min[4], const uint16_t *const child_max[4], uint16_t *leaf_min, uint16_t *leaf_max ) {
+	const uint32_t n = tree->leaves;
+	const uint32_t p = tree->patch_size;
+	for( uint32_t r = 0; r < n; ++r ) {
+		for( uint32_t c = 0; c < n; ++c ) {
+			// Posts of the leaf in the level below
+			const int64_t first_row = 2 * (int64_t)( r * p );
+			const int64_t last_row = 2 * (int64_t)( ( r + 1 ) * p < tilesize - 1 ? ( r + 1 ) * p : tilesize - 1 );
+			const int64_t first_col = 2 * (int64_t)( c * p );
+			const int64_t last_col = 2 * (int64_t)( ( c + 1 ) * p < tilesize - 1 ? ( c + 1 ) * p : tilesize - 1 );
+			uint16_t lo = 65535;
+			uint16_t hi = 0;
+			for( uint32_t child = 0; child < 4; ++child ) {
+				uint32_t r0, r1, c0, c1;
+				if( !child_min[child] ||
+					!child_leaf_range( tilesize, p, n, child / 2, first_row, last_row, &r0, &r1 ) ||
+					!child_leaf_range( tilesize, p, n, child % 2, first_col, last_col, &c0, &c1 ) )
+					continue;
+				for( uint32_t i = r0; i <= r1; ++i ) {
+					for( uint32_t j = c0; j <= c1; ++j ) {
+						lo = lo < child_min[child][i * n + j] ? lo : child_min[child][i * n + j];
+						hi = hi > child_max[child][i * n + j] ? hi : child_max[child][i * n + j];
+					}
+				}
+			}
+			leaf_min[r * n + c] = lo;
+			leaf_max[r * n + c] = hi;
+		}
+	}
+}
@@ -0,0 +1,70 @@
+/* Min/max quadtree of a tile for culling and lod selection per patch. The leaves are
+ * patches of patch_size x patch_size posts; a patch includes the first row and column of
+ * the next one, so the patches cover the tile without gaps. Each inner node holds the
+ * bounds of its 4 children, the root those of the tile.
+ * Written next to a tile as .mmq, all values little endian:
+ *  0 magic "SRTMMMQT"
+ *  8 uint32 version
+ * 12 uint32 patch size in posts
+ * 16 uint32 leaves per row and column
+ * 20 uint32 number of levels
+ * 24 nodes level by level from the root, level l has 2^l x 2^l nodes in rows from north
+ *    to south; per node uint16 min height, uint16 max height */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "byte_buffer.h"
+
+#define MINMAX_TREE_MAGIC "SRTMMMQT"
+#define MINMAX_TREE_VERSION 1
+#define MINMAX_TREE_HEADER_SIZE 24
+// Size of the leaf patches in posts
+#define MINMAX_TREE_PATCH_SIZE 64
+
+typedef struct minmax_tree_t {
+	uint32_t patch_size;
+	// per row and column, a power of 2
+	uint32_t leaves;
+	uint32_t num_levels;
+	// per node, level by level from the root
+	uint16_t *min;
+	uint16_t *max;
+} minmax_tree_t;
+
+// Patches per row and column of a tile
+static inline uint32_t minmax_tree_leaves( const uint32_t tilesize, const uint32_t patch_size ) {
+	return ( tilesize - 1 + patch_size - 1 ) / patch_size;
+}
+
+// Index of the first node of level
+static inline uint32_t minmax_tree_level_offset( const uint32_t level ) {
+	return ( ( 1u << ( 2 * level ) ) - 1 ) / 3;
+}
+
+// For tiles of tilesize posts, a power of 2 that is a multiple of patch_size
+extern bool minmax_tree_create( const uint32_t tilesize, const uint32_t patch_size, minmax_tree_t *tree );
+
+extern void minmax_tree_destroy( minmax_tree_t *tree );
+
+static inline uint16_t *minmax_tree_leaf_min( const minmax_tree_t *const tree ) {
+	return tree->min + minmax_tree_level_offset( tree->num_levels - 1 );
+}
+
+static inline uint16_t *minmax_tree_leaf_max( const minmax_tree_t *const tree ) {
+	return tree->max + minmax_tree_level_offset( tree->num_levels - 1 );
+}
+
+// Fills the inner nodes from the leaves
+extern void minmax_tree_build( minmax_tree_t *tree );
+
+// Encodes the tree as described above into out, which is cleared first
+extern bool minmax_tree_encode( const minmax_tree_t *const tree, byte_buffer_t *out );
+
+/* Leaves of a tile of the next coarser level of detail from the leaves of the 2x2 tiles
+ * below it, children[0] north west to children[3] south east, NULL where the level below
+ * has no tile. A leaf gets the bounds of all leaves below that share posts with it; leaves
+ * over padding without tiles below are empty, min > max. tilesize is that of both levels. */
+extern void minmax_tree_leaves_from_children( const uint32_t tilesize, const minmax_tree_t *const tree,
+		const uint16_t *const child_min[4], const uint16_t *const child_max[4], uint16_t *leaf_min, uint16_t *leaf_max );
@@ -0,0 +1,405 @@
+#include "mosaic.h"
+#include "asc_parallel.h"
+#include "tile_pool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// Rows of one input parsed by one job of a window read
+#define WINDOW_BAND_ROWS 64
+
+// How far, in cells, a corner may be off the grid of the mosaic, for rounding in the headers
+#define GRID_TOLERANCE 1e-3
+
+static bool add_input( mosaic_t *mosaic, const char *const path ) {
+	mosaic_input_t *inputs = realloc( mosaic->inputs, ( mosaic->num_inputs + 1 ) * sizeof(mosaic_input_t) );
+	if( !inputs )
+		return false;
+	mosaic->inputs = inputs;
+	mosaic_input_t *input = &inputs[mosaic->num_inputs++];
+	memset( input, 0, sizeof(*input) );
+	input->file.fd = -1;
+	asc_parse_stats_init( &input->stats );
+	if( !( input->path = strdup( path ) ) || !input_file_open( path, &input->file ) )
+		return false;
+	printf( "Mosaic input '%s':\n", path );
+	input->pos = input->file.data;
+	// Inputs may be smaller than a tile, only the mosaic must not
+	input->header.tilesize = 0;
+	if( !read_srtm_ascii_header( &input->pos, input->file.data + input->file.size, &input->header ) ) {
+		fprintf( stderr, "Error reading header of mosaic input '%s'\n", path );
+		return false;
+	}
+	input->row_buffer = malloc( input->header.num_columns * sizeof(uint16_t) );
+	mosaic->bytes += input->file.size;
+	return input->row_buffer != NULL;
+}
+
+char *mosaic_input_path( const char *const list_path, const char *const name ) {
+	const char *const slash = strrchr( list_path, '/' );
+	if( name[0] == '/' || !slash )
+		return strdup( name );
+	const size_t dir_length = (size_t)( slash - list_path ) + 1;
+	const size_t name_length = strlen( name );
+	char *const path = malloc( dir_length + name_length + 1 );
+	if( path ) {
+		memcpy( path, list_path, dir_length );
+		memcpy( path + dir_length, name, name_length + 1 );
+	}
+	return path;
+}
+
+static bool read_list( const char *const list_path, mosaic_t *mosaic ) {
+	FILE *list = fopen( list_path, "r" );
+	if( !list ) {
+		fprintf( stderr, "Error opening mosaic list '%s'\n", list_path );
+		return false;
+	}
+	char *line = NULL;
+	size_t capacity = 0;
+	ssize_t length;
+	bool ok = true;
+	while( ok && ( length = getline( &line, &capacity, list ) ) >= 0 ) {
+		while( length > 0 && ( line[length-1] == '\n' || line[length-1] == '\r' || line[length-1] == ' ' ) )
+			line[--length] = '\0';
+		if( length > 0 ) {
+			char *const path = mosaic_input_path( list_path, line );
+			ok = path && add_input( mosaic, path );
+			free( path );
+		}
+	}
+	free( line );
+	fclose( list );
+	if( ok && mosaic->num_inputs == 0 ) {
+		fprintf( stderr, "Mosaic list '%s' names no input\n", list_path );
+		ok = false;
+	}
+	return ok;
+}
+
+// Index of the post at coord, counted from origin; false if that is not on the grid
+static bool grid_index( const double coord, const double origin, const double cellsize, uint32_t *index ) {
+	const double cells = ( coord - origin ) / cellsize;
+	const double rounded = round( cells );
+	*index = (uint32_t)rounded;
+	return fabs( cells - rounded ) <= GRID_TOLERANCE;
+}
+
+static bool place_inputs( mosaic_t *mosaic, const uint32_t tilesize ) {
+	const srtm_header_t *const first = &mosaic->inputs[0].header;
+	const double cellsize = first->cellsize;
+	double west = first->longitude;
+	double north = first->latitude + first->num_rows * cellsize;
+	for( uint32_t i = 1; i < mosaic->num_inputs; ++i ) {
+		const srtm_header_t *const h = &mosaic->inputs[i].header;
+		if( fabs( h->cellsize - cellsize ) > cellsize * 1e-6 ) {
+			fprintf( stderr, "Cellsize %lf of '%s' differs from %lf of '%s'\n", h->cellsize,
+					mosaic->inputs[i].path, cellsize, mosaic->inputs[0].path );
+			return false;
+		}
+		west = h->longitude < west ? h->longitude : west;
+		north = h->latitude + h->num_rows * cellsize > north ? h->latitude + h->num_rows * cellsize : north;
+	}
+	srtm_header_t *const header = &mosaic->header;
+	for( uint32_t i = 0; i < mosaic->num_inputs; ++i ) {
+		mosaic_input_t *const input = &mosaic->inputs[i];
+		const srtm_header_t *const h = &input->header;
+		if( !grid_index( h->longitude, west, cellsize, &input->col ) ||
+			!grid_index( north, h->latitude + h->num_rows * cellsize, cellsize, &input->row ) ) {
+			fprintf( stderr, "Lower left corner of '%s' is not on the grid of '%s'\n", input->path,
+					mosaic->inputs[0].path );
+			return false;
+		}
+		header->num_columns = input->col + h->num_columns > header->num_columns ?
+				input->col + h->num_columns : header->num_columns;
+		header->num_rows = input->row + h->num_rows > header->num_rows ? input->row + h->num_rows : header->num_rows;
+		printf( "\t'%s' at col/row %u/%u\n", input->path, input->col, input->row );
+	}
+	header->longitude = west;
+	// From an input on the southern edge, which spares the rounding of north
+	header->latitude = north - header->num_rows * cellsize;
+	for( uint32_t i = 0; i < mosaic->num_inputs; ++i ) {
+		const mosaic_input_t *const input = &mosaic->inputs[i];
+		if( input->row + input->header.num_rows == header->num_rows )
+			header->latitude = input->header.latitude;
+	}
+	header->cellsize = cellsize;
+	header->no_data = first->no_data;
+	header->tilesize = tilesize;
+	if( header->num_columns < tilesize || header->num_rows < tilesize ) {
+		fputs( "Error, tile size > size of the mosaic\n", stderr );
+		return false;
+	}
+	return true;
+}
+
+static bool find_overlaps( mosaic_t *mosaic ) {
+	uint32_t shared = 0;
+	for( uint32_t i = 0; i < mosaic->num_inputs; ++i ) {
+		mosaic_input_t *const input = &mosaic->inputs[i];
+		input->overlaps = malloc( ( i + 1 ) * sizeof(uint32_t) );
+		if( !input->overlaps )
+			return false;
+		for( uint32_t j = 0; j < i; ++j ) {
+			const mosaic_input_t *const other = &mosaic->inputs[j];
+			if( input->col < other->col + other->header.num_columns && other->col < input->col + input->header.num_columns &&
+				input->row < other->row + other->header.num_rows && other->row < input->row + input->header.num_rows )
+				input->overlaps[input->num_overlaps++] = j;
+		}
+		shared += input->num_overlaps;
+	}
+	printf( "Mosaic of %u inputs, columns/rows %u/%u, %u pairs share posts\n", mosaic->num_inputs,
+			mosaic->header.num_columns, mosaic->header.num_rows, shared );
+	return true;
+}
+
+bool mosaic_open( const char *const list_path, const uint32_t tilesize, mosaic_t *mosaic ) {
+	memset( mosaic, 0, sizeof(*mosaic) );
+	if( !read_list( list_path, mosaic ) || !place_inputs( mosaic, tilesize ) || !find_overlaps( mosaic ) ) {
+		mosaic_close( mosaic );
+		return false;
+	}
+	return true;
+}
+
+bool mosaic_open_file( const char *const path, const uint32_t tilesize, mosaic_t *mosaic ) {
+	memset( mosaic, 0, sizeof(*mosaic) );
+	if( !add_input( mosaic, path ) || !place_inputs( mosaic, tilesize ) || !find_overlaps( mosaic ) ) {
+		mosaic_close( mosaic );
+		return false;
+	}
+	return true;
+}
+
+bool mosaic_index_rows( mosaic_t *mosaic ) {
+	for( uint32_t i = 0; i < mosaic->num_inputs; ++i ) {
+		mosaic_input_t *const input = &mosaic->inputs[i];
+		if( !input->file.mapped ) {
+			fprintf( stderr, "'%s' can't be read at random, it is not a regular file\n", input->path );
+			return false;
+		}
+		if( !row_index_open( input->path, input->file.data, input->pos, input->file.data + input->file.size,
+				&input->header, &input->index ) ) {
+			fprintf( stderr, "Error indexing the rows of '%s'\n", input->path );
+			return false;
+		}
+	}
+	return true;
+}
+
+// Parses the next row of the input into its row buffer, refilling the buffer of a streamed file as needed
+static bool read_input_row( mosaic_input_t *input ) {
+	const uint32_t num_columns = input->header.num_columns;
+	uint32_t j = 0;
+	while( true ) {
+		size_t parsed;
+		const char *next = asc_parse_values( input->pos, input->file.data + input->file.size, input->file.eof,
+				input->header.no_data, input->row_buffer + j, num_columns - j, &parsed, &input->stats );
+		if( !next ) {
+			fprintf( stderr, "'%s': error parsing value in row %u, column %u\n", input->path, input->next_row,
+					j + (uint32_t)parsed );
+			return false;
+		}
+		j += (uint32_t)parsed;
+		input->pos = next;
+		if( j == num_columns )
+			break;
+		if( !input_file_refill( &input->file, &input->pos ) ) {
+			fprintf( stderr, "'%s': unexpected end of data in row %u, column %u\n", input->path, input->next_row, j );
+			return false;
+		}
+	}
+	++input->next_row;
+	return true;
+}
+
+// Copies the posts of row that no input before this one in the list covers and that lie in the
+// columns [first, last) of the mosaic from the input's values to out, which holds column first on
+static void copy_owned( const mosaic_t *const mosaic, const mosaic_input_t *const input, const uint32_t row,
+		const uint16_t *const values, const uint32_t first, const uint32_t last, uint16_t *out ) {
+	const uint32_t begin = input->col > first ? input->col : first;
+	const uint32_t end = input->col + input->header.num_columns < last ? input->col + input->header.num_columns : last;
+	if( begin >= end )
+		return;
+	// Spans taken by others, sorted by their start
+	uint32_t span_begin[input->num_overlaps + 1];
+	uint32_t span_end[input->num_overlaps + 1];
+	uint32_t num_spans = 0;
+	for( uint32_t i = 0; i < input->num_overlaps; ++i ) {
+		const mosaic_input_t *const other = &mosaic->inputs[input->overlaps[i]];
+		if( row < other->row || row >= other->row + other->header.num_rows )
+			continue;
+		const uint32_t b = other->col > begin ? other->col : begin;
+		const uint32_t e = other->col + other->header.num_columns < end ? other->col + other->header.num_columns : end;
+		if( b >= e )
+			continue;
+		uint32_t k = num_spans++;
+		for( ; k > 0 && span_begin[k-1] > b; --k ) {
+			span_begin[k] = span_begin[k-1];
+			span_end[k] = span_end[k-1];
+		}
+		span_begin[k] = b;
+		span_end[k] = e;
+	}
+	uint32_t c = begin;
+	for( uint32_t i = 0; i < num_spans; ++i ) {
+		if( span_begin[i] > c )
+			memcpy( out + ( c - first ), values + ( c - input->col ), ( span_begin[i] - c ) * sizeof(uint16_t) );
+		c = span_end[i] > c ? span_end[i] : c;
+	}
+	if( c < end )
+		memcpy( out + ( c - first ), values + ( c - input->col ), ( end - c ) * sizeof(uint16_t) );
+}
+
+typedef struct read_jobs_t {
+	mosaic_t *mosaic;
+	uint32_t first;
+	uint32_t count;
+	height_grid_t *grid;
+	uint32_t grid_row;
+	// inputs that cover the rows
+	const uint32_t *inputs;
+} read_jobs_t;
+
+static bool read_input_job( void *context, const unsigned worker, const uint32_t job, FILE *log ) {
+	(void)worker;
+	(void)log;
+	const read_jobs_t *const jobs = context;
+	mosaic_input_t *const input = &jobs->mosaic->inputs[jobs->inputs[job]];
+	const uint32_t begin = jobs->first > input->row ? jobs->first : input->row;
+	const uint32_t end = jobs->first + jobs->count < input->row + input->header.num_rows ?
+			jobs->first + jobs->count : input->row + input->header.num_rows;
+	if( input->next_row != begin - input->row ) {
+		fprintf( stderr, "'%s': rows must be read in order, next is %u, not %u\n", input->path,
+				input->next_row, begin - input->row );
+		return false;
+	}
+	asc_parse_stats_init( &input->stats );
+	for( uint32_t r = begin; r < end; ++r ) {
+		if( !read_input_row( input ) )
+			return false;
+		copy_owned( jobs->mosaic, input, r, input->row_buffer, 0, jobs->mosaic->header.num_columns,
+				height_grid_row( jobs->grid, jobs->grid_row + r - jobs->first ) );
+	}
+	return true;
+}
+
+bool mosaic_read_rows( mosaic_t *mosaic, const uint32_t first, const uint32_t count,
+		height_grid_t *grid, const uint32_t grid_row, const unsigned num_threads, asc_parse_stats_t *stats ) {
+	// Posts no input covers stay 0
+	for( uint32_t r = 0; r < count; ++r )
+		memset( height_grid_row( grid, grid_row + r ), 0, mosaic->header.num_columns * sizeof(uint16_t) );
+	uint32_t inputs[mosaic->num_inputs];
+	uint32_t num_jobs = 0;
+	for( uint32_t i = 0; i < mosaic->num_inputs; ++i ) {
+		const mosaic_input_t *const input = &mosaic->inputs[i];
+		if( input->row < first + count && first < input->row + input->header.num_rows )
+			inputs[num_jobs++] = i;
+	}
+	read_jobs_t jobs = { mosaic, first, count, grid, grid_row, inputs };
+	if( !tile_pool_run( num_threads, num_jobs, read_input_job, &jobs ) )
+		return false;
+	for( uint32_t i = 0; i < num_jobs; ++i )
+		asc_parse_stats_merge( stats, &mosaic->inputs[inputs[i]].stats );
+	return true;
+}
+
+// A band of rows of one input
+typedef struct window_band_t {
+	uint32_t input;
+	uint32_t begin;
+	uint32_t end;
+	asc_parse_stats_t stats;
+} window_band_t;
+
+typedef struct window_jobs_t {
+	const mosaic_t *mosaic;
+	uint32_t col;
+	uint32_t row;
+	uint32_t width;
+	height_grid_t *grid;
+	window_band_t *bands;
+} window_jobs_t;
+
+static bool read_band_job( void *context, const unsigned worker, const uint32_t job, FILE *log ) {
+	(void)worker;
+	(void)log;
+	const window_jobs_t *const jobs = context;
+	window_band_t *const band = &jobs->bands[job];
+	const mosaic_input_t *const input = &jobs->mosaic->inputs[band->input];
+	const uint32_t num_columns = input->header.num_columns;
+	uint16_t *values = malloc( num_columns * sizeof(uint16_t) );
+	if( !values ) {
+		fputs( "Error allocating row buffer\n", stderr );
+		return false;
+	}
+	const char *const end = input->file.data + input->file.size;
+	// The rows of a band follow each other
+	const char *pos = row_index_row( &input->index, input->file.data, end, band->begin - input->row );
+	bool ok = pos != NULL;
+	for( uint32_t r = band->begin; ok && r < band->end; ++r ) {
+		size_t parsed;
+		pos = asc_parse_values( pos, end, true, input->header.no_data, values, num_columns, &parsed, &band->stats );
+		ok = pos != NULL && parsed == num_columns;
+		if( ok )
+			copy_owned( jobs->mosaic, input, r, values, jobs->col, jobs->col + jobs->width,
+					height_grid_row( jobs->grid, r - jobs->row ) );
+		else
+			fprintf( stderr, "'%s': error parsing row %u\n", input->path, r - input->row );
+	}
+	free( values );
+	return ok;
+}
+
+bool mosaic_read_window( const mosaic_t *const mosaic, const uint32_t col, const uint32_t row,
+		const uint32_t width, const uint32_t height, height_grid_t *grid, const unsigned num_threads,
+		asc_parse_stats_t *stats ) {
+	for( uint32_t r = 0; r < height; ++r )
+		memset( height_grid_row( grid, r ), 0, width * sizeof(uint16_t) );
+	uint32_t num_bands = 0;
+	window_band_t *bands = NULL;
+	for( uint32_t i = 0; i < mosaic->num_inputs; ++i ) {
+		const mosaic_input_t *const input = &mosaic->inputs[i];
+		const uint32_t begin = row > input->row ? row : input->row;
+		const uint32_t end = row + height < input->row + input->header.num_rows ? row + height :
+				input->row + input->header.num_rows;
+		if( begin >= end || input->col >= col + width || col >= input->col + input->header.num_columns )
+			continue;
+		const uint32_t n = ( end - begin + WINDOW_BAND_ROWS - 1 ) / WINDOW_BAND_ROWS;
+		window_band_t *more = realloc( bands, ( num_bands + n ) * sizeof(window_band_t) );
+		if( !more ) {
+			free( bands );
+			fputs( "Error allocating window jobs\n", stderr );
+			return false;
+		}
+		bands = more;
+		for( uint32_t b = begin; b < end; b += WINDOW_BAND_ROWS ) {
+			window_band_t *const band = &bands[num_bands++];
+			band->input = i;
+			band->begin = b;
+			band->end = b + WINDOW_BAND_ROWS < end ? b + WINDOW_BAND_ROWS : end;
+			asc_parse_stats_init( &band->stats );
+		}
+	}
+	window_jobs_t jobs = { mosaic, col, row, width, grid, bands };
+	const bool ok = num_bands == 0 || tile_pool_run( num_threads, num_bands, read_band_job, &jobs );
+	for( uint32_t i = 0; ok && i < num_bands; ++i )
+		asc_parse_stats_merge( stats, &bands[i].stats );
+	free( bands );
+	return ok;
+}
+
+void mosaic_close( mosaic_t *mosaic ) {
+	for( uint32_t i = 0; i < mosaic->num_inputs; ++i ) {
+		mosaic_input_t *const input = &mosaic->inputs[i];
+		if( input->file.fd >= 0 )
+			input_file_close( &input->file );
+		free( input->path );
+		free( input->overlaps );
+		free( input->row_buffer );
+		row_index_free( &input->index );
+	}
+	free( mosaic->inputs );
+	memset( mosaic, 0, sizeof(*mosaic) );
+}
@@ -0,0 +1,76 @@
+/* Several ascii grids put together into one raster. Each input is placed by its lower left
+ * corner and its size; all must have the same cellsize and lie on the same grid of posts.
+ * Where inputs share posts, e.g. edge rows and columns, the first of them in the list wins.
+ * Posts no input covers are 0, like no data. The inputs are read as rows are requested, so
+ * the raster need not be in memory as a whole. With the rows of the inputs indexed, any
+ * window of the raster can be read at any time. */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "asc_parser.h"
+#include "height_grid.h"
+#include "input_file.h"
+#include "row_index.h"
+#include "srtm_header.h"
+
+typedef struct mosaic_input_t {
+	char *path;
+	srtm_header_t header;
+	// placement of its first post in the mosaic; rows from north to south
+	uint32_t col;
+	uint32_t row;
+	input_file_t file;
+	// parse position and rows of the input read so far
+	const char *pos;
+	uint32_t next_row;
+	// inputs before this one in the list that share posts with it
+	uint32_t num_overlaps;
+	uint32_t *overlaps;
+	// one row of the input, parsed
+	uint16_t *row_buffer;
+	asc_parse_stats_t stats;
+	// for mosaic_read_window, empty until mosaic_index_rows
+	row_index_t index;
+} mosaic_input_t;
+
+typedef struct mosaic_t {
+	uint32_t num_inputs;
+	mosaic_input_t *inputs;
+	// of the whole raster; no data is that of the first input
+	srtm_header_t header;
+	// size of all inputs
+	uint64_t bytes;
+} mosaic_t;
+
+/* Opens the ascii files listed in list_path, one per line, reads their headers and places
+ * them. Relative paths in the list are relative to its directory, see mosaic_input_path.
+ * Fails if they don't fit on one grid or the raster is smaller than tilesize. */
+extern bool mosaic_open( const char *const list_path, const uint32_t tilesize, mosaic_t *mosaic );
+
+/* The path of the input named in the list at list_path: name itself if it is absolute or the
+ * list is in the working directory, else name below the list's directory. NULL if out of memory. */
+extern char *mosaic_input_path( const char *const list_path, const char *const name );
+
+// A raster of the single ascii file at path
+extern bool mosaic_open_file( const char *const path, const uint32_t tilesize, mosaic_t *mosaic );
+
+/* Indexes the rows of all inputs for mosaic_read_window. Must come before any rows are read,
+ * and the inputs must be regular files. */
+extern bool mosaic_index_rows( mosaic_t *mosaic );
+
+/* Reads count rows of the raster from row first on into the rows of grid from grid_row on.
+ * The inputs that cover the rows are parsed in parallel by num_threads threads.
+ * Rows must be requested in order and each only once. */
+extern bool mosaic_read_rows( mosaic_t *mosaic, const uint32_t first, const uint32_t count,
+		height_grid_t *grid, const uint32_t grid_row, const unsigned num_threads, asc_parse_stats_t *stats );
+
+/* Reads the window of width x height posts from column col, row row on into the top left of
+ * grid. Only the rows of the window are parsed, in bands by num_threads threads. Needs the
+ * row index and may be called any number of times, but not concurrently. */
+extern bool mosaic_read_window( const mosaic_t *const mosaic, const uint32_t col, const uint32_t row,
+		const uint32_t width, const uint32_t height, height_grid_t *grid, const unsigned num_threads,
+		asc_parse_stats_t *stats );
+
+extern void mosaic_close( mosaic_t *mosaic );
@@ -0,0 +1,143 @@
+#include "normal_map.h"
+#include "le_bytes.h"
+#include <string.h>
+#include <math.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// Row pitch in posts of two uint16
+#define ROW_ALIGNMENT 64
+
+// Shortest distance between posts, in metres, for rows next to the poles
+#define MIN_SPACING 1e-3
+
+// Sobel of the post at p, north and south point at the posts above and below it
+static inline void normal_scalar( const uint16_t *const north, const uint16_t *const p, const uint16_t *const south,
+		const float scale_x, const float scale_y, uint16_t *out ) {
+	const float gx = ( (float)north[1] + 2.0f * (float)p[1] + (float)south[1] ) -
+			( (float)north[-1] + 2.0f * (float)p[-1] + (float)south[-1] );
+	const float gy = ( (float)north[-1] + 2.0f * (float)north[0] + (float)north[1] ) -
+			( (float)south[-1] + 2.0f * (float)south[0] + (float)south[1] );
+	// Slopes up to the east and north tilt the normal west and south
+	const float x = -gx * scale_x;
+	const float y = -gy * scale_y;
+	// Octahedral projection of ( x, y, 1 ), which needs no normalization
+	const float d = 1.0f / ( fabsf( x ) + fabsf( y ) + 1.0f );
+	out[0] = (uint16_t)lrintf( x * d * 32767.5f + 32767.5f );
+	out[1] = (uint16_t)lrintf( y * d * 32767.5f + 32767.5f );
+}
+
+#if defined(__AVX2__)
+static inline __m256 load_8( const uint16_t *const p ) {
+	return _mm256_cvtepi32_ps( _mm256_cvtepu16_epi32( _mm_loadu_si128( (const __m128i *)p ) ) );
+}
+
+void normal_map_row( const uint16_t *const north, const uint16_t *const row, const uint16_t *const south,
+		const uint32_t width, const float scale_x, const float scale_y, uint16_t *out ) {
+	const __m256 two = _mm256_set1_ps( 2.0f );
+	const __m256 one = _mm256_set1_ps( 1.0f );
+	const __m256 half_range = _mm256_set1_ps( 32767.5f );
+	const __m256 sign = _mm256_set1_ps( -0.0f );
+	const __m256 neg_scale_x = _mm256_set1_ps( -scale_x );
+	const __m256 neg_scale_y = _mm256_set1_ps( -scale_y );
+	uint32_t c = 0;
+	for( ; c + 8 <= width; c += 8 ) {
+		const __m256 nw = load_8( north + c - 1 );
+		const __m256 n = load_8( north + c );
+		const __m256 ne = load_8( north + c + 1 );
+		const __m256 w = load_8( row + c - 1 );
+		const __m256 e = load_8( row + c + 1 );
+		const __m256 sw = load_8( south + c - 1 );
+		const __m256 s = load_8( south + c );
+		const __m256 se = load_8( south + c + 1 );
+		const __m256 gx = _mm256_sub_ps( _mm256_add_ps( _mm256_add_ps( ne, _mm256_mul_ps( two, e ) ), se ),
+				_mm256_add_ps( _mm256_add_ps( nw, _mm256_mul_ps( two, w ) ), sw ) );
+		const __m256 gy = _mm256_sub_ps( _mm256_add_ps( _mm256_add_ps( nw, _mm256_mul_ps( two, n ) ), ne ),
+				_mm256_add_ps( _mm256_add_ps( sw, _mm256_mul_ps( two, s ) ), se ) );
+		const __m256 x = _mm256_mul_ps( gx, neg_scale_x );
+		const __m256 y = _mm256_mul_ps( gy, neg_scale_y );
+		const __m256 d = _mm256_div_ps( one, _mm256_add_ps( _mm256_add_ps( _mm256_andnot_ps( sign, x ),
+				_mm256_andnot_ps( sign, y ) ), one ) );
+		const __m256i ix = _mm256_cvtps_epi32( _mm256_add_ps( _mm256_mul_ps( _mm256_mul_ps( x, d ), half_range ),
+				half_range ) );
+		const __m256i iy = _mm256_cvtps_epi32( _mm256_add_ps( _mm256_mul_ps( _mm256_mul_ps( y, d ), half_range ),
+				half_range ) );
+		// x in the low, y in the high half of each post
+		_mm256_storeu_si256( (__m256i *)( out + 2 * (size_t)c ), _mm256_or_si256( ix, _mm256_slli_epi32( iy, 16 ) ) );
+	}
+	for( ; c < width; ++c )
+		normal_scalar( north + c, row + c, south + c, scale_x, scale_y, out + 2 * (size_t)c );
+}
+#else
+void normal_map_row( const uint16_t *const north, const uint16_t *const row, const uint16_t *const south,
+		const uint32_t width, const float scale_x, const float scale_y, uint16_t *out ) {
+	for( uint32_t c = 0; c < width; ++c )
+		normal_scalar( north + c, row + c, south + c, scale_x, scale_y, out + 2 * (size_t)c );
+}
+#endif
+
+bool normal_map_encode( const height_grid_t *const heights, const ellipsoid_t *const e,
+		normal_map_header_t *header, byte_buffer_t *out ) {
+	byte_buffer_clear( out );
+	if( heights->width < 3 || heights->height < 3 )
+		return false;
+	header->version = NORMAL_MAP_VERSION;
+	header->header_size = NORMAL_MAP_HEADER_SIZE;
+	header->width = heights->width - 2;
+	header->height = heights->height - 2;
+	header->stride = ( header->width + ROW_ALIGNMENT - 1 ) / ROW_ALIGNMENT * ROW_ALIGNMENT;
+	unsigned char h[NORMAL_MAP_HEADER_SIZE] = { 0 };
+	memcpy( h, NORMAL_MAP_MAGIC, 8 );
+	store_u32( h + 8, header->version );
+	store_u32( h + 12, header->header_size );
+	store_u32( h + 16, header->width );
+	store_u32( h + 20, header->height );
+	store_u32( h + 24, header->stride );
+	store_u32( h + 28, header->halo );
+	store_u32( h + 32, header->start_col );
+	store_u32( h + 36, header->start_row );
+	store_f64( h + 40, header->longitude );
+	store_f64( h + 48, header->latitude );
+	store_f64( h + 56, header->cellsize );
+	if( !byte_buffer_reserve( out, NORMAL_MAP_HEADER_SIZE +
+			(size_t)header->stride * header->height * 2 * sizeof(uint16_t) ) ||
+			!byte_buffer_append( out, h, sizeof(h) ) )
+		return false;
+	// Radii of curvature along the meridian and the prime vertical give the spacing at each latitude
+	const double a = e->radii.x;
+	const double e2 = 1.0 - ( e->radii.z * e->radii.z ) / ( a * a );
+	const double step = radiansd( header->cellsize );
+	uint16_t row[2 * header->stride];
+	memset( row, 0, sizeof(row) );
+	for( uint32_t r = 0; r < header->height; ++r ) {
+		// Rows run from north to south
+		const double lat = radiansd( header->latitude + ( header->height - 1.0 - r ) * header->cellsize );
+		const double sin_lat = sin( lat );
+		const double w = 1.0 - e2 * sin_lat * sin_lat;
+		const double prime_vertical = a / sqrt( w );
+		const double meridian = a * ( 1.0 - e2 ) / ( w * sqrt( w ) );
+		const double dx = fmax( prime_vertical * cos( lat ) * step, MIN_SPACING );
+		const double dy = fmax( meridian * step, MIN_SPACING );
+		normal_map_row( height_grid_row( heights, r ) + 1, height_grid_row( heights, r + 1 ) + 1,
+				height_grid_row( heights, r + 2 ) + 1, header->width, (float)( 0.125 / dx ), (float)( 0.125 / dy ), row );
+#if !defined(__BYTE_ORDER__) || __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+		for( uint32_t i = 0; i < 2 * header->width; ++i )
+			store_u16( (unsigned char *)&row[i], row[i] );
+#endif
+		if( !byte_buffer_append( out, row, sizeof(row) ) )
+			return false;
+	}
+	return true;
+}
+
+void normal_map_decode( const uint16_t encoded[2], float normal[3] ) {
+	const float x = (float)encoded[0] / 65535.0f * 2.0f - 1.0f;
+	const float y = (float)encoded[1] / 65535.0f * 2.0f - 1.0f;
+	// Only rounding takes it below the horizon
+	const float z = fmaxf( 1.0f - fabsf( x ) - fabsf( y ), 0.0f );
+	const float length = sqrtf( x * x + y * y + z * z );
+	normal[0] = x / length;
+	normal[1] = y / length;
+	normal[2] = z / length;
+}
@@ -0,0 +1,58 @@
+/* Normal maps of tiles, baked once instead of filtering the heights in the terrain shaders every
+ * frame. Normals come from a 3x3 Sobel kernel over the posts, with the distances between posts in
+ * metres east and north on the ellipsoid at each row's latitude. They are unit vectors in east,
+ * north and up of their post, octahedral encoded into two unorm16 channels, e.g. for an RG16 texture.
+ * The map covers the tile and a halo of posts around it, all computed from the posts of the
+ * neighbouring tiles, so normals on both sides of a seam are the same.
+ * File format: a 64 byte header followed by the normals, row by row from north to south, rows
+ * padded to 256 bytes like those of raw tiles. All header fields are little endian:
+ *  0 magic "SRTMNORM"
+ *  8 uint32 version
+ * 12 uint32 header size, offset of the first normal
+ * 16 uint32 width, 20 uint32 height in posts, with the halo
+ * 24 uint32 stride, posts from one row to the next
+ * 28 uint32 halo, posts on each side beyond the tile
+ * 32 uint32 first column, 36 uint32 first row of the tile in the source raster
+ * 40 double longitude, 48 double latitude of the lower left post, in the halo
+ * 56 double cellsize in degrees
+ * Each post is uint16 x, y; with p = v / 65535 * 2 - 1 the normal is ( p.x, p.y, 1 - |p.x| - |p.y| )
+ * normalized. Up is never negative, so there is no lower half to unfold. */
+
+#pragma once
+
+#include "height_grid.h"
+#include "byte_buffer.h"
+#include "../omath/ellipsoid.h"
+
+#define NORMAL_MAP_MAGIC "SRTMNORM"
+#define NORMAL_MAP_VERSION 1
+#define NORMAL_MAP_HEADER_SIZE 64
+
+typedef struct normal_map_header_t {
+	uint32_t version;
+	uint32_t header_size;
+	uint32_t width;
+	uint32_t height;
+	uint32_t stride;
+	uint32_t halo;
+	uint32_t start_col;
+	uint32_t start_row;
+	double longitude;
+	double latitude;
+	double cellsize;
+} normal_map_header_t;
+
+/* Encodes the normals of the posts of heights but its outermost rows and columns, which only feed
+ * the kernel, with the header into out, which is cleared first. Longitude, latitude and cellsize
+ * of the header place the normals on e, its size and stride fields are set here. */
+extern bool normal_map_encode( const height_grid_t *const heights, const ellipsoid_t *const e,
+		normal_map_header_t *header, byte_buffer_t *out );
+
+/* Encoded normals of width posts of row into out, two uint16 per post. north and south are the rows
+ * next to it; the kernel reads one post before and one after each of the three. scale_x and scale_y
+ * are 1 / ( 8 * spacing ) of the posts in metres east and north. AVX2 8 posts at a time, or plain C. */
+extern void normal_map_row( const uint16_t *const north, const uint16_t *const row, const uint16_t *const south,
+		const uint32_t width, const float scale_x, const float scale_y, uint16_t *out );
+
+// Unit normal in east, north, up of an encoded one
+extern void normal_map_decode( const uint16_t encoded[2], float normal[3] );
@@ -0,0 +1,214 @@
+#include "row_index.h"
+#include "asc_parser.h"
+#include "le_bytes.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+// Values parsed at a time when rows are skipped by parsing
+#define SKIP_CHUNK 512
+
+static inline bool is_space( const char c ) {
+	return c == ' ' || ( c >= '\t' && c <= '\r' );
+}
+
+static inline uint32_t num_offsets( const row_index_t *const index ) {
+	return ( index->num_rows + index->step - 1 ) / index->step;
+}
+
+/* One line per row: a row starts behind each line end. Wrapped rows or blank lines leave
+ * values behind the last row, which sends the body to index_values. */
+static bool index_lines( const char *const data, const char *const body, const char *const end,
+		row_index_t *index ) {
+	uint32_t n = 0;
+	const char *p = body;
+	while( n < index->num_rows && p < end ) {
+		if( n % index->step == 0 )
+			index->offsets[n / index->step] = (uint64_t)( p - data );
+		++n;
+		const char *eol = memchr( p, '\n', (size_t)( end - p ) );
+		p = eol ? eol + 1 : end;
+	}
+	while( p < end && is_space( *p ) )
+		++p;
+	return n == index->num_rows && p == end;
+}
+
+// Parses one row from *pos on and moves *pos behind it
+static bool skip_row( const row_index_t *const index, const char *const end, const char **pos ) {
+	uint16_t values[SKIP_CHUNK];
+	asc_parse_stats_t stats;
+	asc_parse_stats_init( &stats );
+	for( uint32_t n = 0; n < index->num_columns; ) {
+		const size_t count = index->num_columns - n < SKIP_CHUNK ? index->num_columns - n : SKIP_CHUNK;
+		size_t parsed;
+		*pos = asc_parse_values( *pos, end, true, index->no_data, values, count, &parsed, &stats );
+		if( !*pos || parsed != count )
+			return false;
+		n += (uint32_t)count;
+	}
+	return true;
+}
+
+// Any layout: parses the rows one after the other and notes where each starts
+static bool index_values( const char *const data, const char *const body, const char *const end,
+		row_index_t *index ) {
+	index->lines = false;
+	const char *p = body;
+	for( uint32_t r = 0; r < index->num_rows; ++r ) {
+		while( p < end && is_space( *p ) )
+			++p;
+		if( r % index->step == 0 )
+			index->offsets[r / index->step] = (uint64_t)( p - data );
+		if( !skip_row( index, end, &p ) )
+			return false;
+	}
+	return true;
+}
+
+static bool index_init( const srtm_header_t *const header, row_index_t *index ) {
+	index->num_rows = header->num_rows;
+	index->num_columns = header->num_columns;
+	index->no_data = header->no_data;
+	index->step = ROW_INDEX_STEP;
+	index->lines = true;
+	index->offsets = malloc( num_offsets( index ) * sizeof(uint64_t) );
+	return index->offsets != NULL;
+}
+
+bool row_index_build( const char *const data, const char *const body, const char *const end,
+		const srtm_header_t *const header, row_index_t *index ) {
+	if( index_init( header, index ) && ( index_lines( data, body, end, index ) ||
+			index_values( data, body, end, index ) ) )
+		return true;
+	row_index_free( index );
+	return false;
+}
+
+static char *sidecar_path( const char *const path ) {
+	const size_t length = strlen( path );
+	char *sidecar = malloc( length + sizeof(".rowidx") );
+	if( sidecar ) {
+		memcpy( sidecar, path, length );
+		memcpy( sidecar + length, ".rowidx", sizeof(".rowidx") );
+	}
+	return sidecar;
+}
+
+// The fields of the sidecar header that depend on the input
+static bool store_header( const char *const path, const srtm_header_t *const header,
+		const row_index_t *const index, unsigned char h[ROW_INDEX_HEADER_SIZE] ) {
+	struct stat st;
+	if( stat( path, &st ) != 0 )
+		return false;
+	memset( h, 0, ROW_INDEX_HEADER_SIZE );
+	memcpy( h, ROW_INDEX_MAGIC, 8 );
+	store_u32( h + 8, ROW_INDEX_VERSION );
+	store_u32( h + 12, index->lines ? 1 : 0 );
+	store_u64( h + 16, (uint64_t)st.st_size );
+	store_u64( h + 24, (uint64_t)st.st_mtim.tv_sec );
+	store_u32( h + 32, (uint32_t)st.st_mtim.tv_nsec );
+	store_u32( h + 36, index->step );
+	store_u32( h + 40, header->num_columns );
+	store_u32( h + 44, header->num_rows );
+	store_f64( h + 48, header->longitude );
+	store_f64( h + 56, header->latitude );
+	store_f64( h + 64, header->cellsize );
+	store_u32( h + 72, (uint32_t)header->no_data );
+	store_u32( h + 76, num_offsets( index ) );
+	return true;
+}
+
+bool row_index_load( const char *const path, const srtm_header_t *const header, row_index_t *index ) {
+	memset( index, 0, sizeof(*index) );
+	char *const sidecar = sidecar_path( path );
+	FILE *file = sidecar ? fopen( sidecar, "rb" ) : NULL;
+	free( sidecar );
+	if( !file )
+		return false;
+	unsigned char h[ROW_INDEX_HEADER_SIZE];
+	unsigned char expected[ROW_INDEX_HEADER_SIZE];
+	bool ok = fread( h, sizeof(h), 1, file ) == 1 && index_init( header, index );
+	if( ok ) {
+		// All that is known up front must be equal, then step and layout are taken from the file
+		index->step = load_u32( h + 36 );
+		index->lines = load_u32( h + 12 ) == 1;
+		ok = index->step > 0 && store_header( path, header, index, expected ) &&
+				memcmp( h, expected, sizeof(h) ) == 0;
+	}
+	if( ok && index->step != ROW_INDEX_STEP ) {
+		free( index->offsets );
+		ok = ( index->offsets = malloc( num_offsets( index ) * sizeof(uint64_t) ) ) != NULL;
+	}
+	const uint32_t n = ok ? num_offsets( index ) : 0;
+	unsigned char *raw = ok ? malloc( (size_t)n * 8 ) : NULL;
+	ok = raw && fread( raw, 8, n, file ) == n;
+	// Offsets in the input, a broken sidecar must not send the parser beyond it
+	for( uint32_t i = 0; ok && i < n; ++i )
+		ok = ( index->offsets[i] = load_u64( raw + (size_t)i * 8 ) ) < load_u64( h + 16 );
+	free( raw );
+	fclose( file );
+	if( !ok )
+		row_index_free( index );
+	return ok;
+}
+
+bool row_index_save( const char *const path, const srtm_header_t *const header,
+		const row_index_t *const index ) {
+	char *const sidecar = sidecar_path( path );
+	unsigned char h[ROW_INDEX_HEADER_SIZE];
+	if( !sidecar || !store_header( path, header, index, h ) ) {
+		free( sidecar );
+		return false;
+	}
+	const uint32_t n = num_offsets( index );
+	unsigned char *raw = malloc( (size_t)n * 8 );
+	for( uint32_t i = 0; raw && i < n; ++i )
+		store_u64( raw + (size_t)i * 8, index->offsets[i] );
+	FILE *file = raw ? fopen( sidecar, "wb" ) : NULL;
+	bool ok = file && fwrite( h, sizeof(h), 1, file ) == 1 && fwrite( raw, 8, n, file ) == n;
+	if( file && fclose( file ) != 0 )
+		ok = false;
+	// Half a sidecar would be taken for a broken input
+	if( file && !ok )
+		remove( sidecar );
+	free( raw );
+	free( sidecar );
+	return ok;
+}
+
+bool row_index_open( const char *const path, const char *const data, const char *const body,
+		const char *const end, const srtm_header_t *const header, row_index_t *index ) {
+	if( row_index_load( path, header, index ) ) {
+		printf( "Row index of '%s' loaded from its sidecar\n", path );
+		return true;
+	}
+	if( !row_index_build( data, body, end, header, index ) )
+		return false;
+	if( row_index_save( path, header, index ) )
+		printf( "Row index of '%s' saved to its sidecar, one offset per %u rows\n", path, index->step );
+	else
+		fprintf( stderr, "Warning, could not save the row index of '%s'\n", path );
+	return true;
+}
+
+const char *row_index_row( const row_index_t *const index, const char *const data,
+		const char *const end, const uint32_t row ) {
+	const char *pos = data + index->offsets[row / index->step];
+	for( uint32_t i = row % index->step; i > 0; --i ) {
+		if( index->lines ) {
+			const char *eol = memchr( pos, '\n', (size_t)( end - pos ) );
+			if( !eol )
+				return NULL;
+			pos = eol + 1;
+		} else if( !skip_row( index, end, &pos ) )
+			return NULL;
+	}
+	return pos;
+}
+
+void row_index_free( row_index_t *index ) {
+	free( index->offsets );
+	memset( index, 0, sizeof(*index) );
+}
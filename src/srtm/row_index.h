@@ -0,0 +1,59 @@
+/* Byte offsets of the rows in the body of an ascii grid, so a row can be parsed without
+ * reading the file from the start. Needs the file mapped as a whole.
+ * Every ROW_INDEX_STEP-th row is kept; rows between are found by skipping line ends, or by
+ * parsing when rows are wrapped over several lines. The index is saved next to the input in
+ * a sidecar <input>.rowidx and reused while the input's size and mtime are unchanged.
+ * Layout of the sidecar, all values little endian:
+ *    0 magic "SRTMROWX", 8 uint32 version, 12 uint32 flags (1: one line per row),
+ *   16 uint64 size, 24 int64 mtime seconds, 32 uint32 mtime nanoseconds of the input,
+ *   36 uint32 row step, 40 uint32 columns, 44 uint32 rows, 48 double longitude,
+ *   56 double latitude, 64 double cellsize, 72 int32 no data of its header,
+ *   76 uint32 number of offsets, 80 uint64 offsets from the start of the input */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "srtm_header.h"
+
+#define ROW_INDEX_MAGIC "SRTMROWX"
+#define ROW_INDEX_VERSION 1
+#define ROW_INDEX_HEADER_SIZE 80
+#define ROW_INDEX_STEP 16
+
+typedef struct row_index_t {
+	uint32_t num_rows;
+	uint32_t num_columns;
+	int no_data;
+	// rows apart of two offsets
+	uint32_t step;
+	// one line per row, rows between offsets are skipped by their line ends
+	bool lines;
+	// of every step-th row's first value from the start of the file
+	uint64_t *offsets;
+} row_index_t;
+
+/* Indexes the rows described by header in the body [body, end) of the file that starts at
+ * data. A body with one line per row is indexed by a scan for line ends, anything else by
+ * parsing it. */
+extern bool row_index_build( const char *const data, const char *const body, const char *const end,
+		const srtm_header_t *const header, row_index_t *index );
+
+/* Loads the sidecar of the input at path. Fails if there is none or it does not match the
+ * input's size, mtime or header. */
+extern bool row_index_load( const char *const path, const srtm_header_t *const header, row_index_t *index );
+
+// Writes the sidecar of the input at path
+extern bool row_index_save( const char *const path, const srtm_header_t *const header,
+		const row_index_t *const index );
+
+/* Loads the sidecar of the input at path, or builds the index and saves it. Not being able to
+ * save is only a warning. */
+extern bool row_index_open( const char *const path, const char *const data, const char *const body,
+		const char *const end, const srtm_header_t *const header, row_index_t *index );
+
+// Position of the first value of row in the file [data, end), NULL if the rows before it are broken
+extern const char *row_index_row( const row_index_t *const index, const char *const data,
+		const char *const end, const uint32_t row );
+
+extern void row_index_free( row_index_t *index );
@@ -0,0 +1,163 @@
+#include "run_stats.h"
+#include "timer.h"
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+
+static const char *const stage_names[RUN_STAGE_COUNT] = {
+		"header", "parse", "extract", "encode", "write", "lod", "bounds", "mesh", "normals"
+};
+
+void run_stats_init( run_stats_t *stats ) {
+	memset( stats, 0, sizeof(*stats) );
+}
+
+const char *run_stage_name( const run_stage_t stage ) {
+	return stage < RUN_STAGE_COUNT ? stage_names[stage] : "unknown";
+}
+
+void stage_timer_start( stage_timer_t *timer, const bool thread ) {
+	timer->cpu_clock = thread ? CLOCK_THREAD_CPUTIME_ID : CLOCK_PROCESS_CPUTIME_ID;
+	clock_gettime( CLOCK_MONOTONIC, &timer->wall );
+	clock_gettime( timer->cpu_clock, &timer->cpu );
+}
+
+static inline unsigned bucket( uint64_t value ) {
+	unsigned i = 0;
+	while( value > 1 && i < RUN_STATS_BUCKETS - 1 ) {
+		value >>= 1;
+		++i;
+	}
+	return i;
+}
+
+double run_stats_add( run_stats_t *stats, const run_stage_t stage, const stage_timer_t *const timer,
+		const uint64_t bytes_in, const uint64_t bytes_out, const uint64_t values ) {
+	struct timespec cpu;
+	clock_gettime( timer->cpu_clock, &cpu );
+	const double wall = seconds_since( &timer->wall );
+	stage_stats_t *const s = &stats->stage[stage];
+	if( s->count == 0 || wall < s->min_seconds )
+		s->min_seconds = wall;
+	if( s->count == 0 || wall > s->max_seconds )
+		s->max_seconds = wall;
+	++s->count;
+	s->wall_seconds += wall;
+	s->cpu_seconds += (double)( cpu.tv_sec - timer->cpu.tv_sec ) + (double)( cpu.tv_nsec - timer->cpu.tv_nsec ) * 1e-9;
+	s->bytes_in += bytes_in;
+	s->bytes_out += bytes_out;
+	s->values += values;
+	++s->time_histogram[bucket( (uint64_t)( wall * 1e6 ) )];
+	++s->size_histogram[bucket( bytes_out )];
+	return wall;
+}
+
+void run_stats_merge( run_stats_t *stats, const run_stats_t *const other ) {
+	for( unsigned i = 0; i < RUN_STAGE_COUNT; ++i ) {
+		stage_stats_t *const s = &stats->stage[i];
+		const stage_stats_t *const o = &other->stage[i];
+		if( o->count == 0 )
+			continue;
+		if( s->count == 0 || o->min_seconds < s->min_seconds )
+			s->min_seconds = o->min_seconds;
+		if( s->count == 0 || o->max_seconds > s->max_seconds )
+			s->max_seconds = o->max_seconds;
+		s->count += o->count;
+		s->wall_seconds += o->wall_seconds;
+		s->cpu_seconds += o->cpu_seconds;
+		s->bytes_in += o->bytes_in;
+		s->bytes_out += o->bytes_out;
+		s->values += o->values;
+		for( unsigned b = 0; b < RUN_STATS_BUCKETS; ++b ) {
+			s->time_histogram[b] += o->time_histogram[b];
+			s->size_histogram[b] += o->size_histogram[b];
+		}
+	}
+}
+
+static void write_string( FILE *file, const char *text ) {
+	fputc( '"', file );
+	for( ; *text; ++text ) {
+		const unsigned char c = (unsigned char)*text;
+		if( c == '"' || c == '\\' )
+			fprintf( file, "\\%c", c );
+		else if( c < 0x20 )
+			fprintf( file, "\\u%04x", c );
+		else
+			fputc( c, file );
+	}
+	fputc( '"', file );
+}
+
+static inline double per_second( const double amount, const double seconds ) {
+	return seconds > 0.0 ? amount / seconds : 0.0;
+}
+
+// Non empty buckets as [from, count] pairs, from is 0 for the first bucket
+static void write_histogram( FILE *file, const char *const name, const uint64_t histogram[RUN_STATS_BUCKETS] ) {
+	fprintf( file, ",\n\t\t\t\"%s\": [", name );
+	bool first = true;
+	for( unsigned b = 0; b < RUN_STATS_BUCKETS; ++b ) {
+		if( histogram[b] == 0 )
+			continue;
+		fprintf( file, "%s[%llu, %llu]", first ? "" : ", ", b == 0 ? 0ull : 1ull << b,
+				(unsigned long long)histogram[b] );
+		first = false;
+	}
+	fputc( ']', file );
+}
+
+bool run_stats_write_json( const run_stats_t *const stats, const char *const path,
+		const struct timespec *const start, const char *const input, const uint32_t tilesize,
+		const unsigned num_threads, const char *const format, const char *const png_profile ) {
+	FILE *file = fopen( path, "w" );
+	if( !file ) {
+		fprintf( stderr, "Error opening stats file '%s'\n", path );
+		return false;
+	}
+	struct rusage usage;
+	memset( &usage, 0, sizeof(usage) );
+	getrusage( RUSAGE_SELF, &usage );
+	fputs( "{\n\t\"input\": ", file );
+	write_string( file, input );
+	fprintf( file, ",\n\t\"tilesize\": %u,\n\t\"threads\": %u,\n\t\"format\": ", tilesize, num_threads );
+	write_string( file, format );
+	if( png_profile ) {
+		fputs( ",\n\t\"png_profile\": ", file );
+		write_string( file, png_profile );
+	}
+	fprintf( file, ",\n\t\"wall_seconds\": %.6f,\n\t\"cpu_user_seconds\": %.6f,\n\t\"cpu_system_seconds\": %.6f,\n"
+			"\t\"peak_rss_bytes\": %llu,\n\t\"stages\": {",
+			seconds_since( start ),
+			(double)usage.ru_utime.tv_sec + (double)usage.ru_utime.tv_usec * 1e-6,
+			(double)usage.ru_stime.tv_sec + (double)usage.ru_stime.tv_usec * 1e-6,
+			// kilobytes on Linux
+			(unsigned long long)usage.ru_maxrss * 1024ull );
+	bool first = true;
+	for( unsigned i = 0; i < RUN_STAGE_COUNT; ++i ) {
+		const stage_stats_t *const s = &stats->stage[i];
+		if( s->count == 0 )
+			continue;
+		fprintf( file, "%s\n\t\t\"%s\": {\n", first ? "" : ",", stage_names[i] );
+		fprintf( file, "\t\t\t\"count\": %llu,\n\t\t\t\"wall_seconds\": %.6f,\n\t\t\t\"cpu_seconds\": %.6f,\n"
+				"\t\t\t\"min_seconds\": %.6f,\n\t\t\t\"mean_seconds\": %.6f,\n\t\t\t\"max_seconds\": %.6f,\n"
+				"\t\t\t\"bytes_in\": %llu,\n\t\t\t\"bytes_out\": %llu,\n\t\t\t\"values\": %llu,\n"
+				"\t\t\t\"values_per_second\": %.1f,\n\t\t\t\"mb_in_per_second\": %.3f,\n\t\t\t\"mb_out_per_second\": %.3f",
+				(unsigned long long)s->count, s->wall_seconds, s->cpu_seconds,
+				s->min_seconds, s->wall_seconds / (double)s->count, s->max_seconds,
+				(unsigned long long)s->bytes_in, (unsigned long long)s->bytes_out, (unsigned long long)s->values,
+				per_second( (double)s->values, s->wall_seconds ),
+				per_second( (double)s->bytes_in * 1e-6, s->wall_seconds ),
+				per_second( (double)s->bytes_out * 1e-6, s->wall_seconds ) );
+		write_histogram( file, "microseconds_histogram", s->time_histogram );
+		write_histogram( file, "bytes_out_histogram", s->size_histogram );
+		fputs( "\n\t\t}", file );
+		first = false;
+	}
+	fputs( "\n\t}\n}\n", file );
+	if( fclose( file ) != 0 ) {
+		fprintf( stderr, "Error writing stats file '%s'\n", path );
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,72 @@
+/* Time and throughput of the stages of a run, for finding where the time goes and for
+ * tracking regressions. Each stage counts its items, e.g. tiles or strips of rows, with wall
+ * and cpu time, bytes in and out and parsed values, and keeps histograms of the wall time and
+ * output bytes per item. Workers keep their own stats, which are merged at the end; the wall
+ * and cpu time of a stage run by workers are sums over their items and threads, the cpu time
+ * of other stages is that of the process.
+ * run_stats_write_json writes them with the run's totals and peak resident memory. */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+// Histogram buckets, bucket i counts values in [2^i, 2^(i+1)), bucket 0 also 0
+#define RUN_STATS_BUCKETS 40
+
+typedef enum run_stage_t {
+	RUN_STAGE_HEADER = 0,
+	RUN_STAGE_PARSE,
+	RUN_STAGE_EXTRACT,
+	RUN_STAGE_ENCODE,
+	RUN_STAGE_WRITE,
+	RUN_STAGE_LOD,
+	RUN_STAGE_BOUNDS,
+	RUN_STAGE_MESH,
+	RUN_STAGE_NORMALS,
+	RUN_STAGE_COUNT
+} run_stage_t;
+
+typedef struct stage_stats_t {
+	uint64_t count;
+	double wall_seconds;
+	double cpu_seconds;
+	double min_seconds;
+	double max_seconds;
+	uint64_t bytes_in;
+	uint64_t bytes_out;
+	uint64_t values;
+	// per item, wall time in microseconds and output bytes
+	uint64_t time_histogram[RUN_STATS_BUCKETS];
+	uint64_t size_histogram[RUN_STATS_BUCKETS];
+} stage_stats_t;
+
+typedef struct run_stats_t {
+	stage_stats_t stage[RUN_STAGE_COUNT];
+} run_stats_t;
+
+typedef struct stage_timer_t {
+	struct timespec wall;
+	struct timespec cpu;
+	clockid_t cpu_clock;
+} stage_timer_t;
+
+extern void run_stats_init( run_stats_t *stats );
+
+extern const char *run_stage_name( const run_stage_t stage );
+
+// Starts timing an item, with the cpu time of the calling thread if thread is set
+extern void stage_timer_start( stage_timer_t *timer, const bool thread );
+
+// Adds an item timed from timer on to stage, returns its wall time in seconds
+extern double run_stats_add( run_stats_t *stats, const run_stage_t stage, const stage_timer_t *const timer,
+		const uint64_t bytes_in, const uint64_t bytes_out, const uint64_t values );
+
+extern void run_stats_merge( run_stats_t *stats, const run_stats_t *const other );
+
+/* Writes stats as json to path with the run's parameters, its wall time since start and the
+ * cpu time and peak resident memory of the process. png_profile is NULL for other formats. */
+extern bool run_stats_write_json( const run_stats_t *const stats, const char *const path,
+		const struct timespec *const start, const char *const input, const uint32_t tilesize,
+		const unsigned num_threads, const char *const format, const char *const png_profile );
@@ -0,0 +1,103 @@
+#include "srtm_header.h"
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+// How far, in cells, an extent may reach into a post and still not cover it, for rounding
+#define POST_TOLERANCE 1e-6
+
+// The header is 6 short lines, the body starts well within this
+#define MAX_HEADER_SIZE 1024
+
+bool read_srtm_ascii_header( const char **cursor, const char *const end, srtm_header_t *header ) {
+	// Copy the header into a terminated string for sscanf, the body stays where it is
+	char text[MAX_HEADER_SIZE + 1];
+	const size_t size = (size_t)( end - *cursor ) < MAX_HEADER_SIZE ? (size_t)( end - *cursor ) : MAX_HEADER_SIZE;
+	memcpy( text, *cursor, size );
+	text[size] = '\0';
+	const char *s = text;
+	int n = 0;
+	// Read header data of an srtm v 4.1 file
+	if( 1 == sscanf( s, "ncols %u\n%n", &header->num_columns, &n ) )
+		printf( "Columns: %d\n", header->num_columns );
+	else {
+		fputs( "Error reading ascii header number of columns\n", stderr );
+		return false;
+	}
+	s += n;
+	if( 1 == sscanf( s, "nrows %u\n%n", &header->num_rows, &n ) )
+		printf( "Rows: %d\n", header->num_rows );
+	else {
+		fputs( "Error reading ascii header number of rows\n", stderr );
+		return false;
+	}
+	s += n;
+	if( header->num_columns <= 0 || header->num_rows <= 0 ||
+		header->num_columns < header->tilesize || header->num_rows < header->tilesize ) {
+		fputs( "Error, size of data could not be determined or tile size > size of data\n", stderr );
+		return false;
+	}
+	if( 1 == sscanf( s, "xllcorner %lf\n%n", &header->longitude, &n ) )
+		printf( "Lower left lon: %lf", header->longitude );
+	else {
+		fputs( "Error reading ascii header lower left x (longitude)\n", stderr );
+		return false;
+	}
+	s += n;
+	if( 1 == sscanf( s, "yllcorner %lf\n%n", &header->latitude, &n ) )
+		printf( "; lat: %lf\n", header->latitude );
+	else {
+		fputs( "Error reading ascii header lower left y (latitude)\n", stderr );
+		return false;
+	}
+	s += n;
+	if( header->longitude < -180.0 || header->latitude < -90.0 ||
+		header->longitude > 180.0 || header->latitude > 90.0 ) {
+		fputs( "Error in latitude or longitude; out of bounds\n", stderr );
+		return false;
+	}
+	if( 1 == sscanf( s, "cellsize %lf\n%n", &header->cellsize, &n ) )
+		printf( "Cellsize: %lf arcsec\n", header->cellsize );
+	else {
+		fputs( "Cellsize could not be determined\n", stderr );
+		return false;
+	}
+	s += n;
+	if( 1 == sscanf( s, "NODATA_value %d\n%n", &header->no_data, &n ) )
+		printf( "No data value: %d\n", header->no_data );
+	else {
+		fputs( "Error reading no data value\n", stderr );
+		return false;
+	}
+	s += n;
+	*cursor += s - text;
+	return true;
+}
+
+bool srtm_header_window( const srtm_header_t *const header, const geodetic_extent_t *const extent,
+		uint32_t *col, uint32_t *row, uint32_t *width, uint32_t *height ) {
+	// Posts sit on the corner and every cellsize from it, rows count from the north
+	const double north = header->latitude + ( header->num_rows - 1.0 ) * header->cellsize;
+	const double first_col = floor( ( extent->sw_lon - header->longitude ) / header->cellsize + POST_TOLERANCE );
+	const double last_col = ceil( ( extent->ne_lon - header->longitude ) / header->cellsize - POST_TOLERANCE );
+	const double first_row = floor( ( north - extent->ne_lat ) / header->cellsize + POST_TOLERANCE );
+	const double last_row = ceil( ( north - extent->sw_lat ) / header->cellsize - POST_TOLERANCE );
+	if( extent->ne_lon <= extent->sw_lon || extent->ne_lat <= extent->sw_lat ||
+		last_col < 0.0 || last_row < 0.0 || first_col > header->num_columns - 1.0 || first_row > header->num_rows - 1.0 )
+		return false;
+	*col = first_col > 0.0 ? (uint32_t)first_col : 0;
+	*row = first_row > 0.0 ? (uint32_t)first_row : 0;
+	*width = ( last_col < header->num_columns - 1.0 ? (uint32_t)last_col : header->num_columns - 1 ) - *col + 1;
+	*height = ( last_row < header->num_rows - 1.0 ? (uint32_t)last_row : header->num_rows - 1 ) - *row + 1;
+	return true;
+}
+
+void srtm_header_crop( const srtm_header_t *const header, const uint32_t col, const uint32_t row,
+		const uint32_t width, const uint32_t height, srtm_header_t *window ) {
+	*window = *header;
+	window->num_columns = width;
+	window->num_rows = height;
+	window->longitude = header->longitude + col * header->cellsize;
+	// The lower left is the window's last row
+	window->latitude = header->latitude + ( (double)header->num_rows - row - height ) * header->cellsize;
+}
@@ -0,0 +1,36 @@
+/* Header of an ascii srtm file (esri ascii grid) and its parser. */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "../omath/geodetic.h"
+
+// Header info of an ascii srtm-90 file, the only input format
+typedef struct srtm_header_t {
+	// humber of posts in width and height
+	uint32_t num_columns;
+	uint32_t num_rows;
+	// lower left corner
+	double longitude;
+	double latitude;
+	// distance between posts; angle in arcseconds decimel
+	double cellsize;
+	// a default when there's no data for a post
+	int no_data;
+	uint32_t tilesize;
+} srtm_header_t;
+
+/* Reads the header of an srtm v 4.1 file from the bytes at *cursor, which need not be
+ * terminated. Advances *cursor to the first byte of the body. */
+extern bool read_srtm_ascii_header( const char **cursor, const char *const end, srtm_header_t *header );
+
+/* The window of posts that covers extent, counted from the north west: columns col to
+ * col + width - 1 and rows row to row + height - 1, clipped to the raster. Fails if extent
+ * is empty or misses the raster. */
+extern bool srtm_header_window( const srtm_header_t *const header, const geodetic_extent_t *const extent,
+		uint32_t *col, uint32_t *row, uint32_t *width, uint32_t *height );
+
+// Header of the raster cut to the window of width x height posts from col/row on
+extern void srtm_header_crop( const srtm_header_t *const header, const uint32_t col, const uint32_t row,
+		const uint32_t width, const uint32_t height, srtm_header_t *window );
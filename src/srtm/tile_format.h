@@ -0,0 +1,26 @@
+/* Encodings a tile can be written in. */
+
+#pragma once
+
+#include <stdbool.h>
+#include <string.h>
+
+typedef enum tile_format_t {
+	TILE_FORMAT_PNG = 0,
+	TILE_FORMAT_RAW = 1
+} tile_format_t;
+
+// Name, which is also the file name extension
+static inline const char *tile_format_name( const tile_format_t format ) {
+	return format == TILE_FORMAT_RAW ? "raw" : "png";
+}
+
+static inline bool tile_format_find( const char *const name, tile_format_t *format ) {
+	if( strcmp( name, "png" ) == 0 )
+		*format = TILE_FORMAT_PNG;
+	else if( strcmp( name, "raw" ) == 0 )
+		*format = TILE_FORMAT_RAW;
+	else
+		return false;
+	return true;
+}
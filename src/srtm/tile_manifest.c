@@ -0,0 +1,114 @@
+#include "tile_manifest.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+static char *copy_string( const char *const text, const char *const suffix ) {
+	const size_t length = strlen( text );
+	const size_t suffix_length = strlen( suffix );
+	char *copy = malloc( length + suffix_length + 1 );
+	if( copy ) {
+		memcpy( copy, text, length );
+		memcpy( copy + length, suffix, suffix_length + 1 );
+	}
+	return copy;
+}
+
+// Hashes of the last run, none if it had other parameters or the manifest is broken
+static void read_hashes( FILE *file, tile_manifest_t *manifest ) {
+	char *line = NULL;
+	size_t capacity = 0;
+	ssize_t length;
+	unsigned version = 0;
+	bool valid = ( length = getline( &line, &capacity, file ) ) > 0 &&
+			sscanf( line, "srtm tile manifest %u", &version ) == 1 && version == TILE_MANIFEST_VERSION;
+	if( valid && ( length = getline( &line, &capacity, file ) ) > 0 ) {
+		if( line[length-1] == '\n' )
+			line[--length] = '\0';
+		valid = strncmp( line, "params ", 7 ) == 0 && strcmp( line + 7, manifest->params ) == 0;
+		if( !valid )
+			printf( "Parameters differ from those in manifest '%s', writing all tiles\n", manifest->path );
+	} else
+		valid = false;
+	uint32_t num_read = 0;
+	while( valid && getline( &line, &capacity, file ) > 0 ) {
+		uint32_t tile;
+		uint64_t hash;
+		valid = sscanf( line, "%" SCNu32 " %" SCNx64, &tile, &hash ) == 2;
+		if( valid && tile < manifest->num_tiles ) {
+			manifest->last_hash[tile] = hash;
+			manifest->last_valid[tile] = 1;
+			++num_read;
+		}
+	}
+	free( line );
+	if( !valid )
+		memset( manifest->last_valid, 0, manifest->num_tiles );
+	else
+		printf( "Manifest '%s' has %u tiles of the last run\n", manifest->path, num_read );
+}
+
+bool tile_manifest_open( const char *const path, const char *const params, const uint32_t num_tiles,
+		const bool read_last, tile_manifest_t *manifest ) {
+	memset( manifest, 0, sizeof(*manifest) );
+	manifest->path = copy_string( path, "" );
+	manifest->params = copy_string( params, "" );
+	manifest->num_tiles = num_tiles;
+	manifest->last_hash = calloc( num_tiles, sizeof(uint64_t) );
+	manifest->last_valid = calloc( num_tiles, 1 );
+	manifest->hash = calloc( num_tiles, sizeof(uint64_t) );
+	manifest->state = calloc( num_tiles, 1 );
+	if( !manifest->path || !manifest->params || !manifest->last_hash || !manifest->last_valid ||
+		!manifest->hash || !manifest->state ) {
+		fputs( "Error allocating tile manifest\n", stderr );
+		tile_manifest_close( manifest );
+		return false;
+	}
+	FILE *file = read_last ? fopen( path, "r" ) : NULL;
+	if( file ) {
+		read_hashes( file, manifest );
+		fclose( file );
+	}
+	// Tiles written from here on may not match it
+	remove( path );
+	return true;
+}
+
+uint32_t tile_manifest_count( const tile_manifest_t *const manifest, const tile_state_t state ) {
+	uint32_t count = 0;
+	for( uint32_t i = 0; i < manifest->num_tiles; ++i )
+		count += manifest->state[i] == state;
+	return count;
+}
+
+bool tile_manifest_save( const tile_manifest_t *const manifest ) {
+	char *const temp_path = copy_string( manifest->path, ".tmp" );
+	FILE *file = temp_path ? fopen( temp_path, "w" ) : NULL;
+	bool ok = file != NULL;
+	if( ok )
+		ok = fprintf( file, "srtm tile manifest %u\nparams %s\n", TILE_MANIFEST_VERSION, manifest->params ) > 0;
+	for( uint32_t i = 0; ok && i < manifest->num_tiles; ++i )
+		if( manifest->state[i] != TILE_STATE_NONE )
+			ok = fprintf( file, "%" PRIu32 " %016" PRIx64 "\n", i, manifest->hash[i] ) > 0;
+	if( file && fclose( file ) != 0 )
+		ok = false;
+	if( file && ( !ok || rename( temp_path, manifest->path ) != 0 ) ) {
+		remove( temp_path );
+		ok = false;
+	}
+	if( !ok )
+		fprintf( stderr, "Error writing tile manifest '%s'\n", manifest->path );
+	free( temp_path );
+	return ok;
+}
+
+void tile_manifest_close( tile_manifest_t *manifest ) {
+	free( manifest->path );
+	free( manifest->params );
+	free( manifest->last_hash );
+	free( manifest->last_valid );
+	free( manifest->hash );
+	free( manifest->state );
+	memset( manifest, 0, sizeof(*manifest) );
+}
@@ -0,0 +1,60 @@
+/* Manifest of the tiles a run wrote, so a later run over changed input only writes the tiles
+ * whose posts changed. It holds the encoding parameters of the run and per tile the xxHash64 of
+ * its posts and min/max quadtree, see xxhash64.h. A tile is kept if the parameters are the same,
+ * its hash is and its files are still there. Text, one line each:
+ *   srtm tile manifest <version>
+ *   params <parameters of the run>
+ *   <tile number> <hash in hex>
+ * Tiles are numbered like in a tile container, see tile_pack.h. The manifest is removed when
+ * a run opens it and written when the run ends, an interrupted run leaves none behind. */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define TILE_MANIFEST_VERSION 1
+
+typedef enum tile_state_t {
+	TILE_STATE_NONE = 0,
+	TILE_STATE_WRITTEN,
+	TILE_STATE_KEPT
+} tile_state_t;
+
+typedef struct tile_manifest_t {
+	char *path;
+	char *params;
+	uint32_t num_tiles;
+	// of the last run, 0 for tiles it has no hash of
+	uint64_t *last_hash;
+	uint8_t *last_valid;
+	// of this run, set by each tile's writer
+	uint64_t *hash;
+	uint8_t *state;
+} tile_manifest_t;
+
+/* With read_last set takes the hashes of the manifest at path if it has the same params.
+ * Removes the manifest in any case. params is a single line without line break. */
+extern bool tile_manifest_open( const char *const path, const char *const params, const uint32_t num_tiles,
+		const bool read_last, tile_manifest_t *manifest );
+
+// If the last run wrote the tile with this hash
+static inline bool tile_manifest_unchanged( const tile_manifest_t *const manifest, const uint32_t tile,
+		const uint64_t hash ) {
+	return manifest->last_valid[tile] && manifest->last_hash[tile] == hash;
+}
+
+// Records the tile's hash, state is TILE_STATE_WRITTEN or TILE_STATE_KEPT
+static inline void tile_manifest_set( tile_manifest_t *manifest, const uint32_t tile, const uint64_t hash,
+		const tile_state_t state ) {
+	manifest->hash[tile] = hash;
+	manifest->state[tile] = (uint8_t)state;
+}
+
+// Number of tiles in state
+extern uint32_t tile_manifest_count( const tile_manifest_t *const manifest, const tile_state_t state );
+
+// Writes the tiles set in this run
+extern bool tile_manifest_save( const tile_manifest_t *const manifest );
+
+extern void tile_manifest_close( tile_manifest_t *manifest );
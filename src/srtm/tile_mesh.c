@@ -0,0 +1,179 @@
+#include "tile_mesh.h"
+#include "le_bytes.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// Rows converted at a time, plus one above and one below for the normals
+#define STRIP_ROWS 32
+
+uint32_t tile_mesh_vertex_size( const uint32_t attributes ) {
+	uint32_t floats = 3;
+	if( attributes & TILE_MESH_NORMALS )
+		floats += 3;
+	if( attributes & TILE_MESH_TEX_COORDS )
+		floats += 2;
+	return floats * (uint32_t)sizeof(float);
+}
+
+bool tile_mesh_parse_attributes( const char *const list, uint32_t *attributes ) {
+	*attributes = 0;
+	const char *p = list;
+	while( *p != '\0' ) {
+		const size_t length = strcspn( p, "," );
+		if( length == 8 && strncmp( p, "position", length ) == 0 )
+			;
+		else if( length == 6 && strncmp( p, "normal", length ) == 0 )
+			*attributes |= TILE_MESH_NORMALS;
+		else if( length == 2 && strncmp( p, "uv", length ) == 0 )
+			*attributes |= TILE_MESH_TEX_COORDS;
+		else if( length > 0 )
+			return false;
+		p += length;
+		if( *p == ',' )
+			++p;
+	}
+	return true;
+}
+
+static bool append_floats( byte_buffer_t *out, const float *const values, const size_t count ) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	return byte_buffer_append( out, values, count * sizeof(float) );
+#else
+	unsigned char bytes[count * sizeof(float)];
+	for( size_t i = 0; i < count; ++i ) {
+		uint32_t v;
+		memcpy( &v, &values[i], sizeof(v) );
+		store_u32( bytes + i * sizeof(float), v );
+	}
+	return byte_buffer_append( out, bytes, sizeof(bytes) );
+#endif
+}
+
+bool tile_mesh_encode( const height_grid_t *const grid, const geodetic_grid_t *const geodetic,
+		const ellipsoid_columns_t *const columns, const ellipsoid_t *const e, const vec3d *const center,
+		const uint32_t attributes, byte_buffer_t *out ) {
+	byte_buffer_clear( out );
+	const uint32_t width = geodetic->num_columns;
+	const uint32_t height = geodetic->num_rows;
+	const uint32_t vertex_size = tile_mesh_vertex_size( attributes );
+	unsigned char h[TILE_MESH_HEADER_SIZE] = { 0 };
+	memcpy( h, TILE_MESH_MAGIC, 8 );
+	store_u32( h + 8, TILE_MESH_VERSION );
+	store_u32( h + 12, TILE_MESH_HEADER_SIZE );
+	store_u32( h + 16, width );
+	store_u32( h + 20, height );
+	store_u32( h + 24, attributes );
+	store_u32( h + 28, vertex_size );
+	store_f64( h + 32, center->x );
+	store_f64( h + 40, center->y );
+	store_f64( h + 48, center->z );
+	store_u32( h + 56, width * height );
+	if( !byte_buffer_reserve( out, TILE_MESH_HEADER_SIZE + (size_t)vertex_size * width * height ) ||
+			!byte_buffer_append( out, h, sizeof(h) ) )
+		return false;
+	// Posts with the one on either side
+	const uint32_t wide = width + 2;
+	const size_t strip_posts = (size_t)( STRIP_ROWS + 2 ) * wide;
+	double *const memory = malloc( 3 * strip_posts * sizeof(double) );
+	float *const row = malloc( (size_t)vertex_size * width );
+	bool ok = memory && row;
+	vec3d_soa_t strip = { memory, memory + strip_posts, memory + 2 * strip_posts };
+	const size_t floats = vertex_size / sizeof(float);
+	for( uint32_t first = 0; ok && first < height; first += STRIP_ROWS ) {
+		const uint32_t last = height - first < STRIP_ROWS ? height : first + STRIP_ROWS;
+		// Rows of the strip and the one above and below it, row r of the tile is row r + 1 of grid
+		geodetic_grid_t part = *geodetic;
+		part.lat = geodetic->lat + ( (double)first - 1.0 ) * geodetic->lat_step;
+		part.num_columns = wide;
+		part.num_rows = last - first + 2;
+		ellipsoid_grid_to_cartesian_columns( &part, columns, height_grid_row( grid, first ), grid->stride, e, &strip );
+		for( uint32_t r = first; ok && r < last; ++r ) {
+			const size_t north = (size_t)( r - first ) * wide + 1;
+			const size_t i = north + wide;
+			const size_t south = i + wide;
+			const double lat = radiansd( geodetic->lat + r * geodetic->lat_step );
+			const double cos_lat = cos( lat );
+			const double sin_lat = sin( lat );
+			float *v = row;
+			for( uint32_t c = 0; c < width; ++c ) {
+				*v++ = (float)( strip.x[i + c] - center->x );
+				*v++ = (float)( strip.y[i + c] - center->y );
+				*v++ = (float)( strip.z[i + c] - center->z );
+				if( attributes & TILE_MESH_NORMALS ) {
+					const size_t west = i + c - 1;
+					const size_t east = i + c + 1;
+					const vec3d de = {
+							strip.x[east] - strip.x[west], strip.y[east] - strip.y[west], strip.z[east] - strip.z[west]
+					};
+					const vec3d dn = {
+							strip.x[north + c] - strip.x[south + c], strip.y[north + c] - strip.y[south + c],
+							strip.z[north + c] - strip.z[south + c]
+					};
+					vec3d n = { de.y * dn.z - de.z * dn.y, de.z * dn.x - de.x * dn.z, de.x * dn.y - de.y * dn.x };
+					const double length = sqrt( n.x * n.x + n.y * n.y + n.z * n.z );
+					// Neighbours that all coincide, e.g. at a pole, give the normal of the ellipsoid
+					if( length > 0.0 )
+						n = (vec3d){ n.x / length, n.y / length, n.z / length };
+					else
+						n = (vec3d){ cos_lat * columns->cos_lon[c + 1], cos_lat * columns->sin_lon[c + 1], sin_lat };
+					*v++ = (float)n.x;
+					*v++ = (float)n.y;
+					*v++ = (float)n.z;
+				}
+				if( attributes & TILE_MESH_TEX_COORDS ) {
+					const vec3d normal = { cos_lat * columns->cos_lon[c + 1], cos_lat * columns->sin_lon[c + 1], sin_lat };
+					vec2d tc;
+					ellipsoid_compute_tex_coord( &normal, e, &tc );
+					*v++ = (float)tc.x;
+					*v++ = (float)tc.y;
+				}
+			}
+			ok = append_floats( out, row, floats * width );
+		}
+	}
+	free( row );
+	free( memory );
+	return ok;
+}
+
+bool tile_mesh_encode_indices( const uint32_t width, const uint32_t height, byte_buffer_t *out ) {
+	byte_buffer_clear( out );
+	const bool narrow = (uint64_t)width * height <= 65536;
+	const uint32_t index_size = narrow ? 2 : 4;
+	const uint32_t cells = width > 1 && height > 1 ? ( width - 1 ) * ( height - 1 ) : 0;
+	unsigned char h[TILE_MESH_HEADER_SIZE] = { 0 };
+	memcpy( h, TILE_MESH_INDEX_MAGIC, 8 );
+	store_u32( h + 8, TILE_MESH_VERSION );
+	store_u32( h + 12, TILE_MESH_HEADER_SIZE );
+	store_u32( h + 16, width );
+	store_u32( h + 20, height );
+	store_u32( h + 24, index_size );
+	store_u32( h + 28, cells * 6 );
+	if( !byte_buffer_reserve( out, TILE_MESH_HEADER_SIZE + (size_t)cells * 6 * index_size ) ||
+			!byte_buffer_append( out, h, sizeof(h) ) )
+		return false;
+	// One row of cells at a time
+	unsigned char bytes[6 * sizeof(uint32_t) * ( width > 1 ? width - 1 : 1 )];
+	for( uint32_t r = 0; r + 1 < height; ++r ) {
+		unsigned char *p = bytes;
+		for( uint32_t c = 0; c + 1 < width; ++c ) {
+			// north west, north east, south west, south east; rows run from north to south
+			const uint32_t nw = r * width + c;
+			const uint32_t ne = nw + 1;
+			const uint32_t sw = nw + width;
+			const uint32_t se = sw + 1;
+			const uint32_t triangles[6] = { sw, se, ne, sw, ne, nw };
+			for( unsigned k = 0; k < 6; ++k ) {
+				if( narrow )
+					store_u16( p, (uint16_t)triangles[k] );
+				else
+					store_u32( p, triangles[k] );
+				p += index_size;
+			}
+		}
+		if( !byte_buffer_append( out, bytes, (size_t)( p - bytes ) ) )
+			return false;
+	}
+	return true;
+}
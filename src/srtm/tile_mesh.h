@@ -0,0 +1,59 @@
+/* Mesh of a tile for gpu upload: a vertex file per tile and an index file shared by all tiles of a
+ * size. Positions are single precision relative to a center in double precision, which the renderer
+ * subtracts from the camera position on the cpu, so the posts keep centimetre precision far from the
+ * origin. Vertices are interleaved, row by row from north to south, and can be mapped and uploaded
+ * without touching them.
+ * Vertex file, all header fields little endian:
+ *  0 magic "SRTMMESH"
+ *  8 uint32 version
+ * 12 uint32 header size, offset of the first vertex
+ * 16 uint32 width, 20 uint32 height in posts
+ * 24 uint32 attributes, TILE_MESH_NORMALS | TILE_MESH_TEX_COORDS
+ * 28 uint32 vertex size in bytes
+ * 32 double x, 40 double y, 48 double z of the center
+ * 56 uint32 vertex count, 60 reserved
+ * Each vertex is float x, y, z of the position relative to the center, followed by float x, y, z of
+ * the unit terrain normal with TILE_MESH_NORMALS and float s, t from ellipsoid_compute_tex_coord with
+ * TILE_MESH_TEX_COORDS.
+ * Index file:
+ *  0 magic "SRTMINDX"
+ *  8 uint32 version
+ * 12 uint32 header size, offset of the first index
+ * 16 uint32 width, 20 uint32 height in posts
+ * 24 uint32 index size in bytes, 2 if width * height fits uint16, else 4
+ * 28 uint32 index count
+ * followed by a triangle list, two triangles per cell, counter clockwise seen from above. */
+
+#pragma once
+
+#include <stdbool.h>
+#include "height_grid.h"
+#include "byte_buffer.h"
+#include "../omath/ellipsoid_batch.h"
+
+#define TILE_MESH_MAGIC "SRTMMESH"
+#define TILE_MESH_INDEX_MAGIC "SRTMINDX"
+#define TILE_MESH_VERSION 1
+#define TILE_MESH_HEADER_SIZE 64
+
+#define TILE_MESH_NORMALS 1u
+#define TILE_MESH_TEX_COORDS 2u
+
+// Bytes of a vertex with attributes
+extern uint32_t tile_mesh_vertex_size( const uint32_t attributes );
+
+/* Parses a comma separated list of attributes, "position", "normal" and "uv"; positions are always
+ * there. Returns false on an unknown attribute. */
+extern bool tile_mesh_parse_attributes( const char *const list, uint32_t *attributes );
+
+/* Encodes the posts of the tile at geodetic as vertices relative to center into out, which is
+ * cleared first. grid holds the tile's posts and one more on each side, from the neighbouring tiles
+ * or repeated at the edge of the raster; columns is the table of grid's columns. Normals are central
+ * differences of the neighbouring positions, so tiles that share an edge give its posts the same
+ * normals. Returns false if memory can't be allocated. */
+extern bool tile_mesh_encode( const height_grid_t *const grid, const geodetic_grid_t *const geodetic,
+		const ellipsoid_columns_t *const columns, const ellipsoid_t *const e, const vec3d *const center,
+		const uint32_t attributes, byte_buffer_t *out );
+
+// Encodes the index buffer of tiles of width by height posts into out, which is cleared first
+extern bool tile_mesh_encode_indices( const uint32_t width, const uint32_t height, byte_buffer_t *out );
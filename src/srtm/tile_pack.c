@@ -0,0 +1,258 @@
+#include "tile_pack.h"
+#include "le_bytes.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define HEADER_SIZE 64
+
+static uint64_t align_up( const uint64_t offset ) {
+	return ( offset + TILE_PACK_ALIGNMENT - 1 ) / TILE_PACK_ALIGNMENT * TILE_PACK_ALIGNMENT;
+}
+
+static bool write_all( const int fd, const void *data, size_t size, uint64_t offset ) {
+	const unsigned char *p = data;
+	while( size > 0 ) {
+		const ssize_t n = pwrite( fd, p, size, (off_t)offset );
+		if( n < 0 && errno == EINTR )
+			continue;
+		if( n <= 0 )
+			return false;
+		p += n;
+		size -= (size_t)n;
+		offset += (uint64_t)n;
+	}
+	return true;
+}
+
+static bool read_all( const int fd, void *data, size_t size, uint64_t offset ) {
+	unsigned char *p = data;
+	while( size > 0 ) {
+		const ssize_t n = pread( fd, p, size, (off_t)offset );
+		if( n < 0 && errno == EINTR )
+			continue;
+		if( n <= 0 )
+			return false;
+		p += n;
+		size -= (size_t)n;
+		offset += (uint64_t)n;
+	}
+	return true;
+}
+
+static bool write_header( const tile_pack_t *const pack ) {
+	unsigned char h[HEADER_SIZE] = { 0 };
+	memcpy( h, TILE_PACK_MAGIC, 8 );
+	store_u32( h + 8, TILE_PACK_VERSION );
+	store_u32( h + 12, pack->num_tiles );
+	store_u64( h + 16, pack->index_offset );
+	store_u32( h + 24, pack->entry_size );
+	store_u32( h + 28, pack->tilesize );
+	store_u32( h + 32, pack->num_columns );
+	store_u32( h + 36, pack->num_rows );
+	store_f64( h + 40, pack->longitude );
+	store_f64( h + 48, pack->latitude );
+	store_f64( h + 56, pack->cellsize );
+	return write_all( pack->fd, h, sizeof(h), 0 );
+}
+
+static void store_vec3d( unsigned char *p, const vec3d *const v ) {
+	store_f64( p, v->x );
+	store_f64( p + 8, v->y );
+	store_f64( p + 16, v->z );
+}
+
+static void load_vec3d( const unsigned char *p, vec3d *v ) {
+	v->x = load_f64( p );
+	v->y = load_f64( p + 8 );
+	v->z = load_f64( p + 16 );
+}
+
+static void store_entry( unsigned char *p, const tile_pack_entry_t *const e ) {
+	memset( p, 0, TILE_PACK_ENTRY_SIZE );
+	store_u32( p, e->tile );
+	store_u32( p + 4, e->format );
+	store_u64( p + 8, e->offset );
+	store_u64( p + 16, e->length );
+	store_u32( p + 24, e->min_x );
+	store_u32( p + 28, e->min_z );
+	store_u32( p + 32, e->max_x );
+	store_u32( p + 36, e->max_z );
+	store_u16( p + 40, e->min_height );
+	store_u16( p + 42, e->max_height );
+	store_u32( p + 44, e->level );
+	store_f64( p + 48, e->longitude );
+	store_f64( p + 56, e->latitude );
+	store_u64( p + 64, e->tree_offset );
+	store_u64( p + 72, e->tree_length );
+	store_vec3d( p + 80, &e->ecef.min );
+	store_vec3d( p + 104, &e->ecef.max );
+	store_vec3d( p + 128, &e->ecef.center );
+	store_f64( p + 152, e->ecef.radius );
+	store_vec3d( p + 160, &e->ecef.box_center );
+	for( unsigned i = 0; i < 3; ++i )
+		store_vec3d( p + 184 + 24 * i, &e->ecef.axes[i] );
+	store_vec3d( p + 256, &e->ecef.half_extents );
+}
+
+static void load_entry( const unsigned char *p, tile_pack_entry_t *e ) {
+	e->tile = load_u32( p );
+	e->format = load_u32( p + 4 );
+	e->offset = load_u64( p + 8 );
+	e->length = load_u64( p + 16 );
+	e->min_x = load_u32( p + 24 );
+	e->min_z = load_u32( p + 28 );
+	e->max_x = load_u32( p + 32 );
+	e->max_z = load_u32( p + 36 );
+	e->min_height = load_u16( p + 40 );
+	e->max_height = load_u16( p + 42 );
+	e->level = load_u32( p + 44 );
+	e->longitude = load_f64( p + 48 );
+	e->latitude = load_f64( p + 56 );
+	e->tree_offset = load_u64( p + 64 );
+	e->tree_length = load_u64( p + 72 );
+	load_vec3d( p + 80, &e->ecef.min );
+	load_vec3d( p + 104, &e->ecef.max );
+	load_vec3d( p + 128, &e->ecef.center );
+	e->ecef.radius = load_f64( p + 152 );
+	load_vec3d( p + 160, &e->ecef.box_center );
+	for( unsigned i = 0; i < 3; ++i )
+		load_vec3d( p + 184 + 24 * i, &e->ecef.axes[i] );
+	load_vec3d( p + 256, &e->ecef.half_extents );
+}
+
+bool tile_pack_create( const char *const path, const srtm_header_t *const header,
+		const uint32_t num_tiles, tile_pack_t *pack ) {
+	memset( pack, 0, sizeof(*pack) );
+	pack->fd = open( path, O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+	if( pack->fd < 0 ) {
+		fprintf( stderr, "Error creating tile pack '%s': %s\n", path, strerror(errno) );
+		return false;
+	}
+	pack->version = TILE_PACK_VERSION;
+	pack->num_tiles = num_tiles;
+	pack->entry_size = TILE_PACK_ENTRY_SIZE;
+	pack->tilesize = header->tilesize;
+	pack->num_columns = header->num_columns;
+	pack->num_rows = header->num_rows;
+	pack->longitude = header->longitude;
+	pack->latitude = header->latitude;
+	pack->cellsize = header->cellsize;
+	pack->entries = calloc( num_tiles, sizeof(tile_pack_entry_t) );
+	for( uint32_t i = 0; pack->entries && i < num_tiles; ++i )
+		pack->entries[i].tile = i;
+	pack->end = TILE_PACK_ALIGNMENT;
+	pthread_mutex_init( &pack->mutex, NULL );
+	// The header is written again with the index offset when done
+	if( !pack->entries || !write_header( pack ) ) {
+		fprintf( stderr, "Error writing tile pack '%s'\n", path );
+		tile_pack_close( pack );
+		return false;
+	}
+	return true;
+}
+
+bool tile_pack_add( tile_pack_t *pack, tile_pack_entry_t *entry, const void *const data, const size_t size,
+		const void *const tree, const size_t tree_size ) {
+	if( entry->tile >= pack->num_tiles )
+		return false;
+	pthread_mutex_lock( &pack->mutex );
+	entry->offset = pack->end;
+	entry->length = size;
+	// The quadtree follows the payload unaligned, it is small
+	entry->tree_offset = tree_size > 0 ? entry->offset + size : 0;
+	entry->tree_length = tree_size;
+	const bool ok = write_all( pack->fd, data, size, entry->offset ) &&
+			write_all( pack->fd, tree, tree_size, entry->tree_offset );
+	if( ok ) {
+		pack->end = align_up( entry->offset + size + tree_size );
+		pack->entries[entry->tile] = *entry;
+	}
+	pthread_mutex_unlock( &pack->mutex );
+	return ok;
+}
+
+bool tile_pack_finish( tile_pack_t *pack ) {
+	pack->index_offset = pack->end;
+	const size_t index_size = (size_t)pack->num_tiles * TILE_PACK_ENTRY_SIZE;
+	unsigned char *index = malloc( index_size );
+	bool ok = index != NULL;
+	for( uint32_t i = 0; ok && i < pack->num_tiles; ++i )
+		store_entry( index + (size_t)i * TILE_PACK_ENTRY_SIZE, &pack->entries[i] );
+	ok = ok && write_all( pack->fd, index, index_size, pack->index_offset ) && write_header( pack );
+	free( index );
+	if( close( pack->fd ) != 0 )
+		ok = false;
+	pack->fd = -1;
+	tile_pack_close( pack );
+	if( !ok )
+		fputs( "Error writing tile pack index\n", stderr );
+	return ok;
+}
+
+bool tile_pack_open( const char *const path, tile_pack_t *pack ) {
+	memset( pack, 0, sizeof(*pack) );
+	pack->fd = open( path, O_RDONLY );
+	unsigned char h[HEADER_SIZE];
+	if( pack->fd < 0 || !read_all( pack->fd, h, sizeof(h), 0 ) || memcmp( h, TILE_PACK_MAGIC, 8 ) != 0 ) {
+		fprintf( stderr, "'%s' is not a tile pack\n", path );
+		tile_pack_close( pack );
+		return false;
+	}
+	pack->version = load_u32( h + 8 );
+	pack->num_tiles = load_u32( h + 12 );
+	pack->index_offset = load_u64( h + 16 );
+	pack->entry_size = load_u32( h + 24 );
+	pack->tilesize = load_u32( h + 28 );
+	pack->num_columns = load_u32( h + 32 );
+	pack->num_rows = load_u32( h + 36 );
+	pack->longitude = load_f64( h + 40 );
+	pack->latitude = load_f64( h + 48 );
+	pack->cellsize = load_f64( h + 56 );
+	if( pack->version != TILE_PACK_VERSION || pack->entry_size < TILE_PACK_MIN_ENTRY_SIZE || pack->index_offset == 0 ) {
+		fprintf( stderr, "Tile pack '%s' is incomplete or of an unknown version\n", path );
+		tile_pack_close( pack );
+		return false;
+	}
+	return true;
+}
+
+bool tile_pack_find( const tile_pack_t *const pack, const uint32_t tile, tile_pack_entry_t *entry ) {
+	unsigned char e[TILE_PACK_ENTRY_SIZE] = { 0 };
+	const size_t size = pack->entry_size < sizeof(e) ? pack->entry_size : sizeof(e);
+	if( tile >= pack->num_tiles ||
+		!read_all( pack->fd, e, size, pack->index_offset + (uint64_t)tile * pack->entry_size ) )
+		return false;
+	load_entry( e, entry );
+	return entry->length > 0;
+}
+
+static bool read_range( const tile_pack_t *const pack, const uint64_t offset, const uint64_t length,
+		byte_buffer_t *out ) {
+	byte_buffer_clear( out );
+	if( !byte_buffer_reserve( out, length ) || !read_all( pack->fd, out->data, length, offset ) )
+		return false;
+	out->size = length;
+	return true;
+}
+
+bool tile_pack_read( const tile_pack_t *const pack, const tile_pack_entry_t *const entry, byte_buffer_t *out ) {
+	return read_range( pack, entry->offset, entry->length, out );
+}
+
+bool tile_pack_read_tree( const tile_pack_t *const pack, const tile_pack_entry_t *const entry, byte_buffer_t *out ) {
+	return entry->tree_length > 0 && read_range( pack, entry->tree_offset, entry->tree_length, out );
+}
+
+void tile_pack_close( tile_pack_t *pack ) {
+	if( pack->entries ) {
+		free( pack->entries );
+		pthread_mutex_destroy( &pack->mutex );
+	}
+	if( pack->fd >= 0 )
+		close( pack->fd );
+	memset( pack, 0, sizeof(*pack) );
+	pack->fd = -1;
+}
@@ -0,0 +1,102 @@
+/* Container that holds all tiles of a run in one file, so a network file system sees one
+ * file instead of thousands. Layout, all values little endian:
+ * - header, padded to TILE_PACK_ALIGNMENT:
+ *    0 magic "SRTMPACK", 8 uint32 version, 12 uint32 number of tiles,
+ *   16 uint64 offset of the index, 24 uint32 size of an index entry, 28 uint32 tilesize,
+ *   32 uint32 columns, 36 uint32 rows of the source raster,
+ *   40 double longitude, 48 double latitude of its lower left, 56 double cellsize
+ * - tile payloads, each starting on a multiple of TILE_PACK_ALIGNMENT
+ * - index, one entry per tile in order of tile number, so entry n is at
+ *   index offset + n * entry size:
+ *    0 uint32 tile number, 4 uint32 tile_format_t, 8 uint64 offset, 16 uint64 length (0: missing),
+ *   24 uint32 min x (column), 28 min z (row), 32 max x, 36 max z in posts of the source raster,
+ *   40 uint16 min height, 42 uint16 max height, 44 uint32 level of detail, 0 is full resolution,
+ *   48 double longitude, 56 double latitude of the tile's lower left post,
+ *   64 uint64 offset, 72 uint64 length of the tile's min/max quadtree, see minmax_tree.h (0: none),
+ *   doubles of the cartesian bounding volumes, see ecef_bounds.h (radius 0: none):
+ *   80 aabb min x, y, z, 104 max x, y, z, 128 sphere center x, y, z, 152 radius,
+ *   160 oriented box center x, y, z, 184 east, 208 north, 232 up axis x, y, z, 256 half extents
+ * Readers take entries of at least 64 bytes, fields beyond the entry size are 0. Entries grew from
+ * 64 to 80 and 280 bytes while the version stayed 1, so readers go by the entry size of the header,
+ * never by TILE_PACK_VERSION, to tell which fields a pack has.
+ * The index is written last and the header is patched with its offset at the end. */
+
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "byte_buffer.h"
+#include "ecef_bounds.h"
+#include "srtm_header.h"
+
+#define TILE_PACK_MAGIC "SRTMPACK"
+#define TILE_PACK_VERSION 1
+#define TILE_PACK_ALIGNMENT 4096
+#define TILE_PACK_ENTRY_SIZE 280
+// Size of the entries of the first packs, without quadtree
+#define TILE_PACK_MIN_ENTRY_SIZE 64
+
+typedef struct tile_pack_entry_t {
+	uint32_t tile;
+	uint32_t format;
+	uint64_t offset;
+	uint64_t length;
+	uint32_t min_x;
+	uint32_t min_z;
+	uint32_t max_x;
+	uint32_t max_z;
+	uint16_t min_height;
+	uint16_t max_height;
+	uint32_t level;
+	double longitude;
+	double latitude;
+	uint64_t tree_offset;
+	uint64_t tree_length;
+	ecef_bounds_t ecef;
+} tile_pack_entry_t;
+
+typedef struct tile_pack_t {
+	int fd;
+	uint32_t version;
+	uint32_t num_tiles;
+	uint32_t tilesize;
+	uint32_t num_columns;
+	uint32_t num_rows;
+	double longitude;
+	double latitude;
+	double cellsize;
+	uint64_t index_offset;
+	uint32_t entry_size;
+	// Writing only: entries collected until the index is written, and the end of the data
+	tile_pack_entry_t *entries;
+	uint64_t end;
+	pthread_mutex_t mutex;
+} tile_pack_t;
+
+// Creates the file for num_tiles tiles of the raster described by header
+extern bool tile_pack_create( const char *const path, const srtm_header_t *const header,
+		const uint32_t num_tiles, tile_pack_t *pack );
+
+/* Appends a tile's payload and its min/max quadtree, if tree_size > 0, and keeps its entry for the
+ * index; offsets and lengths of the entry are set here. May be called from several threads. */
+extern bool tile_pack_add( tile_pack_t *pack, tile_pack_entry_t *entry, const void *const data, const size_t size,
+		const void *const tree, const size_t tree_size );
+
+// Writes the index, patches the header and closes the file
+extern bool tile_pack_finish( tile_pack_t *pack );
+
+// Opens a pack for reading
+extern bool tile_pack_open( const char *const path, tile_pack_t *pack );
+
+// Reads the index entry of a tile, one pread
+extern bool tile_pack_find( const tile_pack_t *const pack, const uint32_t tile, tile_pack_entry_t *entry );
+
+// Reads a tile's payload into out, one pread
+extern bool tile_pack_read( const tile_pack_t *const pack, const tile_pack_entry_t *const entry, byte_buffer_t *out );
+
+// Reads a tile's min/max quadtree into out, one pread
+extern bool tile_pack_read_tree( const tile_pack_t *const pack, const tile_pack_entry_t *const entry, byte_buffer_t *out );
+
+extern void tile_pack_close( tile_pack_t *pack );
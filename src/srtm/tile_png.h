@@ -0,0 +1,24 @@
+/* Encodes height tiles as 16 bit grayscale png. The compression profile fixes the
+ * row filter and the zlib settings. */
+
+#pragma once
+
+#include "height_grid.h"
+#include "byte_buffer.h"
+
+typedef struct png_profile_t {
+	const char *name;
+	int zlib_level;
+	int zlib_strategy;
+	// PNG_FILTER_* mask
+	int filters;
+} png_profile_t;
+
+// Profile by name, fastest, balanced or smallest; NULL if there is none of that name
+extern const png_profile_t *png_profile_find( const char *const name );
+
+extern const png_profile_t *png_profile_default( void );
+
+// Encodes the grid as png into out, which is cleared first
+extern bool tile_png_encode( const height_grid_t *const image, const png_profile_t *const profile,
+		byte_buffer_t *out );
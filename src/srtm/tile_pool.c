@@ -0,0 +1,100 @@
+#define _GNU_SOURCE		// open_memstream
+#include "tile_pool.h"
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+typedef struct job_log_t {
+	char *text;
+	size_t size;
+	bool done;
+} job_log_t;
+
+typedef struct tile_pool_t {
+	tile_pool_func_t func;
+	void *context;
+	uint32_t num_jobs;
+	uint32_t next_job;
+	job_log_t *logs;
+	bool failed;
+	pthread_mutex_t mutex;
+	pthread_cond_t job_done;
+} tile_pool_t;
+
+typedef struct worker_t {
+	tile_pool_t *pool;
+	unsigned index;
+} worker_t;
+
+static void *worker_main( void *arg ) {
+	const worker_t *const worker = arg;
+	tile_pool_t *const pool = worker->pool;
+	for(;;) {
+		pthread_mutex_lock( &pool->mutex );
+		const uint32_t job = pool->next_job < pool->num_jobs ? pool->next_job++ : pool->num_jobs;
+		pthread_mutex_unlock( &pool->mutex );
+		if( job == pool->num_jobs )
+			break;
+		job_log_t *const log = &pool->logs[job];
+		FILE *log_file = open_memstream( &log->text, &log->size );
+		const bool ok = pool->func( pool->context, worker->index, job, log_file ? log_file : stdout );
+		if( log_file )
+			fclose( log_file );
+		pthread_mutex_lock( &pool->mutex );
+		log->done = true;
+		pool->failed |= !ok;
+		pthread_cond_signal( &pool->job_done );
+		pthread_mutex_unlock( &pool->mutex );
+	}
+	return NULL;
+}
+
+bool tile_pool_run( const unsigned num_workers, const uint32_t num_jobs,
+		tile_pool_func_t func, void *context ) {
+	if( num_workers <= 1 || num_jobs <= 1 ) {
+		bool ok = true;
+		for( uint32_t job = 0; job < num_jobs; ++job )
+			ok &= func( context, 0, job, stdout );
+		return ok;
+	}
+	tile_pool_t pool = { .func = func, .context = context, .num_jobs = num_jobs };
+	pool.logs = calloc( num_jobs, sizeof(job_log_t) );
+	if( !pool.logs )
+		return false;
+	pthread_mutex_init( &pool.mutex, NULL );
+	pthread_cond_init( &pool.job_done, NULL );
+	const unsigned num_threads = num_workers < num_jobs ? num_workers : num_jobs;
+	pthread_t threads[num_threads];
+	worker_t workers[num_threads];
+	unsigned started = 0;
+	for( ; started < num_threads; ++started ) {
+		workers[started] = (worker_t){ &pool, started };
+		if( pthread_create( &threads[started], NULL, worker_main, &workers[started] ) != 0 )
+			break;
+	}
+	if( started == 0 ) {
+		// No threads to be had, do it here
+		free( pool.logs );
+		pthread_cond_destroy( &pool.job_done );
+		pthread_mutex_destroy( &pool.mutex );
+		return tile_pool_run( 1, num_jobs, func, context );
+	}
+	// Print the logs in job order while the workers go on
+	pthread_mutex_lock( &pool.mutex );
+	for( uint32_t job = 0; job < num_jobs; ++job ) {
+		while( !pool.logs[job].done )
+			pthread_cond_wait( &pool.job_done, &pool.mutex );
+		pthread_mutex_unlock( &pool.mutex );
+		if( pool.logs[job].text )
+			fwrite( pool.logs[job].text, 1, pool.logs[job].size, stdout );
+		free( pool.logs[job].text );
+		pthread_mutex_lock( &pool.mutex );
+	}
+	pthread_mutex_unlock( &pool.mutex );
+	for( unsigned i = 0; i < started; ++i )
+		pthread_join( threads[i], NULL );
+	pthread_cond_destroy( &pool.job_done );
+	pthread_mutex_destroy( &pool.mutex );
+	free( pool.logs );
+	return !pool.failed;
+}
@@ -0,0 +1,17 @@
+/* Runs a number of independent jobs, e.g. encoding tiles, on a pool of worker threads.
+ * Each job writes its console output to its own log, the logs are printed in job order
+ * as the jobs finish. */
+
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Job function. worker is the index of the calling thread, for per worker scratch data in context.
+ * Returns false on failure. */
+typedef bool (*tile_pool_func_t)( void *context, const unsigned worker, const uint32_t job, FILE *log );
+
+// Runs jobs 0 to num_jobs-1 on num_workers threads. Returns false if any job failed.
+extern bool tile_pool_run( const unsigned num_workers, const uint32_t num_jobs,
+		tile_pool_func_t func, void *context );
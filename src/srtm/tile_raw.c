@@ -0,0 +1,66 @@
+#include "tile_raw.h"
+#include "le_bytes.h"
+#include <string.h>
+
+// Row pitch in posts
+#define ROW_ALIGNMENT 128
+
+bool tile_raw_encode( const height_grid_t *const image, tile_raw_header_t *header, byte_buffer_t *out ) {
+	byte_buffer_clear( out );
+	header->version = TILE_RAW_VERSION;
+	header->header_size = TILE_RAW_HEADER_SIZE;
+	header->width = image->width;
+	header->height = image->height;
+	header->stride = ( image->width + ROW_ALIGNMENT - 1 ) / ROW_ALIGNMENT * ROW_ALIGNMENT;
+	unsigned char h[TILE_RAW_HEADER_SIZE] = { 0 };
+	memcpy( h, TILE_RAW_MAGIC, 8 );
+	store_u32( h + 8, header->version );
+	store_u32( h + 12, header->header_size );
+	store_u32( h + 16, header->width );
+	store_u32( h + 20, header->height );
+	store_u32( h + 24, header->stride );
+	store_u16( h + 28, header->min_height );
+	store_u16( h + 30, header->max_height );
+	store_u32( h + 32, header->start_col );
+	store_u32( h + 36, header->start_row );
+	store_f64( h + 40, header->longitude );
+	store_f64( h + 48, header->latitude );
+	store_f64( h + 56, header->cellsize );
+	if( !byte_buffer_append( out, h, sizeof(h) ) )
+		return false;
+	uint16_t row[header->stride];
+	memset( row, 0, sizeof(row) );
+	for( uint32_t r = 0; r < image->height; ++r ) {
+		const uint16_t *const posts = height_grid_row( image, r );
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+		memcpy( row, posts, image->width * sizeof(uint16_t) );
+#else
+		for( uint32_t c = 0; c < image->width; ++c )
+			store_u16( (unsigned char *)&row[c], posts[c] );
+#endif
+		if( !byte_buffer_append( out, row, sizeof(row) ) )
+			return false;
+	}
+	return true;
+}
+
+bool tile_raw_parse_header( const void *const data, const size_t size, tile_raw_header_t *header ) {
+	const unsigned char *const h = data;
+	if( size < TILE_RAW_HEADER_SIZE || memcmp( h, TILE_RAW_MAGIC, 8 ) != 0 )
+		return false;
+	header->version = load_u32( h + 8 );
+	header->header_size = load_u32( h + 12 );
+	header->width = load_u32( h + 16 );
+	header->height = load_u32( h + 20 );
+	header->stride = load_u32( h + 24 );
+	header->min_height = load_u16( h + 28 );
+	header->max_height = load_u16( h + 30 );
+	header->start_col = load_u32( h + 32 );
+	header->start_row = load_u32( h + 36 );
+	header->longitude = load_f64( h + 40 );
+	header->latitude = load_f64( h + 48 );
+	header->cellsize = load_f64( h + 56 );
+	return header->version == TILE_RAW_VERSION && header->header_size >= TILE_RAW_HEADER_SIZE &&
+			header->stride >= header->width &&
+			(uint64_t)header->header_size + (uint64_t)header->stride * header->height * sizeof(uint16_t) <= size;
+}
@@ -0,0 +1,44 @@
+/* Raw tile format: a 64 byte header followed by the posts as little endian uint16, row by row
+ * from north to south. Rows are padded to 256 bytes, the row pitch gpu upload apis want, so a
+ * renderer can map the file and upload the posts without touching them.
+ * All header fields are little endian:
+ *  0 magic "SRTMTILE"
+ *  8 uint32 version
+ * 12 uint32 header size, offset of the first post
+ * 16 uint32 width, 20 uint32 height in posts
+ * 24 uint32 stride, posts from one row to the next
+ * 28 uint16 min height, 30 uint16 max height
+ * 32 uint32 first column, 36 uint32 first row of the tile in the source raster
+ * 40 double longitude, 48 double latitude of the lower left post
+ * 56 double cellsize in degrees */
+
+#pragma once
+
+#include "height_grid.h"
+#include "byte_buffer.h"
+
+#define TILE_RAW_MAGIC "SRTMTILE"
+#define TILE_RAW_VERSION 1
+#define TILE_RAW_HEADER_SIZE 64
+
+typedef struct tile_raw_header_t {
+	uint32_t version;
+	uint32_t header_size;
+	uint32_t width;
+	uint32_t height;
+	uint32_t stride;
+	uint16_t min_height;
+	uint16_t max_height;
+	uint32_t start_col;
+	uint32_t start_row;
+	double longitude;
+	double latitude;
+	double cellsize;
+} tile_raw_header_t;
+
+/* Encodes the grid with the header into out, which is cleared first. The size and stride
+ * fields of the header are set from the grid. */
+extern bool tile_raw_encode( const height_grid_t *const image, tile_raw_header_t *header, byte_buffer_t *out );
+
+// Reads and checks the header at the start of a raw tile of size bytes
+extern bool tile_raw_parse_header( const void *const data, const size_t size, tile_raw_header_t *header );
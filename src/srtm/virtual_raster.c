@@ -0,0 +1,334 @@
+#include "virtual_raster.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const height_grid_t *tile_grid( virtual_raster_t *raster, const uint32_t tx, const uint32_t ty,
+		const uint32_t level );
+
+// Maps the grid cache of the input if there is a valid one, its checksum is left to full runs
+static bool open_grid_cache( const char *const path, const bool mosaic, const uint32_t tilesize,
+		virtual_raster_t *raster ) {
+	uint64_t fingerprint;
+	if( !grid_cache_fingerprint( path, mosaic, &fingerprint ) ||
+		!grid_cache_open( path, fingerprint, false, &raster->grid_cache ) )
+		return false;
+	if( raster->grid_cache.header.num_columns < tilesize || raster->grid_cache.header.num_rows < tilesize ) {
+		grid_cache_close( &raster->grid_cache );
+		return false;
+	}
+	printf( "Tiles of '%s' are read from its grid cache\n", path );
+	return true;
+}
+
+bool virtual_raster_open( const char *const path, const bool mosaic, const uint32_t tilesize,
+		const lod_filter_t filter, const size_t budget, const unsigned num_threads, const bool use_grid_cache,
+		virtual_raster_t *raster ) {
+	memset( raster, 0, sizeof(*raster) );
+	if( use_grid_cache && open_grid_cache( path, mosaic, tilesize, raster ) ) {
+		raster->header = raster->grid_cache.header;
+		raster->header.tilesize = tilesize;
+	} else {
+		if( !( mosaic ? mosaic_open( path, tilesize, &raster->mosaic ) :
+				mosaic_open_file( path, tilesize, &raster->mosaic ) ) )
+			return false;
+		if( !mosaic_index_rows( &raster->mosaic ) ) {
+			mosaic_close( &raster->mosaic );
+			return false;
+		}
+		raster->header = raster->mosaic.header;
+	}
+	raster->filter = filter;
+	raster->num_h_tiles = raster->header.num_columns / tilesize;
+	raster->num_v_tiles = raster->header.num_rows / tilesize;
+	raster->num_levels = lod_num_levels( raster->num_h_tiles, raster->num_v_tiles );
+	raster->num_threads = num_threads;
+	raster->budget = budget;
+	asc_parse_stats_init( &raster->stats );
+	pthread_mutex_init( &raster->mutex, NULL );
+	return true;
+}
+
+void virtual_raster_level_tiles( const virtual_raster_t *const raster, const uint32_t level,
+		uint32_t *num_h_tiles, uint32_t *num_v_tiles ) {
+	*num_h_tiles = lod_level_tiles( raster->num_h_tiles, level );
+	*num_v_tiles = lod_level_tiles( raster->num_v_tiles, level );
+}
+
+// Posts of level along each axis: level 0 is the whole raster, coarser levels are whole tiles
+static void level_size( const virtual_raster_t *const raster, const uint32_t level,
+		uint32_t *width, uint32_t *height ) {
+	if( level == 0 ) {
+		*width = raster->header.num_columns;
+		*height = raster->header.num_rows;
+		return;
+	}
+	const uint32_t step = raster->header.tilesize - 1;
+	virtual_raster_level_tiles( raster, level, width, height );
+	*width = *width * step + 1;
+	*height = *height * step + 1;
+}
+
+static inline uint32_t clamp_post( const int64_t i, const uint32_t size ) {
+	return i < 0 ? 0 : i >= size ? size - 1 : (uint32_t)i;
+}
+
+// Copies the posts of level from col/row on, all of which exist, into the top left of window
+static bool read_level( virtual_raster_t *raster, const uint32_t level, const uint32_t col, const uint32_t row,
+		const uint32_t width, const uint32_t height, height_grid_t *window ) {
+	if( level == 0 && raster->grid_cache.map ) {
+		uint16_t min, max;
+		height_grid_t posts;
+		height_grid_copy_window( &raster->grid_cache.grid, col, row,
+				height_grid_view( window, 0, 0, width, height, &posts ), &min, &max );
+		return true;
+	}
+	if( level == 0 )
+		return mosaic_read_window( &raster->mosaic, col, row, width, height, window, raster->num_threads,
+				&raster->stats );
+	const uint32_t tilesize = raster->header.tilesize;
+	const uint32_t step = tilesize - 1;
+	uint32_t num_h_tiles, num_v_tiles;
+	virtual_raster_level_tiles( raster, level, &num_h_tiles, &num_v_tiles );
+	// The last post of a level is only in the last tile
+	const uint32_t first_tx = col / step < num_h_tiles - 1 ? col / step : num_h_tiles - 1;
+	const uint32_t last_tx = ( col + width - 1 ) / step < num_h_tiles - 1 ? ( col + width - 1 ) / step : num_h_tiles - 1;
+	const uint32_t first_ty = row / step < num_v_tiles - 1 ? row / step : num_v_tiles - 1;
+	const uint32_t last_ty = ( row + height - 1 ) / step < num_v_tiles - 1 ? ( row + height - 1 ) / step : num_v_tiles - 1;
+	for( uint32_t ty = first_ty; ty <= last_ty; ++ty ) {
+		for( uint32_t tx = first_tx; tx <= last_tx; ++tx ) {
+			// Valid until the next tile is asked for
+			const height_grid_t *const tile = tile_grid( raster, tx, ty, level );
+			if( !tile )
+				return false;
+			const uint32_t c0 = col > tx * step ? col : tx * step;
+			const uint32_t c1 = col + width < tx * step + tilesize ? col + width : tx * step + tilesize;
+			const uint32_t r0 = row > ty * step ? row : ty * step;
+			const uint32_t r1 = row + height < ty * step + tilesize ? row + height : ty * step + tilesize;
+			for( uint32_t r = r0; r < r1; ++r )
+				memcpy( height_grid_row( window, r - row ) + ( c0 - col ),
+						height_grid_row( tile, r - ty * step ) + ( c0 - tx * step ), ( c1 - c0 ) * sizeof(uint16_t) );
+		}
+	}
+	return true;
+}
+
+/* Fills window with the posts of level from col/row on. Posts beyond the level repeat its edge,
+ * like lod_downsample does; col and row are never beyond its last post. */
+static bool read_level_clamped( virtual_raster_t *raster, const uint32_t level, const int64_t col,
+		const int64_t row, height_grid_t *window ) {
+	uint32_t width, height;
+	level_size( raster, level, &width, &height );
+	const uint32_t c0 = clamp_post( col, width );
+	const uint32_t c1 = clamp_post( col + window->width - 1, width );
+	const uint32_t r0 = clamp_post( row, height );
+	const uint32_t r1 = clamp_post( row + window->height - 1, height );
+	const uint32_t left = (uint32_t)( c0 - col );
+	const uint32_t right = left + c1 - c0;
+	const uint32_t top = (uint32_t)( r0 - row );
+	const uint32_t bottom = top + r1 - r0;
+	height_grid_t inner;
+	if( !read_level( raster, level, c0, r0, c1 - c0 + 1, r1 - r0 + 1,
+			height_grid_view( window, left, top, c1 - c0 + 1, r1 - r0 + 1, &inner ) ) )
+		return false;
+	for( uint32_t r = top; r <= bottom; ++r ) {
+		uint16_t *const posts = height_grid_row( window, r );
+		for( uint32_t c = 0; c < left; ++c )
+			posts[c] = posts[left];
+		for( uint32_t c = right + 1; c < window->width; ++c )
+			posts[c] = posts[right];
+	}
+	for( uint32_t r = 0; r < top; ++r )
+		memcpy( height_grid_row( window, r ), height_grid_row( window, top ), window->width * sizeof(uint16_t) );
+	for( uint32_t r = bottom + 1; r < window->height; ++r )
+		memcpy( height_grid_row( window, r ), height_grid_row( window, bottom ), window->width * sizeof(uint16_t) );
+	return true;
+}
+
+/* Level 0 tiles are read from the inputs. Those of a coarser level are filtered from the window
+ * of the level below around the posts they sit on, with a border of one post. */
+static raster_tile_t *make_tile( virtual_raster_t *raster, const uint32_t tx, const uint32_t ty,
+		const uint32_t level ) {
+	const uint32_t tilesize = raster->header.tilesize;
+	const uint32_t step = tilesize - 1;
+	raster_tile_t *tile = calloc( 1, sizeof(raster_tile_t) );
+	if( !tile || !height_grid_create( tilesize, tilesize, false, &tile->grid ) ) {
+		fputs( "Error allocating tile\n", stderr );
+		free( tile );
+		return NULL;
+	}
+	tile->tx = tx;
+	tile->ty = ty;
+	tile->level = level;
+	bool ok;
+	if( level == 0 )
+		ok = read_level( raster, 0, tx * step, ty * step, tilesize, tilesize, &tile->grid );
+	else {
+		height_grid_t window;
+		ok = height_grid_create( 2 * tilesize + 1, 2 * tilesize + 1, false, &window );
+		ok = ok && read_level_clamped( raster, level - 1, 2 * (int64_t)( tx * step ) - 1,
+				2 * (int64_t)( ty * step ) - 1, &window );
+		ok = ok && lod_downsample_bordered( &window, raster->filter, &tile->grid );
+		height_grid_destroy( &window );
+	}
+	if( !ok ) {
+		fprintf( stderr, "Error making tile %u/%u of level %u\n", tx, ty, level );
+		height_grid_destroy( &tile->grid );
+		free( tile );
+		return NULL;
+	}
+	return tile;
+}
+
+static void unlink_tile( virtual_raster_t *raster, raster_tile_t *tile ) {
+	if( tile->prev )
+		tile->prev->next = tile->next;
+	else
+		raster->first = tile->next;
+	if( tile->next )
+		tile->next->prev = tile->prev;
+	else
+		raster->last = tile->prev;
+	tile->prev = tile->next = NULL;
+}
+
+static void push_tile( virtual_raster_t *raster, raster_tile_t *tile ) {
+	tile->next = raster->first;
+	if( raster->first )
+		raster->first->prev = tile;
+	else
+		raster->last = tile;
+	raster->first = tile;
+}
+
+/* The cached tile, made if it is not there. A budget holds a few dozen tiles, which a walk
+ * through the list finds faster than it makes one. */
+static const height_grid_t *tile_grid( virtual_raster_t *raster, const uint32_t tx, const uint32_t ty,
+		const uint32_t level ) {
+	raster_tile_t *tile = raster->first;
+	while( tile && ( tile->tx != tx || tile->ty != ty || tile->level != level ) )
+		tile = tile->next;
+	if( tile ) {
+		++raster->hits;
+		unlink_tile( raster, tile );
+	} else {
+		++raster->misses;
+		if( !( tile = make_tile( raster, tx, ty, level ) ) )
+			return NULL;
+		raster->used += tile->grid.alloc_size;
+	}
+	push_tile( raster, tile );
+	// The tile asked for stays even if it alone is beyond the budget
+	while( raster->used > raster->budget && raster->last != tile ) {
+		raster_tile_t *const lru = raster->last;
+		unlink_tile( raster, lru );
+		raster->used -= lru->grid.alloc_size;
+		height_grid_destroy( &lru->grid );
+		free( lru );
+		++raster->evictions;
+	}
+	return &tile->grid;
+}
+
+bool virtual_raster_tile( virtual_raster_t *raster, const uint32_t tx, const uint32_t ty,
+		const uint32_t level, height_grid_t *tile ) {
+	uint32_t num_h_tiles, num_v_tiles;
+	virtual_raster_level_tiles( raster, level, &num_h_tiles, &num_v_tiles );
+	if( level >= raster->num_levels || tx >= num_h_tiles || ty >= num_v_tiles ) {
+		fprintf( stderr, "There is no tile %u/%u at level %u\n", tx, ty, level );
+		return false;
+	}
+	pthread_mutex_lock( &raster->mutex );
+	const height_grid_t *const grid = tile_grid( raster, tx, ty, level );
+	if( grid ) {
+		uint16_t min, max;
+		height_grid_copy_window( grid, 0, 0, tile, &min, &max );
+	}
+	pthread_mutex_unlock( &raster->mutex );
+	return grid != NULL;
+}
+
+// See virtual_raster_leaves_below, patches is a scratch grid of a tile
+static bool leaves_below( virtual_raster_t *raster, const uint32_t tx, const uint32_t ty, const uint32_t level,
+		const minmax_tree_t *const tree, height_grid_t *patches, uint16_t *leaf_min, uint16_t *leaf_max ) {
+	const size_t num_leaves = (size_t)tree->leaves * tree->leaves;
+	if( level == 0 ) {
+		for( size_t i = 0; i < num_leaves; ++i ) {
+			leaf_min[i] = 65535;
+			leaf_max[i] = 0;
+		}
+		return true;
+	}
+	uint32_t below_h, below_v;
+	virtual_raster_level_tiles( raster, level - 1, &below_h, &below_v );
+	// 4 children, then the patches of one of them
+	uint16_t *const memory = malloc( 10 * num_leaves * sizeof(uint16_t) );
+	if( !memory ) {
+		fputs( "Error allocating min/max quadtree leaves\n", stderr );
+		return false;
+	}
+	uint16_t *const patch_min = memory + 8 * num_leaves;
+	uint16_t *const patch_max = patch_min + num_leaves;
+	const uint16_t *child_min[4] = { NULL };
+	const uint16_t *child_max[4] = { NULL };
+	bool ok = true;
+	for( uint32_t i = 0; ok && i < 4; ++i ) {
+		const uint32_t child_v = 2 * ty + i / 2;
+		const uint32_t child_h = 2 * tx + i % 2;
+		if( child_v >= below_v || child_h >= below_h )
+			continue;
+		uint16_t *const lo = memory + 2 * i * num_leaves;
+		uint16_t *const hi = lo + num_leaves;
+		if( !( ok = leaves_below( raster, child_h, child_v, level - 1, tree, patches, lo, hi ) ) )
+			break;
+		// Valid until the next tile is asked for
+		const height_grid_t *const child = tile_grid( raster, child_h, child_v, level - 1 );
+		if( !( ok = child != NULL ) )
+			break;
+		uint16_t min, max;
+		height_grid_copy_window_patches( child, 0, 0, patches, tree->patch_size, patch_min, patch_max, &min, &max );
+		for( size_t j = 0; j < num_leaves; ++j ) {
+			lo[j] = lo[j] > patch_min[j] ? patch_min[j] : lo[j];
+			hi[j] = hi[j] < patch_max[j] ? patch_max[j] : hi[j];
+		}
+		child_min[i] = lo;
+		child_max[i] = hi;
+	}
+	if( ok )
+		minmax_tree_leaves_from_children( raster->header.tilesize, tree, child_min, child_max, leaf_min, leaf_max );
+	free( memory );
+	return ok;
+}
+
+bool virtual_raster_leaves_below( virtual_raster_t *raster, const uint32_t tx, const uint32_t ty,
+		const uint32_t level, const minmax_tree_t *const tree, uint16_t *leaf_min, uint16_t *leaf_max ) {
+	uint32_t num_h_tiles, num_v_tiles;
+	virtual_raster_level_tiles( raster, level, &num_h_tiles, &num_v_tiles );
+	if( level >= raster->num_levels || tx >= num_h_tiles || ty >= num_v_tiles ) {
+		fprintf( stderr, "There is no tile %u/%u at level %u\n", tx, ty, level );
+		return false;
+	}
+	height_grid_t patches;
+	if( !height_grid_create( raster->header.tilesize, raster->header.tilesize, false, &patches ) ) {
+		fputs( "Error allocating tile\n", stderr );
+		return false;
+	}
+	pthread_mutex_lock( &raster->mutex );
+	const bool ok = leaves_below( raster, tx, ty, level, tree, &patches, leaf_min, leaf_max );
+	pthread_mutex_unlock( &raster->mutex );
+	height_grid_destroy( &patches );
+	return ok;
+}
+
+void virtual_raster_close( virtual_raster_t *raster ) {
+	while( raster->first ) {
+		raster_tile_t *const tile = raster->first;
+		unlink_tile( raster, tile );
+		height_grid_destroy( &tile->grid );
+		free( tile );
+	}
+	mosaic_close( &raster->mosaic );
+	grid_cache_close( &raster->grid_cache );
+	pthread_mutex_destroy( &raster->mutex );
+	memset( raster, 0, sizeof(*raster) );
+}
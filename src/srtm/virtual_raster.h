@@ -0,0 +1,81 @@
+/* A raster whose tiles are made on demand. Opening it reads the headers of the inputs and
+ * indexes their rows; a tile of level 0 then parses only the rows it covers, a tile of a
+ * coarser level is filtered from the tiles of the level below it needs, see lod_pyramid.h.
+ * The results are the same as those of the whole raster converted at once. Made tiles are
+ * kept in a cache that drops the least recently used ones beyond a memory budget.
+ * With a grid cache of the input, see grid_cache.h, windows are copied from it instead. */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "asc_parser.h"
+#include "grid_cache.h"
+#include "height_grid.h"
+#include "lod_pyramid.h"
+#include "minmax_tree.h"
+#include "mosaic.h"
+#include "srtm_header.h"
+
+typedef struct raster_tile_t {
+	uint32_t tx;
+	uint32_t ty;
+	uint32_t level;
+	height_grid_t grid;
+	// cache order, most recently used first
+	struct raster_tile_t *prev;
+	struct raster_tile_t *next;
+} raster_tile_t;
+
+typedef struct virtual_raster_t {
+	// the inputs, unopened if the grid cache is mapped
+	mosaic_t mosaic;
+	grid_cache_t grid_cache;
+	// of the raster, with the tile size
+	srtm_header_t header;
+	lod_filter_t filter;
+	// tiles at level 0 and number of levels down to a single tile
+	uint32_t num_h_tiles;
+	uint32_t num_v_tiles;
+	uint32_t num_levels;
+	unsigned num_threads;
+	// cache
+	size_t budget;
+	size_t used;
+	raster_tile_t *first;
+	raster_tile_t *last;
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t evictions;
+	asc_parse_stats_t stats;
+	pthread_mutex_t mutex;
+} virtual_raster_t;
+
+/* Opens the ascii file at path, or the list of files at path with mosaic set, see mosaic.h.
+ * The inputs must be regular files. budget is the size of the cache in bytes, num_threads
+ * the number of threads that parse the rows of a tile. With use_grid_cache set a valid grid
+ * cache of the input is used instead of the inputs. */
+extern bool virtual_raster_open( const char *const path, const bool mosaic, const uint32_t tilesize,
+		const lod_filter_t filter, const size_t budget, const unsigned num_threads, const bool use_grid_cache,
+		virtual_raster_t *raster );
+
+// Tiles along each axis at level
+extern void virtual_raster_level_tiles( const virtual_raster_t *const raster, const uint32_t level,
+		uint32_t *num_h_tiles, uint32_t *num_v_tiles );
+
+/* Copies tile tx/ty of level into tile, a grid of tilesize x tilesize posts, making it and the
+ * tiles it is filtered from if they are not in the cache. Tiles count from the north west
+ * like those of the converter. Safe to call from several threads, tiles are made one at a time. */
+extern bool virtual_raster_tile( virtual_raster_t *raster, const uint32_t tx, const uint32_t ty,
+		const uint32_t level, height_grid_t *tile );
+
+/* Leaves of the min/max quadtree of tile tx/ty of level that the tiles below it pass up, as a run
+ * with --lod gathers them: those of its children, each the bounds of the child's posts and of what
+ * it got from below in turn, see minmax_tree_leaves_from_children. Empty at level 0. tree gives the
+ * size of the leaves. Makes the tiles below that are not in the cache. */
+extern bool virtual_raster_leaves_below( virtual_raster_t *raster, const uint32_t tx, const uint32_t ty,
+		const uint32_t level, const minmax_tree_t *const tree, uint16_t *leaf_min, uint16_t *leaf_max );
+
+extern void virtual_raster_close( virtual_raster_t *raster );
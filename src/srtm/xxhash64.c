@@ -0,0 +1,95 @@
+#include "xxhash64.h"
+#include "le_bytes.h"
+#include <string.h>
+
+#define PRIME1 0x9e3779b185ebca87ull
+#define PRIME2 0xc2b2ae3d27d4eb4full
+#define PRIME3 0x165667b19e3779f9ull
+#define PRIME4 0x85ebca77c2b2ae63ull
+#define PRIME5 0x27d4eb2f165667c5ull
+
+static inline uint64_t rotl64( const uint64_t x, const unsigned r ) {
+	return ( x << r ) | ( x >> ( 64 - r ) );
+}
+
+static inline uint64_t round64( uint64_t acc, const uint64_t input ) {
+	acc += input * PRIME2;
+	return rotl64( acc, 31 ) * PRIME1;
+}
+
+static inline uint64_t merge_round( uint64_t acc, const uint64_t value ) {
+	acc ^= round64( 0, value );
+	return acc * PRIME1 + PRIME4;
+}
+
+static inline void stripe( uint64_t acc[4], const unsigned char *p ) {
+	acc[0] = round64( acc[0], load_u64( p ) );
+	acc[1] = round64( acc[1], load_u64( p + 8 ) );
+	acc[2] = round64( acc[2], load_u64( p + 16 ) );
+	acc[3] = round64( acc[3], load_u64( p + 24 ) );
+}
+
+void xxh64_init( xxh64_state_t *state, const uint64_t seed ) {
+	memset( state, 0, sizeof(*state) );
+	state->seed = seed;
+	state->acc[0] = seed + PRIME1 + PRIME2;
+	state->acc[1] = seed + PRIME2;
+	state->acc[2] = seed;
+	state->acc[3] = seed - PRIME1;
+}
+
+void xxh64_update( xxh64_state_t *state, const void *const data, size_t size ) {
+	const unsigned char *p = data;
+	state->total += size;
+	if( state->buffered > 0 ) {
+		const size_t fill = 32 - state->buffered < size ? 32 - state->buffered : size;
+		memcpy( state->buffer + state->buffered, p, fill );
+		state->buffered += (uint32_t)fill;
+		p += fill;
+		size -= fill;
+		if( state->buffered < 32 )
+			return;
+		stripe( state->acc, state->buffer );
+		state->buffered = 0;
+	}
+	for( ; size >= 32; p += 32, size -= 32 )
+		stripe( state->acc, p );
+	memcpy( state->buffer, p, size );
+	state->buffered = (uint32_t)size;
+}
+
+uint64_t xxh64_digest( const xxh64_state_t *const state ) {
+	uint64_t h;
+	if( state->total >= 32 ) {
+		const uint64_t *const acc = state->acc;
+		h = rotl64( acc[0], 1 ) + rotl64( acc[1], 7 ) + rotl64( acc[2], 12 ) + rotl64( acc[3], 18 );
+		for( unsigned i = 0; i < 4; ++i )
+			h = merge_round( h, acc[i] );
+	} else
+		h = state->seed + PRIME5;
+	h += state->total;
+	const unsigned char *p = state->buffer;
+	uint32_t n = state->buffered;
+	for( ; n >= 8; p += 8, n -= 8 )
+		h = rotl64( h ^ round64( 0, load_u64( p ) ), 27 ) * PRIME1 + PRIME4;
+	if( n >= 4 ) {
+		h = rotl64( h ^ (uint64_t)load_u32( p ) * PRIME1, 23 ) * PRIME2 + PRIME3;
+		p += 4;
+		n -= 4;
+	}
+	for( ; n > 0; ++p, --n )
+		h = rotl64( h ^ *p * PRIME5, 11 ) * PRIME1;
+	h ^= h >> 33;
+	h *= PRIME2;
+	h ^= h >> 29;
+	h *= PRIME3;
+	h ^= h >> 32;
+	return h;
+}
+
+uint64_t xxh64( const void *const data, const size_t size, const uint64_t seed ) {
+	xxh64_state_t state;
+	xxh64_init( &state, seed );
+	xxh64_update( &state, data, size );
+	return xxh64_digest( &state );
+}
@@ -0,0 +1,24 @@
+/* xxHash64 by Yann Collet, written from its specification: a fast 64 bit non cryptographic
+ * hash for content checks. The state takes the data in pieces, e.g. the rows of a grid. */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct xxh64_state_t {
+	uint64_t acc[4];
+	uint64_t seed;
+	uint64_t total;
+	// bytes short of a 32 byte stripe
+	unsigned char buffer[32];
+	uint32_t buffered;
+} xxh64_state_t;
+
+extern void xxh64_init( xxh64_state_t *state, const uint64_t seed );
+
+extern void xxh64_update( xxh64_state_t *state, const void *const data, size_t size );
+
+extern uint64_t xxh64_digest( const xxh64_state_t *const state );
+
+extern uint64_t xxh64( const void *const data, const size_t size, const uint64_t seed );
@@ -0,0 +1,1037 @@
+/* Benchmarks for the converter's stages on a synthetic ascii grid. The grid is fractal terrain
+ * with sea below 0 and no data voids and runs, made from a seed, so runs with the same options
+ * get the same input. Each stage runs once to warm up and check its results, then the given
+ * number of times; the median and the median absolute deviation (MAD) of those are reported.
+ * Options:
+ * - --columns N, --rows N: size of the grid, default 6000 x 3000 posts
+ * - --repetitions N: timed runs per stage, default 7
+ * - --threads N: threads for the parallel parser, default is the number of cpus
+ * - --tilesize N: size of the tiles that are cut and encoded, default 512
+ * - --png fastest|balanced|smallest: png compression profile, default is balanced
+ * - --seed N: seed of the terrain, default 42
+ * - --write FILE: also save the grid as ascii file, e.g. to run the converter on it */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+#include "omath/ellipsoid.h"
+#include "omath/ellipsoid_batch.h"
+#include "srtm/asc_parallel.h"
+#include "srtm/asc_parser.h"
+#include "srtm/byte_buffer.h"
+#include "srtm/ecef_bounds.h"
+#include "srtm/height_clamp.h"
+#include "srtm/height_grid.h"
+#include "srtm/le_bytes.h"
+#include "srtm/minmax_tree.h"
+#include "srtm/normal_map.h"
+#include "srtm/srtm_header.h"
+#include "srtm/tile_format.h"
+#include "srtm/tile_mesh.h"
+#include "srtm/tile_pack.h"
+#include "srtm/tile_png.h"
+#include "srtm/tile_raw.h"
+#include "srtm/timer.h"
+#include "srtm/virtual_raster.h"
+
+#define NO_DATA -9999
+// Octaves of the terrain noise and the size of the largest features in posts
+#define TERRAIN_OCTAVES 8
+#define TERRAIN_SCALE 1024.0
+// Calls of the header parser per timed run, one takes microseconds
+#define HEADER_BATCH 1000
+
+typedef struct bench_t {
+	// The ascii file and what parsing it must give
+	char *text;
+	size_t size;
+	srtm_header_t header;
+	const char *body;
+	height_grid_t expected;
+	asc_parse_stats_t expected_stats;
+	// The values of the file as numbers, row by row, and as 16 bit values like binary srtm tiles
+	int32_t *raw;
+	int16_t *raw16;
+	// Parsed posts, tiles cut from them
+	height_grid_t grid;
+	uint32_t num_tiles;
+	height_grid_t *tiles;
+	minmax_tree_t tree;
+	byte_buffer_t encoded;
+	uint64_t encoded_bytes;
+	// A tile with one post of its neighbours around it, and its normal map
+	height_grid_t halo;
+	byte_buffer_t normals;
+	// Positions of the posts of the first tile
+	geodetic_t *geodetic;
+	vec3d *cartesian;
+	geodetic_t *converted;
+	// The same as one grid, positions as arrays of x, y and z
+	geodetic_grid_t geodetic_grid;
+	vec3d_soa_t grid_cartesian;
+	geodetic_soa_t grid_geodetic;
+	size_t num_fallbacks;
+	// The table of the grid's columns and the bounding volumes of the first tile
+	ellipsoid_columns_t columns;
+	ecef_bounds_t bounds;
+	// Its vertices relative to the center of the oriented box
+	byte_buffer_t mesh;
+	ellipsoid_t ellipsoid;
+	unsigned num_threads;
+	const png_profile_t *png_profile;
+} bench_t;
+
+static inline uint32_t hash2( const int32_t x, const int32_t y, const uint32_t seed ) {
+	uint32_t h = (uint32_t)x * 0x8da6b343u ^ (uint32_t)y * 0xd8163841u ^ seed * 0xcb1ab31fu;
+	h ^= h >> 13;
+	h *= 0x85ebca6bu;
+	h ^= h >> 16;
+	return h;
+}
+
+// Value noise in [-1, 1], smoothly interpolated between random values on integer positions
+static double value_noise( const double x, const double y, const uint32_t seed ) {
+	const double fx = floor( x );
+	const double fy = floor( y );
+	const int32_t ix = (int32_t)fx;
+	const int32_t iy = (int32_t)fy;
+	const double tx = ( x - fx ) * ( x - fx ) * ( 3.0 - 2.0 * ( x - fx ) );
+	const double ty = ( y - fy ) * ( y - fy ) * ( 3.0 - 2.0 * ( y - fy ) );
+	const double scale = 2.0 / 4294967295.0;
+	const double v00 = hash2( ix, iy, seed ) * scale - 1.0;
+	const double v10 = hash2( ix + 1, iy, seed ) * scale - 1.0;
+	const double v01 = hash2( ix, iy + 1, seed ) * scale - 1.0;
+	const double v11 = hash2( ix + 1, iy + 1, seed ) * scale - 1.0;
+	const double top = v00 + ( v10 - v00 ) * tx;
+	const double bottom = v01 + ( v11 - v01 ) * tx;
+	return top + ( bottom - top ) * ty;
+}
+
+// Fractal sum of octaves of value noise, about in [-1, 1]
+static double fractal_noise( const double x, const double y, const uint32_t seed ) {
+	double sum = 0.0;
+	double amplitude = 0.5;
+	double frequency = 1.0;
+	for( unsigned i = 0; i < TERRAIN_OCTAVES; ++i ) {
+		sum += amplitude * value_noise( x * frequency, y * frequency, seed + i );
+		amplitude *= 0.5;
+		frequency *= 2.0;
+	}
+	return sum * 2.0;
+}
+
+static char *put_int( char *p, int value ) {
+	char digits[12];
+	unsigned n = 0;
+	if( value < 0 ) {
+		*p++ = '-';
+		value = -value;
+	}
+	do {
+		digits[n++] = (char)( '0' + value % 10 );
+		value /= 10;
+	} while( value > 0 );
+	while( n > 0 )
+		*p++ = digits[--n];
+	return p;
+}
+
+/* The ascii file: mountains up to some 3000 m, sea down to -500 m, no data where a second
+ * noise is high on high ground, like glaciers, and in runs of up to 256 posts in every eighth row. */
+static bool generate( const uint32_t columns, const uint32_t rows, const uint32_t seed, bench_t *bench ) {
+	const size_t capacity = 256 + (size_t)columns * rows * 7;
+	bench->text = malloc( capacity );
+	bench->raw = malloc( (size_t)columns * rows * sizeof(int32_t) );
+	bench->raw16 = malloc( (size_t)columns * rows * sizeof(int16_t) );
+	if( !bench->text || !bench->raw || !bench->raw16 || !height_grid_create( columns, rows, false, &bench->expected ) ) {
+		fputs( "Error allocating synthetic grid\n", stderr );
+		return false;
+	}
+	asc_parse_stats_t *const stats = &bench->expected_stats;
+	asc_parse_stats_init( stats );
+	char *p = bench->text;
+	p += sprintf( p, "ncols %u\nnrows %u\nxllcorner 8.0\nyllcorner 45.0\ncellsize 0.000833333333\nNODATA_value %d\n",
+			columns, rows, NO_DATA );
+	const size_t header_size = (size_t)( p - bench->text );
+	for( uint32_t r = 0; r < rows; ++r ) {
+		uint16_t *const expected = height_grid_row( &bench->expected, r );
+		// A run of no data in this row, if any
+		const uint32_t run_hash = hash2( (int32_t)r, 0x5eed, seed );
+		const uint32_t run_start = run_hash % 8 == 0 ? ( run_hash >> 3 ) % columns : columns;
+		const uint32_t run_end = run_start + 1 + ( run_hash >> 24 );
+		for( uint32_t c = 0; c < columns; ++c ) {
+			const double terrain = fractal_noise( c / TERRAIN_SCALE, r / TERRAIN_SCALE, seed );
+			int value = (int)( terrain * 2500.0 + 600.0 );
+			value = value < -500 ? -500 : value;
+			if( ( c >= run_start && c < run_end ) ||
+				( value > 1500 && value_noise( c / 64.0, r / 64.0, seed ^ 0xffffu ) > 0.6 ) )
+				value = NO_DATA;
+			stats->min_value = value < stats->min_value ? value : stats->min_value;
+			stats->max_value = value > stats->max_value ? value : stats->max_value;
+			stats->no_data_count += value == NO_DATA;
+			stats->negative_count += value < 0 && value != NO_DATA;
+			expected[c] = value < 0 ? 0 : (uint16_t)value;
+			bench->raw[(size_t)r * columns + c] = value;
+			bench->raw16[(size_t)r * columns + c] = (int16_t)value;
+			p = put_int( p, value );
+			*p++ = c + 1 < columns ? ' ' : '\n';
+		}
+	}
+	stats->value_count = (uint64_t)columns * rows;
+	bench->size = (size_t)( p - bench->text );
+	printf( "Synthetic grid: %u x %u posts, seed %u, %.1f MB of ascii, %zu bytes of header, "
+			"%.1f%% no data, %.1f%% negative\n", columns, rows, seed, (double)bench->size * 1e-6, header_size,
+			100.0 * (double)stats->no_data_count / (double)stats->value_count,
+			100.0 * (double)stats->negative_count / (double)stats->value_count );
+	return true;
+}
+
+static int compare_doubles( const void *a, const void *b ) {
+	const double x = *(const double *)a;
+	const double y = *(const double *)b;
+	return x < y ? -1 : x > y;
+}
+
+// Sorts the samples
+static double median( double *samples, const unsigned count ) {
+	qsort( samples, count, sizeof(double), compare_doubles );
+	return count % 2 ? samples[count / 2] : 0.5 * ( samples[count / 2 - 1] + samples[count / 2] );
+}
+
+// Sends stdout to /dev/null, returns the descriptor to restore it with or -1
+static int mute_stdout( void ) {
+	fflush( stdout );
+	const int saved = dup( STDOUT_FILENO );
+	const int null = open( "/dev/null", O_WRONLY );
+	if( saved < 0 || null < 0 ) {
+		if( saved >= 0 )
+			close( saved );
+		if( null >= 0 )
+			close( null );
+		return -1;
+	}
+	dup2( null, STDOUT_FILENO );
+	close( null );
+	return saved;
+}
+
+static void unmute_stdout( const int saved ) {
+	fflush( stdout );
+	if( saved >= 0 ) {
+		dup2( saved, STDOUT_FILENO );
+		close( saved );
+	}
+}
+
+/* Runs stage once to warm up, then repetitions times, and prints the median and MAD of the time
+ * per call, with batch calls per run, and the throughput at the median; bytes and values are
+ * those of one call, 0 if it has none. With mute set what the stage prints is dropped, it would
+ * be timed with the terminal. */
+static bool run_stage( const char *const name, bool (*stage)( bench_t * ), bench_t *bench,
+		const unsigned repetitions, const unsigned batch, const bool mute, const double bytes, const double values ) {
+	double samples[repetitions];
+	double deviations[repetitions];
+	const int saved = mute ? mute_stdout() : -1;
+	const bool ok = stage( bench );
+	for( unsigned r = 0; ok && r < repetitions; ++r ) {
+		struct timespec start;
+		clock_gettime( CLOCK_MONOTONIC, &start );
+		for( unsigned i = 0; i < batch; ++i )
+			stage( bench );
+		samples[r] = seconds_since( &start ) / batch;
+	}
+	unmute_stdout( saved );
+	if( !ok ) {
+		fprintf( stderr, "%s failed or gave wrong results\n", name );
+		return false;
+	}
+	const double mid = median( samples, repetitions );
+	for( unsigned r = 0; r < repetitions; ++r )
+		deviations[r] = fabs( samples[r] - mid );
+	const double mad = median( deviations, repetitions );
+	// samples are sorted now
+	printf( "%-20s median %10.3f ms  MAD %8.3f ms (%4.1f%%)  min %10.3f ms", name, mid * 1e3, mad * 1e3,
+			mid > 0.0 ? 100.0 * mad / mid : 0.0, samples[0] * 1e3 );
+	if( bytes > 0.0 )
+		printf( "  %8.1f MB/s", bytes * 1e-6 / mid );
+	if( values > 0.0 )
+		printf( "  %8.1f Mvalues/s", values * 1e-6 / mid );
+	putchar( '\n' );
+	return true;
+}
+
+static bool grid_equals( const height_grid_t *const a, const height_grid_t *const b ) {
+	for( uint32_t r = 0; r < a->height; ++r )
+		if( memcmp( height_grid_row( a, r ), height_grid_row( b, r ), a->width * sizeof(uint16_t) ) != 0 )
+			return false;
+	return true;
+}
+
+static bool stats_equal( const asc_parse_stats_t *const a, const asc_parse_stats_t *const b ) {
+	return a->min_value == b->min_value && a->max_value == b->max_value && a->value_count == b->value_count &&
+			a->no_data_count == b->no_data_count && a->negative_count == b->negative_count;
+}
+
+static bool stage_header( bench_t *bench ) {
+	const char *cursor = bench->text;
+	const bool ok = read_srtm_ascii_header( &cursor, bench->text + bench->size, &bench->header );
+	bench->body = cursor;
+	return ok;
+}
+
+// Row by row, as the converter reads streamed input
+static bool stage_parse_sequential( bench_t *bench ) {
+	asc_parse_stats_t stats;
+	asc_parse_stats_init( &stats );
+	const char *pos = bench->body;
+	const char *const end = bench->text + bench->size;
+	for( uint32_t r = 0; r < bench->header.num_rows; ++r ) {
+		size_t parsed;
+		pos = asc_parse_values( pos, end, true, bench->header.no_data, height_grid_row( &bench->grid, r ),
+				bench->header.num_columns, &parsed, &stats );
+		if( !pos || parsed != bench->header.num_columns )
+			return false;
+	}
+	return stats_equal( &stats, &bench->expected_stats ) && grid_equals( &bench->grid, &bench->expected );
+}
+
+// As the converter reads mapped input
+static bool stage_parse_parallel( bench_t *bench ) {
+	asc_parse_stats_t stats;
+	asc_parse_stats_init( &stats );
+	return asc_parse_rows_parallel( bench->body, bench->text + bench->size, bench->header.num_rows,
+			bench->header.num_columns, bench->header.no_data, bench->grid.data, bench->grid.stride,
+			bench->num_threads, &stats ) &&
+			stats_equal( &stats, &bench->expected_stats ) && grid_equals( &bench->grid, &bench->expected );
+}
+
+// Reference: what the converter did before the vectorized parser, one strtol per value
+static bool stage_parse_strtol( bench_t *bench ) {
+	char *p = (char *)bench->body;
+	for( uint32_t r = 0; r < bench->header.num_rows; ++r ) {
+		uint16_t *const posts = height_grid_row( &bench->grid, r );
+		for( uint32_t c = 0; c < bench->header.num_columns; ++c ) {
+			const long value = strtol( p, &p, 10 );
+			posts[c] = value < 0 || value == bench->header.no_data ? 0 : (uint16_t)value;
+		}
+	}
+	return grid_equals( &bench->grid, &bench->expected );
+}
+
+// Only turning the numbers into posts, which the parsers do along the way
+static bool stage_clamp( bench_t *bench ) {
+	asc_parse_stats_t stats;
+	asc_parse_stats_init( &stats );
+	const uint32_t columns = bench->header.num_columns;
+	for( uint32_t r = 0; r < bench->header.num_rows; ++r )
+		height_clamp_i32( bench->raw + (size_t)r * columns, columns, bench->header.no_data,
+				height_grid_row( &bench->grid, r ), &stats );
+	stats.value_count = (uint64_t)columns * bench->header.num_rows;
+	return stats_equal( &stats, &bench->expected_stats ) && grid_equals( &bench->grid, &bench->expected );
+}
+
+// The same from 16 bit values
+static bool stage_clamp_i16( bench_t *bench ) {
+	asc_parse_stats_t stats;
+	asc_parse_stats_init( &stats );
+	const uint32_t columns = bench->header.num_columns;
+	for( uint32_t r = 0; r < bench->header.num_rows; ++r )
+		height_clamp_i16( bench->raw16 + (size_t)r * columns, columns, bench->header.no_data,
+				height_grid_row( &bench->grid, r ), &stats );
+	stats.value_count = (uint64_t)columns * bench->header.num_rows;
+	return stats_equal( &stats, &bench->expected_stats ) && grid_equals( &bench->grid, &bench->expected );
+}
+
+// Cuts every tile with its quadtree leaves, as the tile workers do
+static bool stage_tiling( bench_t *bench ) {
+	const uint32_t step = bench->header.tilesize - 1;
+	const uint32_t num_h_tiles = bench->header.num_columns / bench->header.tilesize;
+	minmax_tree_t *const tree = &bench->tree;
+	for( uint32_t i = 0; i < bench->num_tiles; ++i ) {
+		uint16_t min, max;
+		height_grid_copy_window_patches( &bench->expected, i % num_h_tiles * step, i / num_h_tiles * step,
+				&bench->tiles[i], tree->patch_size, minmax_tree_leaf_min( tree ), minmax_tree_leaf_max( tree ),
+				&min, &max );
+		minmax_tree_build( tree );
+		if( tree->min[0] != min || tree->max[0] != max )
+			return false;
+	}
+	return true;
+}
+
+static bool stage_png_encode( bench_t *bench ) {
+	bench->encoded_bytes = 0;
+	for( uint32_t i = 0; i < bench->num_tiles; ++i ) {
+		if( !tile_png_encode( &bench->tiles[i], bench->png_profile, &bench->encoded ) )
+			return false;
+		bench->encoded_bytes += bench->encoded.size;
+	}
+	return true;
+}
+
+// The normal map of every tile, the posts around it copied from the neighbours as the converter does
+static bool stage_normal_maps( bench_t *bench ) {
+	const uint32_t step = bench->header.tilesize - 1;
+	const uint32_t num_h_tiles = bench->header.num_columns / bench->header.tilesize;
+	const uint32_t num_v_tiles = bench->num_tiles / num_h_tiles;
+	for( uint32_t i = 0; i < bench->num_tiles; ++i ) {
+		normal_map_header_t header = {
+				.longitude = bench->header.longitude + i % num_h_tiles * step * bench->header.cellsize,
+				.latitude = bench->header.latitude +
+						( bench->header.num_rows - 1.0 - ( i / num_h_tiles + 1 ) * step ) * bench->header.cellsize,
+				.cellsize = bench->header.cellsize
+		};
+		height_grid_copy_clamped( &bench->expected, (int64_t)( i % num_h_tiles * step ) - 1,
+				(int64_t)( i / num_h_tiles * step ) - 1, num_h_tiles * step + 1, num_v_tiles * step + 1, &bench->halo );
+		if( !normal_map_encode( &bench->halo, &bench->ellipsoid, &header, &bench->normals ) )
+			return false;
+	}
+	return true;
+}
+
+/* Largest angle in degrees between the normals of the last tile's map and Sobel in double precision,
+ * with the spacing of the posts measured between their cartesian positions */
+static double normal_map_error( const bench_t *const bench ) {
+	const height_grid_t *const h = &bench->halo;
+	const unsigned char *const data = bench->normals.data;
+	const uint32_t width = load_u32( data + 16 );
+	const uint32_t stride = load_u32( data + 24 );
+	const double longitude = load_f64( data + 40 );
+	const double latitude = load_f64( data + 48 );
+	const double cellsize = bench->header.cellsize;
+	double max_angle = 0.0;
+	for( uint32_t r = 0; r < h->height - 2; ++r ) {
+		const double lat = latitude + ( h->height - 3.0 - r ) * cellsize;
+		vec3d west, east, north, south;
+		ellipsoid_to_cartesian( &(geodetic_t){ longitude - cellsize, lat, 0.0 }, &bench->ellipsoid, &west );
+		ellipsoid_to_cartesian( &(geodetic_t){ longitude + cellsize, lat, 0.0 }, &bench->ellipsoid, &east );
+		ellipsoid_to_cartesian( &(geodetic_t){ longitude, lat + cellsize, 0.0 }, &bench->ellipsoid, &north );
+		ellipsoid_to_cartesian( &(geodetic_t){ longitude, lat - cellsize, 0.0 }, &bench->ellipsoid, &south );
+		const double dx = 0.5 * sqrt( ( east.x - west.x ) * ( east.x - west.x ) + ( east.y - west.y ) * ( east.y - west.y ) +
+				( east.z - west.z ) * ( east.z - west.z ) );
+		const double dy = 0.5 * sqrt( ( north.x - south.x ) * ( north.x - south.x ) +
+				( north.y - south.y ) * ( north.y - south.y ) + ( north.z - south.z ) * ( north.z - south.z ) );
+		const uint16_t *const n = height_grid_row( h, r ) + 1;
+		const uint16_t *const p = height_grid_row( h, r + 1 ) + 1;
+		const uint16_t *const s = height_grid_row( h, r + 2 ) + 1;
+		for( int c = 0; c < (int)width; ++c ) {
+			const double gx = ( n[c+1] + 2.0 * p[c+1] + s[c+1] ) - ( n[c-1] + 2.0 * p[c-1] + s[c-1] );
+			const double gy = ( n[c-1] + 2.0 * n[c] + n[c+1] ) - ( s[c-1] + 2.0 * s[c] + s[c+1] );
+			const double x = -gx / ( 8.0 * dx );
+			const double y = -gy / ( 8.0 * dy );
+			const unsigned char *const q = data + NORMAL_MAP_HEADER_SIZE + 4 * ( (size_t)r * stride + c );
+			const uint16_t encoded[2] = { load_u16( q ), load_u16( q + 2 ) };
+			float decoded[3];
+			normal_map_decode( encoded, decoded );
+			// atan2 of the cross and dot products, acos loses the small angles
+			const vec3d cross = {
+					y * decoded[2] - decoded[1], decoded[0] - x * decoded[2], x * decoded[1] - y * decoded[0]
+			};
+			const double dot = x * decoded[0] + y * decoded[1] + decoded[2];
+			max_angle = fmax( max_angle, degreesd( atan2( sqrt( cross.x * cross.x + cross.y * cross.y +
+					cross.z * cross.z ), dot ) ) );
+		}
+	}
+	return max_angle;
+}
+
+// Every post of the first tile with its height
+static bool stage_to_cartesian( bench_t *bench ) {
+	const size_t count = (size_t)bench->header.tilesize * bench->header.tilesize;
+	for( size_t i = 0; i < count; ++i )
+		ellipsoid_to_cartesian( &bench->geodetic[i], &bench->ellipsoid, &bench->cartesian[i] );
+	return true;
+}
+
+static bool stage_grid_to_cartesian( bench_t *bench ) {
+	return ellipsoid_grid_to_cartesian( &bench->geodetic_grid, bench->expected.data, bench->expected.stride,
+			&bench->ellipsoid, &bench->grid_cartesian );
+}
+
+// Largest distance in metres between the batched and the single point positions
+static double grid_cartesian_error( const bench_t *const bench ) {
+	const size_t count = (size_t)bench->header.tilesize * bench->header.tilesize;
+	double max_error = 0.0;
+	for( size_t i = 0; i < count; ++i ) {
+		const vec3d d = { bench->grid_cartesian.x[i] - bench->cartesian[i].x,
+				bench->grid_cartesian.y[i] - bench->cartesian[i].y, bench->grid_cartesian.z[i] - bench->cartesian[i].z };
+		const double error = sqrt( d.x * d.x + d.y * d.y + d.z * d.z );
+		max_error = error > max_error ? error : max_error;
+	}
+	return max_error;
+}
+
+// Bounding volumes of the first tile, with the table of its columns as the converter builds them
+static bool stage_bounds( bench_t *bench ) {
+	height_grid_t tile;
+	height_grid_view( &bench->expected, 0, 0, bench->header.tilesize, bench->header.tilesize, &tile );
+	ellipsoid_columns_fill( &bench->geodetic_grid, &bench->ellipsoid, &bench->columns );
+	return ecef_bounds_compute( &tile, &bench->geodetic_grid, &bench->columns, &bench->ellipsoid, &bench->bounds );
+}
+
+/* Largest distances in metres of the single point positions of the first tile outside the aabb, the
+ * sphere and the oriented box; all of them must be inside */
+static void print_bounds_error( const bench_t *const bench ) {
+	const ecef_bounds_t *const b = &bench->bounds;
+	const size_t count = (size_t)bench->header.tilesize * bench->header.tilesize;
+	double aabb = 0.0;
+	double sphere = 0.0;
+	double box = 0.0;
+	for( size_t i = 0; i < count; ++i ) {
+		const vec3d *const p = &bench->cartesian[i];
+		aabb = fmax( aabb, fmax( fmax( b->min.x - p->x, p->x - b->max.x ), fmax( b->min.y - p->y, p->y - b->max.y ) ) );
+		aabb = fmax( aabb, fmax( b->min.z - p->z, p->z - b->max.z ) );
+		const vec3d d = { p->x - b->center.x, p->y - b->center.y, p->z - b->center.z };
+		sphere = fmax( sphere, sqrt( d.x * d.x + d.y * d.y + d.z * d.z ) - b->radius );
+		const vec3d o = { p->x - b->box_center.x, p->y - b->box_center.y, p->z - b->box_center.z };
+		const double half_extents[3] = { b->half_extents.x, b->half_extents.y, b->half_extents.z };
+		for( unsigned k = 0; k < 3; ++k )
+			box = fmax( box, fabs( o.x * b->axes[k].x + o.y * b->axes[k].y + o.z * b->axes[k].z ) - half_extents[k] );
+	}
+	printf( "%-20s max. %.3g m outside the aabb, %.3g m the sphere, %.3g m the oriented box\n", "",
+			aabb, sphere, box );
+}
+
+// Vertices of the first tile with normals and texture coordinates, the posts around it as the converter copies them
+static bool stage_mesh( bench_t *bench ) {
+	const uint32_t tilesize = bench->header.tilesize;
+	const geodetic_grid_t *const g = &bench->geodetic_grid;
+	const geodetic_grid_t wide = { g->lon - g->lon_step, g->lat, g->lon_step, g->lat_step, tilesize + 2, tilesize };
+	ellipsoid_columns_fill( &wide, &bench->ellipsoid, &bench->columns );
+	height_grid_copy_clamped( &bench->expected, -1, -1, bench->header.num_columns, bench->header.num_rows, &bench->halo );
+	return tile_mesh_encode( &bench->halo, g, &bench->columns, &bench->ellipsoid, &bench->bounds.box_center,
+			TILE_MESH_NORMALS | TILE_MESH_TEX_COORDS, &bench->mesh );
+}
+
+static inline float load_float( const unsigned char *const p ) {
+	const uint32_t v = load_u32( p );
+	float f;
+	memcpy( &f, &v, sizeof(f) );
+	return f;
+}
+
+/* Largest distance in metres of the vertices plus the center from the single point positions of
+ * the first tile, and largest angle in degrees of their normals from central differences of single
+ * point positions of the posts around them */
+static void print_mesh_error( const bench_t *const bench ) {
+	const unsigned char *const data = bench->mesh.data;
+	const uint32_t width = load_u32( data + 16 );
+	const uint32_t height = load_u32( data + 20 );
+	const uint32_t vertex_size = load_u32( data + 28 );
+	const vec3d center = { load_f64( data + 32 ), load_f64( data + 40 ), load_f64( data + 48 ) };
+	const geodetic_grid_t *const g = &bench->geodetic_grid;
+	const height_grid_t *const h = &bench->halo;
+	double position = 0.0;
+	double angle = 0.0;
+	for( uint32_t r = 0; r < height; ++r ) {
+		for( uint32_t c = 0; c < width; ++c ) {
+			const unsigned char *const v = data + TILE_MESH_HEADER_SIZE + ( (size_t)r * width + c ) * vertex_size;
+			const vec3d *const p = &bench->cartesian[(size_t)r * width + c];
+			const vec3d d = {
+					load_float( v ) + center.x - p->x, load_float( v + 4 ) + center.y - p->y,
+					load_float( v + 8 ) + center.z - p->z
+			};
+			position = fmax( position, sqrt( d.x * d.x + d.y * d.y + d.z * d.z ) );
+			// Row r + 1, column c + 1 of the posts around the tile
+			const double lon = g->lon + c * g->lon_step;
+			const double lat = g->lat + r * g->lat_step;
+			vec3d west, east, north, south;
+			ellipsoid_to_cartesian( &(geodetic_t){ lon - g->lon_step, lat, height_grid_row( h, r + 1 )[c] },
+					&bench->ellipsoid, &west );
+			ellipsoid_to_cartesian( &(geodetic_t){ lon + g->lon_step, lat, height_grid_row( h, r + 1 )[c + 2] },
+					&bench->ellipsoid, &east );
+			ellipsoid_to_cartesian( &(geodetic_t){ lon, lat - g->lat_step, height_grid_row( h, r )[c + 1] },
+					&bench->ellipsoid, &north );
+			ellipsoid_to_cartesian( &(geodetic_t){ lon, lat + g->lat_step, height_grid_row( h, r + 2 )[c + 1] },
+					&bench->ellipsoid, &south );
+			const vec3d de = { east.x - west.x, east.y - west.y, east.z - west.z };
+			const vec3d dn = { north.x - south.x, north.y - south.y, north.z - south.z };
+			const vec3d n = { de.y * dn.z - de.z * dn.y, de.z * dn.x - de.x * dn.z, de.x * dn.y - de.y * dn.x };
+			const vec3d m = { load_float( v + 12 ), load_float( v + 16 ), load_float( v + 20 ) };
+			// atan2 of the cross and dot products, acos loses the small angles
+			const vec3d cross = { n.y * m.z - n.z * m.y, n.z * m.x - n.x * m.z, n.x * m.y - n.y * m.x };
+			angle = fmax( angle, degreesd( atan2( sqrt( cross.x * cross.x + cross.y * cross.y + cross.z * cross.z ),
+					n.x * m.x + n.y * m.y + n.z * m.z ) ) );
+		}
+	}
+	printf( "%-20s max. %.3g m from to cartesian, %.3g deg from normals in double precision\n", "", position, angle );
+}
+
+static bool stage_to_geodetic( bench_t *bench ) {
+	const size_t count = (size_t)bench->header.tilesize * bench->header.tilesize;
+	for( size_t i = 0; i < count; ++i )
+		ToGeodetic3D( &bench->cartesian[i], &bench->ellipsoid, &bench->converted[i] );
+	return true;
+}
+
+static bool stage_batch_to_geodetic( bench_t *bench ) {
+	const size_t count = (size_t)bench->header.tilesize * bench->header.tilesize;
+	bench->num_fallbacks = ellipsoid_cartesian_to_geodetic( &bench->grid_cartesian, count, &bench->ellipsoid,
+			&bench->grid_geodetic );
+	return true;
+}
+
+/* Largest differences of the batched conversion from the iterative one, in degrees and metres,
+ * and of its heights from the posts they were made from */
+static void print_geodetic_error( const bench_t *const bench ) {
+	const size_t count = (size_t)bench->header.tilesize * bench->header.tilesize;
+	double angle = 0.0;
+	double height = 0.0;
+	double round_trip = 0.0;
+	for( size_t i = 0; i < count; ++i ) {
+		const geodetic_t *const g = &bench->converted[i];
+		angle = fmax( angle, fmax( fabs( bench->grid_geodetic.lon[i] - g->lon ), fabs( bench->grid_geodetic.lat[i] - g->lat ) ) );
+		height = fmax( height, fabs( bench->grid_geodetic.height[i] - g->height ) );
+		round_trip = fmax( round_trip, fabs( bench->grid_geodetic.height[i] - bench->geodetic[i].height ) );
+	}
+	printf( "%-20s max. %.3g deg, %.3g m from to geodetic, %.3g m from the posts, %zu fallbacks\n", "",
+			angle, height, round_trip, bench->num_fallbacks );
+}
+
+// Adds the patches of the window at col/row of grid to the leaves of tree, dst gets the window
+static void add_patches( const height_grid_t *const grid, const uint32_t col, const uint32_t row, height_grid_t *dst,
+		minmax_tree_t *tree, uint16_t *patch_min, uint16_t *patch_max ) {
+	uint16_t *const leaf_min = minmax_tree_leaf_min( tree );
+	uint16_t *const leaf_max = minmax_tree_leaf_max( tree );
+	uint16_t min, max;
+	height_grid_copy_window_patches( grid, col, row, dst, tree->patch_size, patch_min, patch_max, &min, &max );
+	for( size_t i = 0; i < (size_t)tree->leaves * tree->leaves; ++i ) {
+		leaf_min[i] = leaf_min[i] > patch_min[i] ? patch_min[i] : leaf_min[i];
+		leaf_max[i] = leaf_max[i] < patch_max[i] ? patch_max[i] : leaf_max[i];
+	}
+}
+
+/* Makes every tile of every level with box filter as --tile does, from a virtual raster on the grid
+ * saved to a temporary file, and counts those whose posts or encoded quadtree differ from the
+ * pyramid as --lod builds it, level by level from the whole grid. -1 on errors. */
+static long requested_tiles_mismatch( bench_t *bench, uint32_t *num_tiles ) {
+	char path[] = "/tmp/srtm_bench_XXXXXX";
+	const int fd = mkstemp( path );
+	FILE *file = fd >= 0 ? fdopen( fd, "wb" ) : NULL;
+	bool ok = file && fwrite( bench->text, bench->size, 1, file ) == 1;
+	if( file )
+		ok = fclose( file ) == 0 && ok;
+	else if( fd >= 0 )
+		close( fd );
+	const uint32_t tilesize = bench->header.tilesize;
+	const uint32_t step = tilesize - 1;
+	minmax_tree_t *const tree = &bench->tree;
+	const size_t num_leaves = (size_t)tree->leaves * tree->leaves;
+	virtual_raster_t raster;
+	ok = ok && virtual_raster_open( path, false, tilesize, LOD_FILTER_BOX, (size_t)256 << 20, bench->num_threads,
+			false, &raster );
+	const bool opened = ok;
+	height_grid_t grids[2] = { { 0 } };
+	height_grid_t tile = { 0 }, reference = { 0 }, scratch = { 0 };
+	byte_buffer_t encoded;
+	byte_buffer_init( &encoded );
+	uint16_t *patches = malloc( 2 * num_leaves * sizeof(uint16_t) );
+	// Final leaves of the tiles of the level below and of this level, for --lod
+	uint16_t *leaves = NULL;
+	long mismatches = 0;
+	*num_tiles = 0;
+	ok = ok && patches && height_grid_create( tilesize, tilesize, false, &tile ) &&
+			height_grid_create( tilesize, tilesize, false, &reference ) &&
+			height_grid_create( tilesize, tilesize, false, &scratch );
+	const height_grid_t *level_grid = &bench->expected;
+	for( uint32_t level = 0; ok && level < raster.num_levels; ++level ) {
+		uint32_t num_h, num_v;
+		virtual_raster_level_tiles( &raster, level, &num_h, &num_v );
+		if( level > 0 ) {
+			height_grid_t *const grid = &grids[level & 1];
+			height_grid_destroy( grid );
+			ok = height_grid_create( num_h * step + 1, num_v * step + 1, true, grid ) &&
+					lod_downsample( level_grid, LOD_FILTER_BOX, grid, bench->num_threads );
+			level_grid = grid;
+		}
+		uint16_t *const level_leaves = malloc( 2 * num_h * num_v * num_leaves * sizeof(uint16_t) );
+		for( uint32_t v = 0; ok && level_leaves && v < num_v; ++v ) {
+			for( uint32_t h = 0; ok && h < num_h; ++h ) {
+				// --tile
+				if( !( ok = virtual_raster_tile( &raster, h, v, level, &tile ) &&
+						virtual_raster_leaves_below( &raster, h, v, level, tree, minmax_tree_leaf_min( tree ),
+								minmax_tree_leaf_max( tree ) ) ) )
+					break;
+				add_patches( &tile, 0, 0, &scratch, tree, patches, patches + num_leaves );
+				minmax_tree_build( tree );
+				ok = minmax_tree_encode( tree, &bench->encoded );
+				// --lod
+				uint16_t *const lo = level_leaves + 2 * ( v * num_h + h ) * num_leaves;
+				uint16_t *const hi = lo + num_leaves;
+				const uint16_t *child_min[4] = { NULL };
+				const uint16_t *child_max[4] = { NULL };
+				for( uint32_t i = 0; level > 0 && i < 4; ++i ) {
+					const uint32_t child_v = 2 * v + i / 2;
+					const uint32_t child_h = 2 * h + i % 2;
+					uint32_t below_h, below_v;
+					virtual_raster_level_tiles( &raster, level - 1, &below_h, &below_v );
+					if( child_v < below_v && child_h < below_h ) {
+						child_min[i] = leaves + 2 * ( child_v * below_h + child_h ) * num_leaves;
+						child_max[i] = child_min[i] + num_leaves;
+					}
+				}
+				minmax_tree_leaves_from_children( tilesize, tree, child_min, child_max, minmax_tree_leaf_min( tree ),
+						minmax_tree_leaf_max( tree ) );
+				add_patches( level_grid, h * step, v * step, &reference, tree, patches, patches + num_leaves );
+				memcpy( lo, minmax_tree_leaf_min( tree ), num_leaves * sizeof(uint16_t) );
+				memcpy( hi, minmax_tree_leaf_max( tree ), num_leaves * sizeof(uint16_t) );
+				minmax_tree_build( tree );
+				ok = ok && minmax_tree_encode( tree, &encoded );
+				if( ok && ( !grid_equals( &tile, &reference ) || encoded.size != bench->encoded.size ||
+						memcmp( encoded.data, bench->encoded.data, encoded.size ) != 0 ) )
+					++mismatches;
+				++*num_tiles;
+			}
+		}
+		ok = ok && level_leaves;
+		free( leaves );
+		leaves = level_leaves;
+	}
+	free( leaves );
+	free( patches );
+	byte_buffer_free( &encoded );
+	height_grid_destroy( &scratch );
+	height_grid_destroy( &reference );
+	height_grid_destroy( &tile );
+	height_grid_destroy( &grids[0] );
+	height_grid_destroy( &grids[1] );
+	if( opened ) {
+		virtual_raster_close( &raster );
+		char index_path[sizeof(path) + sizeof(".rowidx")];
+		snprintf( index_path, sizeof(index_path), "%s.rowidx", path );
+		unlink( index_path );
+	}
+	if( fd >= 0 )
+		unlink( path );
+	return ok ? mismatches : -1;
+}
+
+// Tile i as raw tile with header into the encoded buffer, its quadtree into tree_encoded, and its pack entry
+static bool encode_packed( bench_t *bench, const uint32_t i, tile_raw_header_t *header, tile_pack_entry_t *entry,
+		byte_buffer_t *tree_encoded ) {
+	const uint32_t step = bench->header.tilesize - 1;
+	const uint32_t num_h_tiles = bench->header.num_columns / bench->header.tilesize;
+	const uint32_t col = i % num_h_tiles * step;
+	const uint32_t row = i / num_h_tiles * step;
+	minmax_tree_t *const tree = &bench->tree;
+	uint16_t min, max;
+	height_grid_copy_window_patches( &bench->expected, col, row, &bench->tiles[i], tree->patch_size,
+			minmax_tree_leaf_min( tree ), minmax_tree_leaf_max( tree ), &min, &max );
+	minmax_tree_build( tree );
+	*header = (tile_raw_header_t){ .min_height = min, .max_height = max, .start_col = col, .start_row = row,
+			.longitude = bench->header.longitude + col * bench->header.cellsize,
+			.latitude = bench->header.latitude + ( bench->header.num_rows - 1.0 - row - step ) * bench->header.cellsize,
+			.cellsize = bench->header.cellsize };
+	*entry = (tile_pack_entry_t){ .tile = i, .format = TILE_FORMAT_RAW, .min_x = col, .min_z = row,
+			.max_x = col + step, .max_z = row + step, .min_height = min, .max_height = max,
+			.longitude = header->longitude, .latitude = header->latitude, .ecef = bench->bounds };
+	return tile_raw_encode( &bench->tiles[i], header, &bench->encoded ) && minmax_tree_encode( tree, tree_encoded );
+}
+
+static bool entries_equal( const tile_pack_entry_t *const a, const tile_pack_entry_t *const b ) {
+	return a->tile == b->tile && a->format == b->format && a->offset == b->offset && a->length == b->length &&
+			a->min_x == b->min_x && a->min_z == b->min_z && a->max_x == b->max_x && a->max_z == b->max_z &&
+			a->min_height == b->min_height && a->max_height == b->max_height && a->level == b->level &&
+			a->longitude == b->longitude && a->latitude == b->latitude && a->tree_offset == b->tree_offset &&
+			a->tree_length == b->tree_length && memcmp( &a->ecef, &b->ecef, sizeof(a->ecef) ) == 0;
+}
+
+// Whether the header parsed from a raw tile is the one encoded and its posts are those of tile
+static bool raw_tile_equals( const byte_buffer_t *const raw, const tile_raw_header_t *const header,
+		const height_grid_t *const tile ) {
+	tile_raw_header_t parsed;
+	if( !tile_raw_parse_header( raw->data, raw->size, &parsed ) || parsed.version != header->version ||
+		parsed.header_size != header->header_size || parsed.width != header->width || parsed.height != header->height ||
+		parsed.stride != header->stride || parsed.min_height != header->min_height ||
+		parsed.max_height != header->max_height || parsed.start_col != header->start_col ||
+		parsed.start_row != header->start_row || parsed.longitude != header->longitude ||
+		parsed.latitude != header->latitude || parsed.cellsize != header->cellsize )
+		return false;
+	const unsigned char *const posts = (const unsigned char *)raw->data + parsed.header_size;
+	for( uint32_t r = 0; r < parsed.height; ++r ) {
+		const uint16_t *const row = height_grid_row( tile, r );
+		for( uint32_t c = 0; c < parsed.width; ++c )
+			if( load_u16( posts + ( (size_t)r * parsed.stride + c ) * sizeof(uint16_t) ) != row[c] )
+				return false;
+	}
+	return true;
+}
+
+static bool buffers_equal( const byte_buffer_t *const a, const byte_buffer_t *const b ) {
+	return a->size == b->size && memcmp( a->data, b->data, a->size ) == 0;
+}
+
+/* Packs all tiles but every seventh, as if skipped, as raw tiles with their quadtrees into a
+ * temporary file and reads them back. Counts the tiles whose entry, payload, raw tile header or
+ * quadtree differ from what went in and the skipped ones that are found, the header counts as one. -1 on errors. */
+static long pack_mismatch( bench_t *bench ) {
+	char path[] = "/tmp/srtm_bench_XXXXXX";
+	const int fd = mkstemp( path );
+	if( fd < 0 )
+		return -1;
+	close( fd );
+	tile_pack_entry_t *const entries = calloc( bench->num_tiles, sizeof(tile_pack_entry_t) );
+	byte_buffer_t tree_encoded, read;
+	byte_buffer_init( &tree_encoded );
+	byte_buffer_init( &read );
+	tile_pack_t pack;
+	bool ok = entries && tile_pack_create( path, &bench->header, bench->num_tiles, &pack );
+	if( ok ) {
+		for( uint32_t i = 0; ok && i < bench->num_tiles; ++i ) {
+			tile_raw_header_t header;
+			ok = i % 7 == 6 || ( encode_packed( bench, i, &header, &entries[i], &tree_encoded ) &&
+					tile_pack_add( &pack, &entries[i], bench->encoded.data, bench->encoded.size, tree_encoded.data,
+							tree_encoded.size ) );
+		}
+		ok = tile_pack_finish( &pack ) && ok;
+	}
+	long mismatches = 0;
+	if( ok && ( ok = tile_pack_open( path, &pack ) ) ) {
+		mismatches += pack.num_tiles != bench->num_tiles || pack.entry_size != TILE_PACK_ENTRY_SIZE ||
+				pack.tilesize != bench->header.tilesize || pack.num_columns != bench->header.num_columns ||
+				pack.num_rows != bench->header.num_rows || pack.longitude != bench->header.longitude ||
+				pack.latitude != bench->header.latitude || pack.cellsize != bench->header.cellsize;
+		for( uint32_t i = 0; ok && i < bench->num_tiles; ++i ) {
+			tile_pack_entry_t entry;
+			const bool found = tile_pack_find( &pack, i, &entry );
+			if( i % 7 == 6 ) {
+				mismatches += found;
+				continue;
+			}
+			tile_raw_header_t header;
+			tile_pack_entry_t expected;
+			if( !( ok = encode_packed( bench, i, &header, &expected, &tree_encoded ) ) )
+				break;
+			if( !found || !entries_equal( &entry, &entries[i] ) || !tile_pack_read( &pack, &entry, &read ) ||
+				!buffers_equal( &read, &bench->encoded ) || !raw_tile_equals( &read, &header, &bench->tiles[i] ) ||
+				!tile_pack_read_tree( &pack, &entry, &read ) ||
+				!buffers_equal( &read, &tree_encoded ) )
+				++mismatches;
+		}
+		tile_pack_close( &pack );
+	}
+	free( entries );
+	byte_buffer_free( &tree_encoded );
+	byte_buffer_free( &read );
+	unlink( path );
+	return ok ? mismatches : -1;
+}
+
+static bool write_file( const bench_t *const bench, const char *const path ) {
+	FILE *file = fopen( path, "wb" );
+	const bool ok = file && fwrite( bench->text, bench->size, 1, file ) == 1;
+	if( file && fclose( file ) != 0 )
+		return false;
+	if( ok )
+		printf( "Saved the grid as '%s'\n", path );
+	return ok;
+}
+
+static void print_usage( const char *const name ) {
+	fprintf( stderr, "Usage: '%s [options]'\n"
+			"\t--columns N, --rows N  size of the synthetic grid, default 6000 x 3000\n"
+			"\t--repetitions N        timed runs per stage, default 7\n"
+			"\t--threads N            threads for the parallel parser, default is the number of cpus\n"
+			"\t--tilesize N           size of the tiles cut and encoded, power of 2, default 512\n"
+			"\t--png P                png compression profile fastest, balanced (default) or smallest\n"
+			"\t--seed N               seed of the terrain, default 42\n"
+			"\t--write FILE           also save the grid as ascii file\n", name );
+}
+
+int main( int argc, char *argv[argc+1] ) {
+	uint32_t columns = 6000;
+	uint32_t rows = 3000;
+	unsigned repetitions = 7;
+	uint32_t tilesize = 512;
+	uint32_t seed = 42;
+	const char *write_path = NULL;
+	const long num_cpus = sysconf( _SC_NPROCESSORS_ONLN );
+	bench_t bench;
+	memset( &bench, 0, sizeof(bench) );
+	bench.num_threads = num_cpus > 0 ? (unsigned)num_cpus : 1;
+	bench.png_profile = png_profile_default();
+	static const struct option long_options[] = {
+			{ "columns", required_argument, NULL, 'c' },
+			{ "rows", required_argument, NULL, 'r' },
+			{ "repetitions", required_argument, NULL, 'n' },
+			{ "threads", required_argument, NULL, 't' },
+			{ "tilesize", required_argument, NULL, 's' },
+			{ "png", required_argument, NULL, 'p' },
+			{ "seed", required_argument, NULL, 'S' },
+			{ "write", required_argument, NULL, 'w' },
+			{ NULL, 0, NULL, 0 }
+	};
+	int option;
+	while( ( option = getopt_long( argc, argv, "", long_options, NULL ) ) != -1 ) {
+		const unsigned long value = optarg ? strtoul( optarg, NULL, 10 ) : 0;
+		switch( option ) {
+		case 'c':
+			columns = (uint32_t)value;
+			break;
+		case 'r':
+			rows = (uint32_t)value;
+			break;
+		case 'n':
+			repetitions = (unsigned)value;
+			break;
+		case 't':
+			bench.num_threads = (unsigned)value;
+			break;
+		case 's':
+			tilesize = (uint32_t)value;
+			break;
+		case 'p':
+			if( !( bench.png_profile = png_profile_find( optarg ) ) ) {
+				fprintf( stderr, "Png profile must be fastest, balanced or smallest, is '%s'\n", optarg );
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'S':
+			seed = (uint32_t)value;
+			break;
+		case 'w':
+			write_path = optarg;
+			break;
+		default:
+			print_usage( argv[0] );
+			return EXIT_FAILURE;
+		}
+	}
+	if( optind != argc || repetitions == 0 || repetitions > 1000 || bench.num_threads < 1 ||
+		bench.num_threads > 1024 || tilesize < 256 || tilesize > 16384 || ( tilesize & ( tilesize - 1 ) ) != 0 ||
+		columns < tilesize || rows < tilesize || columns > 100000 || rows > 100000 ) {
+		print_usage( argv[0] );
+		fputs( "The grid must be at least one tile in size\n", stderr );
+		return EXIT_FAILURE;
+	}
+	if( !generate( columns, rows, seed, &bench ) ||
+		( write_path && !write_file( &bench, write_path ) ) )
+		return EXIT_FAILURE;
+	const uint32_t num_h_tiles = columns / tilesize;
+	bench.num_tiles = num_h_tiles * ( rows / tilesize );
+	const size_t tile_posts = (size_t)tilesize * tilesize;
+	bench.tiles = calloc( bench.num_tiles, sizeof(height_grid_t) );
+	bench.geodetic = malloc( tile_posts * sizeof(geodetic_t) );
+	bench.cartesian = malloc( tile_posts * sizeof(vec3d) );
+	bench.converted = malloc( tile_posts * sizeof(geodetic_t) );
+	double *const soa = malloc( 6 * tile_posts * sizeof(double) );
+	bench.grid_cartesian = (vec3d_soa_t){ soa, soa + tile_posts, soa + 2 * tile_posts };
+	bench.grid_geodetic = (geodetic_soa_t){ soa + 3 * tile_posts, soa + 4 * tile_posts, soa + 5 * tile_posts };
+	bool ok = bench.tiles && bench.geodetic && bench.cartesian && bench.converted && soa &&
+			height_grid_create( columns, rows, false, &bench.grid ) &&
+			height_grid_create( tilesize + 2, tilesize + 2, false, &bench.halo ) &&
+			ellipsoid_columns_create( tilesize + 2, &bench.columns ) &&
+			minmax_tree_create( tilesize, MINMAX_TREE_PATCH_SIZE, &bench.tree );
+	for( uint32_t i = 0; ok && i < bench.num_tiles; ++i )
+		ok = height_grid_create( tilesize, tilesize, false, &bench.tiles[i] );
+	byte_buffer_init( &bench.encoded );
+	byte_buffer_init( &bench.normals );
+	byte_buffer_init( &bench.mesh );
+	if( !ok ) {
+		fputs( "Error allocating memory for the benchmarks\n", stderr );
+		return EXIT_FAILURE;
+	}
+	printf( "%s parser, %u threads, %u tiles of %u, png %s, %u repetitions\n\n", asc_parser_isa(), bench.num_threads,
+			bench.num_tiles, tilesize, bench.png_profile->name, repetitions );
+	const double num_values = (double)columns * rows;
+	const double tiles_bytes = (double)bench.num_tiles * tile_posts * sizeof(uint16_t);
+	bench.header.tilesize = tilesize;
+	ok = run_stage( "header", stage_header, &bench, repetitions, HEADER_BATCH, true, 0.0, 0.0 );
+	const double body_bytes = (double)( bench.text + bench.size - bench.body );
+	ok = ok && run_stage( "parse sequential", stage_parse_sequential, &bench, repetitions, 1, false, body_bytes, num_values );
+	ok = ok && run_stage( "parse parallel", stage_parse_parallel, &bench, repetitions, 1, false, body_bytes, num_values );
+	ok = ok && run_stage( "parse strtol", stage_parse_strtol, &bench, repetitions, 1, false, body_bytes, num_values );
+	ok = ok && run_stage( "clamp", stage_clamp, &bench, repetitions, 1, false, num_values * sizeof(int32_t), num_values );
+	ok = ok && run_stage( "clamp i16", stage_clamp_i16, &bench, repetitions, 1, false, num_values * sizeof(int16_t),
+			num_values );
+	ok = ok && run_stage( "tiling", stage_tiling, &bench, repetitions, 1, false, tiles_bytes,
+			(double)bench.num_tiles * tile_posts );
+	ok = ok && run_stage( "png encode", stage_png_encode, &bench, repetitions, 1, false, tiles_bytes,
+			(double)bench.num_tiles * tile_posts );
+	if( ok )
+		printf( "%-20s %.1f MB, %.1f%% of the posts\n", "", (double)bench.encoded_bytes * 1e-6,
+				100.0 * (double)bench.encoded_bytes / tiles_bytes );
+	// The posts of the first tile on WGS84
+	ellipsoid_create( 6378137.0, 6378137.0, 6356752.314245, &bench.ellipsoid );
+	for( uint32_t r = 0; r < tilesize; ++r ) {
+		for( uint32_t c = 0; c < tilesize; ++c ) {
+			geodetic_t *const g = &bench.geodetic[(size_t)r * tilesize + c];
+			g->lon = bench.header.longitude + c * bench.header.cellsize;
+			g->lat = bench.header.latitude + ( rows - 1.0 - r ) * bench.header.cellsize;
+			g->height = height_grid_row( &bench.expected, r )[c];
+		}
+	}
+	// Rows from north to south like the tile
+	bench.geodetic_grid = (geodetic_grid_t){ bench.header.longitude,
+			bench.header.latitude + ( rows - 1.0 ) * bench.header.cellsize, bench.header.cellsize,
+			-bench.header.cellsize, tilesize, tilesize };
+	ok = ok && run_stage( "to cartesian", stage_to_cartesian, &bench, repetitions, 1, false, 0.0, (double)tile_posts );
+	ok = ok && run_stage( "grid to cartesian", stage_grid_to_cartesian, &bench, repetitions, 1, false, 0.0,
+			(double)tile_posts );
+	if( ok )
+		printf( "%-20s max. %.3g m from to cartesian\n", "", grid_cartesian_error( &bench ) );
+	ok = ok && run_stage( "bounds", stage_bounds, &bench, repetitions, 1, false, tile_posts * sizeof(uint16_t),
+			(double)tile_posts );
+	if( ok )
+		print_bounds_error( &bench );
+	ok = ok && run_stage( "mesh", stage_mesh, &bench, repetitions, 1, false, tile_posts * sizeof(uint16_t),
+			(double)tile_posts );
+	if( ok )
+		print_mesh_error( &bench );
+	ok = ok && run_stage( "to geodetic", stage_to_geodetic, &bench, repetitions, 1, false, 0.0, (double)tile_posts );
+	ok = ok && run_stage( "batch to geodetic", stage_batch_to_geodetic, &bench, repetitions, 1, false, 0.0,
+			(double)tile_posts );
+	if( ok )
+		print_geodetic_error( &bench );
+	ok = ok && run_stage( "normal maps", stage_normal_maps, &bench, repetitions, 1, false, tiles_bytes,
+			(double)bench.num_tiles * tile_posts );
+	if( ok )
+		printf( "%-20s max. %.3g deg from sobel in double precision\n", "", normal_map_error( &bench ) );
+	if( ok ) {
+		uint32_t num_requested;
+		// The virtual raster reports what it indexes
+		const int saved = mute_stdout();
+		const long mismatches = requested_tiles_mismatch( &bench, &num_requested );
+		unmute_stdout( saved );
+		if( mismatches < 0 )
+			fputs( "Error making the requested tiles\n", stderr );
+		else if( mismatches > 0 )
+			fprintf( stderr, "%ld of %u requested tiles differ from the levels of detail\n", mismatches, num_requested );
+		if( ( ok = mismatches == 0 ) )
+			printf( "%-20s %u tiles of all levels made alone as with --lod\n", "requested tiles", num_requested );
+	}
+	if( ok ) {
+		const long mismatches = pack_mismatch( &bench );
+		if( mismatches < 0 )
+			fputs( "Error packing the tiles\n", stderr );
+		else if( mismatches > 0 )
+			fprintf( stderr, "%ld of %u tiles read back from a tile pack differ\n", mismatches, bench.num_tiles );
+		if( ( ok = mismatches == 0 ) )
+			printf( "%-20s %u tiles read back from a tile pack as written\n", "tile pack", bench.num_tiles );
+	}
+	for( uint32_t i = 0; i < bench.num_tiles; ++i )
+		height_grid_destroy( &bench.tiles[i] );
+	free( bench.tiles );
+	free( bench.geodetic );
+	free( bench.cartesian );
+	free( bench.converted );
+	free( soa );
+	byte_buffer_free( &bench.encoded );
+	byte_buffer_free( &bench.normals );
+	byte_buffer_free( &bench.mesh );
+	height_grid_destroy( &bench.halo );
+	ellipsoid_columns_destroy( &bench.columns );
+	minmax_tree_destroy( &bench.tree );
+	height_grid_destroy( &bench.grid );
+	height_grid_destroy( &bench.expected );
+	free( bench.text );
+	free( bench.raw );
+	free( bench.raw16 );
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
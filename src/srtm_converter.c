@@ -3,9 +3,27 @@
  * in png format. Writes out the texture and two ascii files that describe the
  * axis aligned bounding boxes of each tile. One bb is relative to the texture,
  * starting in the lower left corner, the other relative to the given oblate
- * ellipsoid in geodetic (lat/lon) decimal notation.
+ * ellipsoid in geodetic (lat/lon) decimal notation. A min/max quadtree of each tile
+ * goes into a .mmq file next to it, see srtm/minmax_tree.h.
+ * Options:
+ * - --stream: convert one strip of tiles at a time instead of reading the whole input first
+ * - --threads N: number of threads for parsing and tile encoding, default is the number of cpus
+ * - --png fastest|balanced|smallest: png compression profile, default is balanced
+ * - --format png|raw: tile format, raw is little endian uint16 with a header, see srtm/tile_raw.h
+ * - --pack FILE: write all tiles and their bounding boxes into one container, see srtm/tile_pack.h
+ * - --lod box|max: also write coarser levels down to a single tile, filtered with a 3x3 box or maximum
+ * - --mosaic: the input is a text file listing ascii files, one per line, that are put together by
+ *   their lower left corners into one raster, see srtm/mosaic.h
+ * - --tile TX,TY[,LEVEL]: write only this tile, may be repeated; only the input rows it needs are
+ *   parsed, see srtm/virtual_raster.h
+ * - --cache MB: memory for tiles kept between --tile requests, default 256
+ * - --no-grid-cache: neither use nor save the parsed grid as <input>.int16, see srtm/grid_cache.h
+ * - --bbox LON_MIN LAT_MIN LON_MAX LAT_MAX: tile only the posts that cover this geodetic extent
+ * - --window COL ROW WIDTH HEIGHT: tile only this window of posts, counted from the north west
+ * - --stats FILE: write the time, throughput and memory use of each stage as json, see srtm/run_stats.h
+ * - --rebuild: write all tiles, also those the manifest of the last run has unchanged, see srtm/tile_manifest.h
  * Parameters:
- * - pathname of ascii file to import
+ * - pathname of ascii file to import, "-" reads from stdin
  * - size of texture tiles to generate, default is 2048
  * - ellipsoid semi major axes (x/y equatorial plane), default WGS84
  * - ellipsoid semi minor axes (z = rotation axis), default WGS84 */
@@ -15,243 +33,1203 @@
 #include <inttypes.h>
 #include <limits.h>
 #include <stdbool.h>
-#include <png.h>
 #include "omath/ellipsoid.h"
+#include "omath/ellipsoid_batch.h"
 #include "omath/common.h"
 #include <tgmath.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+#include "srtm/asc_parallel.h"
+#include "srtm/ecef_bounds.h"
+#include "srtm/tile_mesh.h"
+#include "srtm/normal_map.h"
+#include "srtm/grid_cache.h"
+#include "srtm/height_grid.h"
+#include "srtm/input_file.h"
+#include "srtm/lod_pyramid.h"
+#include "srtm/minmax_tree.h"
+#include "srtm/mosaic.h"
+#include "srtm/run_stats.h"
+#include "srtm/srtm_header.h"
+#include "srtm/tile_format.h"
+#include "srtm/tile_manifest.h"
+#include "srtm/tile_pack.h"
+#include "srtm/tile_png.h"
+#include "srtm/tile_raw.h"
+#include "srtm/tile_pool.h"
+#include "srtm/timer.h"
+#include "srtm/virtual_raster.h"
+#include "srtm/xxhash64.h"
 
-// Header info of an ascii srtm-90 file, the only input format
-typedef struct srtm_header_t {
-	// humber of posts in width and height
-	uint32_t num_columns;
-	uint32_t num_rows;
-	// lower left corner
-	double longitude;
-	double latitude;
-	// distance between posts; angle in arcseconds decimel
-	double cellsize;
-	// a default when there's no data for a post
-	int no_data;
-	uint32_t tilesize;
-} srtm_header_t;
+// converts degrees decimal to degrees minutes arcseconds
+static inline void deg2dms( const double dec, uint32_t *deg, uint32_t *min, uint32_t *sec ) {
+	*deg = (uint32_t)floor(dec);
+	double rest_mins = dec - floor(dec);
+	*min = (uint32_t)floor(rest_mins*60.0);
+	double rest_secs = rest_mins - floor(rest_mins*60.0);
+	*sec = (uint32_t)(rest_secs*60.0);
+}
 
-bool read_srtm_ascii_header( FILE *file, srtm_header_t *header ) {
-	// Read header data of an srtm v 4.1 file
-	if( 1 == fscanf( file, "ncols %u\n", &header->num_columns ) )
-		printf( "Columns: %d\n", header->num_columns );
-	else {
-		fputs( "Error reading ascii header number of columns\n", stderr );
-		return false;
+/* Parses count rows into the grid rows from first on, one after the other, refilling the buffer
+ * of a streamed file as needed. input_row is the row of the input for messages. */
+static bool read_rows_sequential( height_grid_t *image_data, const uint32_t first, const uint32_t count,
+		const uint32_t input_row, const srtm_header_t *header, input_file_t *in, const char **pos,
+		asc_parse_stats_t *stats ) {
+	for( uint32_t i = 0; i < count; ++i ) {
+		uint32_t j = 0;
+		while( j < header->num_columns ) {
+			size_t parsed;
+			const char *next = asc_parse_values( *pos, in->data + in->size, in->eof, header->no_data,
+					height_grid_row( image_data, first + i ) + j, header->num_columns - j, &parsed, stats );
+			if( !next ) {
+				fprintf( stderr, "Error parsing value in row %u, column %u\n", input_row + i, j + (uint32_t)parsed );
+				return false;
+			}
+			j += (uint32_t)parsed;
+			*pos = next;
+			if( j == header->num_columns )
+				break;
+			// Keep the unconsumed rest and read on
+			if( !input_file_refill( in, pos ) ) {
+				fprintf( stderr, "Unexpected end of data in row %u, column %u\n", input_row + i, j );
+				return false;
+			}
+		}
 	}
-	if( 1 == fscanf( file, "nrows %u\n", &header->num_rows ) )
-		printf( "Rows: %d\n", header->num_rows );
-	else {
-		fputs( "Error reading ascii header number of rows\n", stderr );
+	return true;
+}
+
+/* Where the rows come from: one ascii file, read from pos on, a mosaic of them if mosaic is set,
+ * or the grid parsed in an earlier run if cache is set */
+typedef struct row_source_t {
+	input_file_t *in;
+	const char *pos;
+	mosaic_t *mosaic;
+	grid_cache_t *cache;
+	/* With cropped set only the window from column col, row row on is read, from the cache or
+	 * the mosaic with its rows indexed; a single file is then opened as a mosaic */
+	bool cropped;
+	uint32_t col;
+	uint32_t row;
+} row_source_t;
+
+/* Reads the next count rows, input_row on, into the grid rows from first on. The inputs of a
+ * mosaic are parsed in parallel. */
+static bool read_rows( row_source_t *source, height_grid_t *image_data, const uint32_t first, const uint32_t count,
+		const uint32_t input_row, const srtm_header_t *header, const unsigned num_threads, asc_parse_stats_t *stats ) {
+	height_grid_t rows;
+	if( source->cache ) {
+		uint16_t min, max;
+		height_grid_copy_window( &source->cache->grid, source->col, source->row + input_row,
+				height_grid_view( image_data, 0, first, header->num_columns, count, &rows ), &min, &max );
+		return true;
+	}
+	if( source->cropped )
+		return mosaic_read_window( source->mosaic, source->col, source->row + input_row, header->num_columns, count,
+				height_grid_view( image_data, 0, first, header->num_columns, count, &rows ), num_threads, stats );
+	if( source->mosaic )
+		return mosaic_read_rows( source->mosaic, input_row, count, image_data, first, num_threads, stats );
+	return read_rows_sequential( image_data, first, count, input_row, header, source->in, &source->pos, stats );
+}
+
+// Bytes of a single input parsed so far, those delivered short of the unparsed rest; a mosaic's aren't counted
+static uint64_t row_source_bytes( const row_source_t *const source ) {
+	if( source->cache || source->mosaic )
+		return 0;
+	return source->in->bytes_read - (uint64_t)( source->in->data + source->in->size - source->pos );
+}
+
+static void row_source_close( row_source_t *source ) {
+	if( source->cache )
+		grid_cache_close( source->cache );
+	else if( source->mosaic )
+		mosaic_close( source->mosaic );
+	else
+		input_file_close( source->in );
+}
+
+/* Reads the body of the ascii file. A mapped file is parsed in place by num_threads threads,
+ * a stream chunk by chunk, a mosaic with a thread per input. */
+bool read_image( height_grid_t *image_data, srtm_header_t *header, row_source_t *source,
+		const unsigned num_threads, run_stats_t *run_stats ) {
+	// Read whole image into array
+	const input_file_t *const in = source->in;
+	const bool parallel = !source->mosaic && in->mapped && num_threads > 1;
+	if( source->cropped )
+		printf( "Reading image data (%s parser, rows of the window, %u threads) ...\n", asc_parser_isa(), num_threads );
+	else if( source->mosaic )
+		printf( "Reading image data (%s parser, mosaic of %u inputs, %u threads) ...\n", asc_parser_isa(),
+				source->mosaic->num_inputs, num_threads );
+	else
+		printf( "Reading image data (%s parser, %s, %u threads) ...\n", asc_parser_isa(),
+				in->mapped ? "mapped" : "streamed", parallel ? num_threads : 1 );
+	if( !height_grid_create( header->num_columns, header->num_rows, true, image_data ) ) {
+		fputs( "Error allocating memory for image data\n", stderr );
 		return false;
 	}
-	if( header->num_columns <= 0 || header->num_rows <= 0 ||
-		header->num_columns < header->tilesize || header->num_rows < header->tilesize ) {
-		fputs( "Error, size of data could not be determined or tile size > size of data\n", stderr );
+	/* Set no data to 0 but this can cause holes in some areas where there is a no data value,
+	 * e.g. on some glaciers or where it was particularly cloudy, which happens in the srtm data.
+	 * Also clip negative values to 0; it is often sea surface.
+	 * Real negative height values below the reference ellipsoid's surface are excluded. */
+	asc_parse_stats_t stats;
+	asc_parse_stats_init( &stats );
+	uint64_t num_values = (uint64_t)header->num_columns * header->num_rows;
+	stage_timer_t timer;
+	stage_timer_start( &timer, false );
+	bool ok = parallel && asc_parse_rows_parallel( source->pos, in->data + in->size, header->num_rows,
+			header->num_columns, header->no_data, image_data->data, image_data->stride, num_threads, &stats );
+	if( !ok ) {
+		if( parallel )
+			puts( "Parallel parse failed, reading sequentially ..." );
+		ok = read_rows( source, image_data, 0, header->num_rows, 0, header, num_threads, &stats );
+	}
+	const uint64_t bytes = source->mosaic ? source->mosaic->bytes : in->bytes_read;
+	const double seconds = run_stats_add( run_stats, RUN_STAGE_PARSE, &timer, source->cropped ? 0 : bytes,
+			num_values * sizeof(uint16_t), stats.value_count );
+	printf( "Read %" PRIu64 " of %" PRIu64 " value; min %d; max %d; %" PRIu64 " no data; %" PRIu64 " negative\n",
+			stats.value_count, num_values, stats.min_value, stats.max_value, stats.no_data_count, stats.negative_count );
+	if( source->cropped )
+		printf( "Parsed the window in %.2fs\n", seconds );
+	else
+		printf( "Parsed %.1f MB in %.2fs (%.1f MB/s)\n", (double)bytes * 1e-6, seconds,
+				seconds > 0.0 ? (double)bytes * 1e-6 / seconds : 0.0 );
+	return ok;
+}
+
+// What the workers share when writing a range of tiles
+typedef struct tile_jobs_t {
+	const srtm_header_t *header;
+	const uint32_t *start_row;
+	const uint32_t *start_col;
+	// holds the input from row first_row, column first_col on
+	const height_grid_t *image_data;
+	uint32_t first_row;
+	uint32_t first_col;
+	uint32_t first_tile;
+	tile_format_t format;
+	const png_profile_t *png_profile;
+	// for the cartesian bounding volumes and meshes
+	const ellipsoid_t *ellipsoid;
+	// vertex buffer with these attributes next to each tile if set, not with a container
+	bool mesh;
+	uint32_t mesh_attributes;
+	// normal map next to each tile if set, with a halo of this many posts; not with a container
+	bool normals;
+	uint32_t normal_halo;
+	// tiles go into this container instead of single files if set
+	tile_pack_t *pack;
+	// unchanged tiles of the last run are kept if set, not with a container
+	tile_manifest_t *manifest;
+	// tiles with at least this percentage of posts at 0, no data or sea, are not written; 0 writes all
+	uint32_t skip_void;
+	// level of detail, start rows/columns are in posts of this level
+	uint32_t level;
+	// tiles of the level along each axis, meshes and normal maps don't read posts beyond them
+	uint32_t num_h_tiles;
+	uint32_t num_v_tiles;
+	// number of the level's first tile in the container
+	uint32_t pack_first;
+	// per tile of the level, min/max quadtree leaves; gathered from the level below before a level is written
+	uint16_t *leaf_min;
+	uint16_t *leaf_max;
+	// one per worker
+	struct tile_scratch_t *scratch;
+} tile_jobs_t;
+
+// Memory a worker reuses from tile to tile
+typedef struct tile_scratch_t {
+	height_grid_t image;
+	byte_buffer_t encoded;
+	minmax_tree_t tree;
+	byte_buffer_t tree_encoded;
+	byte_buffer_t mesh;
+	// longitudes of the tile's columns and one more either side
+	ellipsoid_columns_t columns;
+	// the tile with the posts around it that the mesh and the normal map read
+	height_grid_t halo;
+	byte_buffer_t normals;
+	run_stats_t stats;
+	uint32_t num_skipped;
+} tile_scratch_t;
+
+// If the image file and the files next to it are there
+static bool outputs_exist( const char *const filename, const bool mesh, const bool normals ) {
+	char name[40];
+	snprintf( name, sizeof(name), "%s", filename );
+	if( access( name, F_OK ) != 0 )
+		return false;
+	snprintf( &name[strlen(name)-4], 5, ".mmq" );
+	if( access( name, F_OK ) != 0 )
+		return false;
+	sprintf( &name[strlen(name)-4], ".bb" );
+	if( access( name, F_OK ) != 0 )
 		return false;
+	sprintf( &name[strlen(name)-3], ".vtx" );
+	if( mesh && access( name, F_OK ) != 0 )
+		return false;
+	sprintf( &name[strlen(name)-4], ".nrm" );
+	return !normals || access( name, F_OK ) == 0;
+}
+
+// Writes buffer to the file name, what names its content in the error message
+static bool write_file( const char *const name, const byte_buffer_t *const buffer, const char *const what ) {
+	FILE *file = fopen( name, "wb" );
+	bool ok = file && ( buffer->size == 0 || 1 == fwrite( buffer->data, buffer->size, 1, file ) );
+	if( file && fclose(file) != 0 )
+		ok = false;
+	if( !ok )
+		fprintf( stderr, "Error writing %s file '%s'\n", what, name );
+	return ok;
+}
+
+bool write_tile( const tile_jobs_t *const jobs, const uint32_t tile, tile_scratch_t *scratch, FILE *log ) {
+	const srtm_header_t *const header = jobs->header;
+	const uint32_t *const start_row = jobs->start_row;
+	const uint32_t *const start_col = jobs->start_col;
+	height_grid_t *image = &scratch->image;
+	minmax_tree_t *tree = &scratch->tree;
+	const size_t num_leaves = (size_t)tree->leaves * tree->leaves;
+	uint16_t *const leaf_min = jobs->leaf_min + tile * num_leaves;
+	uint16_t *const leaf_max = jobs->leaf_max + tile * num_leaves;
+	// Rows of the window are contiguous in both grids
+	uint16_t min_y;
+	uint16_t max_y;
+	uint16_t *const tree_min = minmax_tree_leaf_min( tree );
+	uint16_t *const tree_max = minmax_tree_leaf_max( tree );
+	stage_timer_t timer;
+	stage_timer_start( &timer, true );
+	height_grid_copy_window_patches( jobs->image_data, start_col[tile] - jobs->first_col, start_row[tile] - jobs->first_row, image,
+			tree->patch_size, tree_min, tree_max, &min_y, &max_y );
+	if( jobs->level > 0 ) {
+		// Also hold the source data below, whatever the filter did to it
+		for( size_t i = 0; i < num_leaves; ++i ) {
+			tree_min[i] = tree_min[i] > leaf_min[i] ? leaf_min[i] : tree_min[i];
+			tree_max[i] = tree_max[i] < leaf_max[i] ? leaf_max[i] : tree_max[i];
+		}
 	}
-	if( 1 == fscanf( file, "xllcorner %lf\n", &header->longitude ) )
-		printf( "Lower left lon: %lf", header->longitude );
-	else {
-		fputs( "Error reading ascii header lower left x (longitude)\n", stderr );
+	// For the next level
+	memcpy( leaf_min, tree_min, num_leaves * sizeof(uint16_t) );
+	memcpy( leaf_max, tree_max, num_leaves * sizeof(uint16_t) );
+	minmax_tree_build( tree );
+	run_stats_add( &scratch->stats, RUN_STAGE_EXTRACT, &timer, (uint64_t)image->width * image->height * sizeof(uint16_t),
+			0, (uint64_t)image->width * image->height );
+	min_y = tree->min[0];
+	max_y = tree->max[0];
+	const uint64_t num_posts = (uint64_t)image->width * image->height;
+	const uint64_t num_void = min_y > 0 ? 0 : height_grid_count( image, 0 );
+	// Position and extent in posts of the input
+	const uint32_t scale = 1u << jobs->level;
+	const uint32_t first_col = start_col[tile] * scale;
+	const uint32_t first_row = start_row[tile] * scale;
+	const uint32_t extent = ( header->tilesize - 1 ) * scale;
+	const double cellsize = header->cellsize * scale;
+	const double min_lon = header->longitude + (double)first_col * header->cellsize;
+	// Rows run from north to south, the lower left of the tile is its last row
+	const double min_lat = header->latitude +
+			( (double)header->num_rows - 1.0 - first_row - extent ) * header->cellsize;
+	char filename[40];
+	if( jobs->level == 0 )
+		snprintf( filename, sizeof(filename), "tile_%u_%u.%s", header->tilesize, tile+1, tile_format_name( jobs->format ) );
+	else
+		snprintf( filename, sizeof(filename), "tile_%u_l%u_%u.%s", header->tilesize, jobs->level, tile+1,
+				tile_format_name( jobs->format ) );
+	const double void_percent = 100.0 * (double)num_void / (double)num_posts;
+	if( jobs->skip_void > 0 && void_percent >= (double)jobs->skip_void ) {
+		// Its leaves are kept above for the coarser levels
+		fprintf( log, "Skipping image file '%s', %.1f%% of the posts are no data or sea\n", filename, void_percent );
+		++scratch->num_skipped;
+		return true;
+	}
+	if( jobs->mesh || jobs->normals ) {
+		// The posts beyond the outermost tiles of the level repeat their edge
+		const uint32_t margin = jobs->normal_halo + 1;
+		const uint32_t step = header->tilesize - 1;
+		height_grid_copy_clamped( jobs->image_data, (int64_t)start_col[tile] - jobs->first_col - margin,
+				(int64_t)start_row[tile] - jobs->first_row - margin, jobs->num_h_tiles * step + 1 - jobs->first_col,
+				jobs->num_v_tiles * step + 1 - jobs->first_row, &scratch->halo );
+	}
+	uint64_t hash = 0;
+	if( jobs->manifest ) {
+		// Coarser levels' leaves hold the source data below, a tile with the same posts may have others
+		xxh64_state_t state;
+		xxh64_init( &state, 0 );
+		for( uint32_t r = 0; r < image->height; ++r )
+			xxh64_update( &state, height_grid_row( image, r ), image->width * sizeof(uint16_t) );
+		xxh64_update( &state, tree_min, num_leaves * sizeof(uint16_t) );
+		xxh64_update( &state, tree_max, num_leaves * sizeof(uint16_t) );
+		// The mesh and the normal map change with the posts of the neighbours as well
+		if( jobs->mesh || jobs->normals )
+			for( uint32_t r = 0; r < scratch->halo.height; ++r )
+				xxh64_update( &state, height_grid_row( &scratch->halo, r ), scratch->halo.width * sizeof(uint16_t) );
+		hash = xxh64_digest( &state );
+		if( tile_manifest_unchanged( jobs->manifest, jobs->pack_first + tile, hash ) &&
+			outputs_exist( filename, jobs->mesh, jobs->normals ) ) {
+			tile_manifest_set( jobs->manifest, jobs->pack_first + tile, hash, TILE_STATE_KEPT );
+			fprintf( log, "Keeping unchanged image file '%s'\n", filename );
+			return true;
+		}
+	}
+	// print writing image x of y
+	fprintf( log, "Writing image file '%s', %.1f%% of the posts are no data or sea\n", filename, void_percent );
+	// Real world bounding volumes, rows run from north to south
+	const geodetic_grid_t geodetic = {
+			min_lon, min_lat + ( image->height - 1.0 ) * cellsize, cellsize, -cellsize, image->width, image->height
+	};
+	// Longitudes of the tile's columns and one beyond either side, shared by the bounds and the mesh
+	const geodetic_grid_t wide = {
+			min_lon - cellsize, geodetic.lat, cellsize, -cellsize, image->width + 2, image->height
+	};
+	ellipsoid_columns_t tile_columns;
+	ecef_bounds_t bounds;
+	stage_timer_start( &timer, true );
+	ellipsoid_columns_fill( &wide, jobs->ellipsoid, &scratch->columns );
+	ellipsoid_columns_view( &scratch->columns, 1, image->width, &tile_columns );
+	if( !ecef_bounds_compute( image, &geodetic, &tile_columns, jobs->ellipsoid, &bounds ) ) {
+		fprintf( stderr, "Error allocating memory for the bounding volumes of '%s'\n", filename );
 		return false;
 	}
-	if( 1 == fscanf( file, "yllcorner %lf\n", &header->latitude ) )
-		printf( "; lat: %lf\n", header->latitude );
-	else {
-		fputs( "Error reading ascii header lower left y (latitude)\n", stderr );
+	run_stats_add( &scratch->stats, RUN_STAGE_BOUNDS, &timer, num_posts * sizeof(uint16_t), sizeof(bounds), num_posts );
+	stage_timer_start( &timer, true );
+	bool encoded;
+	if( jobs->format == TILE_FORMAT_RAW ) {
+		tile_raw_header_t raw = {
+				.min_height = min_y, .max_height = max_y, .start_col = first_col, .start_row = first_row,
+				.longitude = min_lon, .latitude = min_lat, .cellsize = cellsize
+		};
+		encoded = tile_raw_encode( image, &raw, &scratch->encoded );
+	} else
+		encoded = tile_png_encode( image, jobs->png_profile, &scratch->encoded );
+	if( !encoded ) {
+		fprintf( stderr, "Error encoding image file '%s'\n", filename );
 		return false;
 	}
-	if( header->longitude < -180.0 || header->latitude < -90.0 ||
-		header->longitude > 180.0 || header->latitude > 90.0 ) {
-		fputs( "Error in latitude or longitude; out of bounds\n", stderr );
+	if( !minmax_tree_encode( tree, &scratch->tree_encoded ) ) {
+		fprintf( stderr, "Error encoding min/max quadtree of '%s'\n", filename );
 		return false;
 	}
-	if( 1 == fscanf( file, "cellsize %lf\n", &header->cellsize ) )
-		printf( "Cellsize: %lf arcsec\n", header->cellsize );
-	else {
-		fputs( "Cellsize could not be determined\n", stderr );
+	const double encode_seconds = run_stats_add( &scratch->stats, RUN_STAGE_ENCODE, &timer,
+			(uint64_t)image->width * image->height * sizeof(uint16_t), scratch->encoded.size + scratch->tree_encoded.size,
+			(uint64_t)image->width * image->height );
+	const uint64_t num_bytes = scratch->encoded.size + scratch->tree_encoded.size;
+	fprintf( log, "\t%s %s: %zu bytes, encoded in %.3fs\n", jobs->format == TILE_FORMAT_RAW ? "uint16" :
+			jobs->png_profile->name, tile_format_name( jobs->format ), scratch->encoded.size, encode_seconds );
+	// Relative to input data (beginning 0/0/0), used to calculate texture positions during rendering
+	const uint32_t min_x = first_col;
+	const uint32_t min_z = first_row;
+	const uint32_t max_x = first_col + extent;
+	const uint32_t max_z = first_row + extent;
+	stage_timer_start( &timer, true );
+	if( jobs->pack ) {
+		// The entry carries what the .bb file would
+		tile_pack_entry_t entry = {
+				.tile = jobs->pack_first + tile, .format = jobs->format, .level = jobs->level,
+				.min_x = min_x, .min_z = min_z, .max_x = max_x, .max_z = max_z,
+				.min_height = min_y, .max_height = max_y, .longitude = min_lon, .latitude = min_lat, .ecef = bounds
+		};
+		if( !tile_pack_add( jobs->pack, &entry, scratch->encoded.data, scratch->encoded.size,
+				scratch->tree_encoded.data, scratch->tree_encoded.size ) ) {
+			fprintf( stderr, "Error packing image file '%s'\n", filename );
+			return false;
+		}
+		run_stats_add( &scratch->stats, RUN_STAGE_WRITE, &timer, num_bytes, num_bytes, 0 );
+		fprintf( log, "\tpacked at offset %" PRIu64 "\n", entry.offset );
+		return true;
+	}
+	if( !write_file( filename, &scratch->encoded, "image" ) )
+		return false;
+	// Min/max quadtree next to it
+	snprintf( &filename[strlen(filename)-4], 5, ".mmq" );
+	if( !write_file( filename, &scratch->tree_encoded, "min/max quadtree" ) )
+		return false;
+	fprintf( log, "\tmin/max quadtree: %u levels, %u posts per leaf\n", tree->num_levels, tree->patch_size );
+	// Axis aligned bounding boxes, overwrite ending of filename (1 letter less than be4)
+	sprintf( &filename[strlen(filename)-4], ".bb" );
+	FILE *bb_file = fopen( filename, "w" );
+	if( !bb_file ) {
+		fprintf( stderr, "Error opening bounding box file '%s'\n", filename );
 		return false;
 	}
-	if( 1 == fscanf( file, "NODATA_value %d\n", &header->no_data ) )
-		printf( "No data value: %d\n", header->no_data );
-	else {
-		fputs( "Error reading no data value\n", stderr );
+	fprintf( bb_file, "%u %u %u %u %u %u\n", min_x, min_y, min_z, max_x, max_y, max_z );
+	fprintf( log, "\trelative aabb (%u/%u/%u)/(%u/%u/%u)\n", min_x, min_y, min_z, max_x, max_y, max_z );
+	// Write minimum lon and lat for later caclculation of world coords
+	fprintf( bb_file, "%lf %lf %lf\n", min_lon, min_lat, cellsize );
+	fprintf( log, "\tlower left geodetic coords: lon %lf lat %lf cellsize %lf\n", min_lon, min_lat, cellsize );
+	// Cartesian aabb, sphere and oriented box, see ecef_bounds.h
+	fprintf( bb_file, "%.17g %.17g %.17g %.17g %.17g %.17g\n", bounds.min.x, bounds.min.y, bounds.min.z,
+			bounds.max.x, bounds.max.y, bounds.max.z );
+	fprintf( bb_file, "%.17g %.17g %.17g %.17g\n", bounds.center.x, bounds.center.y, bounds.center.z, bounds.radius );
+	fprintf( bb_file, "%.17g %.17g %.17g", bounds.box_center.x, bounds.box_center.y, bounds.box_center.z );
+	for( unsigned i = 0; i < 3; ++i )
+		fprintf( bb_file, " %.17g %.17g %.17g", bounds.axes[i].x, bounds.axes[i].y, bounds.axes[i].z );
+	fprintf( bb_file, " %.17g %.17g %.17g\n", bounds.half_extents.x, bounds.half_extents.y, bounds.half_extents.z );
+	fprintf( log, "\tcartesian aabb (%.1f/%.1f/%.1f)/(%.1f/%.1f/%.1f), sphere radius %.1f, box (%.1f/%.1f/%.1f)\n",
+			bounds.min.x, bounds.min.y, bounds.min.z, bounds.max.x, bounds.max.y, bounds.max.z, bounds.radius,
+			2.0 * bounds.half_extents.x, 2.0 * bounds.half_extents.y, 2.0 * bounds.half_extents.z );
+	if( fclose(bb_file) != 0 ) {
+		fprintf( stderr, "Error writing bounding box file '%s'\n", filename );
 		return false;
 	}
+	run_stats_add( &scratch->stats, RUN_STAGE_WRITE, &timer, num_bytes, num_bytes, 0 );
+	if( jobs->mesh ) {
+		// Vertices relative to the center of the oriented box, the index buffer is shared by all tiles
+		stage_timer_start( &timer, true );
+		height_grid_t posts;
+		height_grid_view( &scratch->halo, jobs->normal_halo, jobs->normal_halo, image->width + 2, image->height + 2,
+				&posts );
+		if( !tile_mesh_encode( &posts, &geodetic, &scratch->columns, jobs->ellipsoid, &bounds.box_center,
+				jobs->mesh_attributes, &scratch->mesh ) ) {
+			fprintf( stderr, "Error allocating memory for the mesh of '%s'\n", filename );
+			return false;
+		}
+		sprintf( &filename[strlen(filename)-3], ".vtx" );
+		if( !write_file( filename, &scratch->mesh, "vertex" ) )
+			return false;
+		const double mesh_seconds = run_stats_add( &scratch->stats, RUN_STAGE_MESH, &timer,
+				num_posts * sizeof(uint16_t), scratch->mesh.size, num_posts );
+		fprintf( log, "\tvertices: %zu bytes, %u per vertex, in %.3fs\n", scratch->mesh.size,
+				tile_mesh_vertex_size( jobs->mesh_attributes ), mesh_seconds );
+	}
+	if( jobs->normals ) {
+		stage_timer_start( &timer, true );
+		const uint32_t halo = jobs->normal_halo;
+		normal_map_header_t normal_header = {
+				.halo = halo, .start_col = first_col, .start_row = first_row,
+				.longitude = min_lon - halo * cellsize, .latitude = min_lat - halo * cellsize, .cellsize = cellsize
+		};
+		if( !normal_map_encode( &scratch->halo, jobs->ellipsoid, &normal_header, &scratch->normals ) ) {
+			fprintf( stderr, "Error encoding normal map of '%s'\n", filename );
+			return false;
+		}
+		// after .bb or .vtx
+		sprintf( strrchr( filename, '.' ), ".nrm" );
+		if( !write_file( filename, &scratch->normals, "normal map" ) )
+			return false;
+		const uint64_t num_normals = (uint64_t)normal_header.width * normal_header.height;
+		const double normal_seconds = run_stats_add( &scratch->stats, RUN_STAGE_NORMALS, &timer,
+				(uint64_t)scratch->halo.width * scratch->halo.height * sizeof(uint16_t), scratch->normals.size, num_normals );
+		fprintf( log, "\tnormal map: %u/%u posts with a halo of %u, %zu bytes, in %.3fs\n", normal_header.width,
+				normal_header.height, halo, scratch->normals.size, normal_seconds );
+	}
+	if( jobs->manifest )
+		tile_manifest_set( jobs->manifest, jobs->pack_first + tile, hash, TILE_STATE_WRITTEN );
 	return true;
 }
 
-// converts degrees decimal to degrees minutes arcseconds
-static inline void deg2dms( const double dec, uint32_t *deg, uint32_t *min, uint32_t *sec ) {
-	*deg = (uint32_t)floor(dec);
-	double rest_mins = dec - floor(dec);
-	*min = (uint32_t)floor(rest_mins*60.0);
-	double rest_secs = rest_mins - floor(rest_mins*60.0);
-	*sec = (uint32_t)(rest_secs*60.0);
+static bool write_tile_job( void *context, const unsigned worker, const uint32_t job, FILE *log ) {
+	const tile_jobs_t *const jobs = context;
+	return write_tile( jobs, jobs->first_tile + job, &jobs->scratch[worker], log );
 }
 
-void read_image( uint16_t ***image_data, srtm_header_t *header, FILE *in_file ) {
-	// Read whole image into array
-	puts("Reading image data ...");
-	*image_data = malloc(header->num_rows*sizeof(uint16_t *));
-	int value;
-	int min_value = INT_MAX;
-	int max_value = INT_MIN;
-	int value_count = 0;
-	uint32_t num_values = header->num_columns * header->num_rows;
-	for( uint32_t i = 0; i < header->num_rows; ++i ) {
-		(*image_data)[i] = malloc(header->num_columns*sizeof(uint16_t*));
-		for( uint32_t j = 0; j < header->num_columns; ++j ) {
-			fscanf( in_file, "%d", &value );
-			/* Set no data to 0 but this can cause holes in some areas where there is a no data value,
-			 * e.g. on some glaciers or where it was particularly cloudy, which happens in the srtm data.
-			 * Also clip negative values to 0; it is often sea surface.
-			 * Real negative height values below the reference ellipsoid's surface are excluded. */
-			min_value = min_value < value ? min_value : value;
-			max_value = max_value > value ? max_value : value;
-			(*image_data)[i][j] = value < 0 || value == header->no_data ? 0 : (uint16_t)value;
-			++value_count;
+/* Reads the input one strip of tiles at a time and writes the strip's tiles before reading on,
+ * so only tilesize rows of the input are held in memory. Consecutive strips share one row. */
+bool convert_streaming( tile_jobs_t *jobs, row_source_t *source,
+		const uint32_t num_h_tiles, const uint32_t num_v_tiles, const unsigned num_threads, run_stats_t *run_stats ) {
+	const srtm_header_t *const header = jobs->header;
+	const uint32_t tilesize = header->tilesize;
+	height_grid_t band;
+	if( !height_grid_create( header->num_columns, tilesize, true, &band ) ) {
+		fputs( "Error allocating memory for a strip of tiles\n", stderr );
+		return false;
+	}
+	printf( "Streaming strips of %u rows, %.1f MB resident\n", tilesize,
+			(double)( band.alloc_size + num_threads * jobs->scratch[0].image.alloc_size ) * 1e-6 );
+	asc_parse_stats_t stats;
+	asc_parse_stats_init( &stats );
+	bool ok = true;
+	for( uint32_t v_tile = 0; ok && v_tile < num_v_tiles; ++v_tile ) {
+		const uint32_t first_row = jobs->start_row[v_tile*num_h_tiles];
+		uint32_t band_row = 0;
+		if( v_tile > 0 ) {
+			// The last row of the previous strip is the first of this one
+			memcpy( height_grid_row( &band, 0 ), height_grid_row( &band, tilesize - 1 ),
+					header->num_columns * sizeof(uint16_t) );
+			band_row = 1;
+		}
+		stage_timer_t timer;
+		stage_timer_start( &timer, false );
+		const uint64_t first_byte = row_source_bytes( source );
+		const uint64_t first_value = stats.value_count;
+		ok = read_rows( source, &band, band_row, tilesize - band_row, first_row + band_row,
+				header, num_threads, &stats );
+		run_stats_add( run_stats, RUN_STAGE_PARSE, &timer, row_source_bytes( source ) - first_byte,
+				(uint64_t)( tilesize - band_row ) * header->num_columns * sizeof(uint16_t), stats.value_count - first_value );
+		jobs->image_data = &band;
+		jobs->first_row = first_row;
+		jobs->first_tile = v_tile*num_h_tiles;
+		ok = ok && tile_pool_run( num_threads, num_h_tiles, write_tile_job, jobs );
+	}
+	printf( "Read %" PRIu64 " values; min %d; max %d; %" PRIu64 " no data; %" PRIu64 " negative\n", stats.value_count,
+			stats.min_value, stats.max_value, stats.no_data_count, stats.negative_count );
+	height_grid_destroy( &band );
+	return ok;
+}
+
+/* Builds the coarser levels one after the other, each from the level below, and writes their tiles.
+ * Tile h/v of a level covers tiles 2h..2h+1/2v..2v+1 of the level below; its min/max quadtree
+ * leaves start out with the bounds of theirs, so they hold the source data whichever filter is used. */
+bool write_lod_levels( tile_jobs_t *jobs, const height_grid_t *image_data, const uint32_t num_h_tiles,
+		const uint32_t num_v_tiles, const lod_filter_t filter, const unsigned num_threads, run_stats_t *run_stats ) {
+	const uint32_t step = jobs->header->tilesize - 1;
+	const uint32_t num_levels = lod_num_levels( num_h_tiles, num_v_tiles );
+	height_grid_t grids[2];
+	// the level grid below, once it is not the input
+	height_grid_t *below = NULL;
+	const minmax_tree_t *const tree = &jobs->scratch[0].tree;
+	const size_t num_leaves = (size_t)tree->leaves * tree->leaves;
+	uint16_t *leaves = NULL;
+	bool ok = true;
+	for( uint32_t level = 1; ok && level < num_levels; ++level ) {
+		const uint32_t below_h = lod_level_tiles( num_h_tiles, level - 1 );
+		const uint32_t below_v = lod_level_tiles( num_v_tiles, level - 1 );
+		const uint32_t num_h = lod_level_tiles( num_h_tiles, level );
+		const uint32_t num_v = lod_level_tiles( num_v_tiles, level );
+		const uint32_t num_tiles = num_h * num_v;
+		height_grid_t *grid = &grids[level & 1];
+		printf( "Level %u: %u/%u tiles, %s filter ...\n", level, num_h, num_v, lod_filter_name( filter ) );
+		if( !height_grid_create( num_h * step + 1, num_v * step + 1, true, grid ) ) {
+			fputs( "Error allocating memory for level of detail\n", stderr );
+			ok = false;
+			break;
+		}
+		const height_grid_t *const source = below ? below : image_data;
+		stage_timer_t timer;
+		stage_timer_start( &timer, false );
+		ok = lod_downsample( source, filter, grid, num_threads );
+		run_stats_add( run_stats, RUN_STAGE_LOD, &timer, (uint64_t)source->width * source->height * sizeof(uint16_t),
+				(uint64_t)grid->width * grid->height * sizeof(uint16_t), (uint64_t)grid->width * grid->height );
+		if( below )
+			height_grid_destroy( below );
+		below = grid;
+		uint16_t *level_leaves = malloc( 2 * num_tiles * num_leaves * sizeof(uint16_t) );
+		if( !ok || !level_leaves ) {
+			free( level_leaves );
+			ok = false;
+			break;
 		}
+		uint32_t start_row[num_tiles];
+		uint32_t start_col[num_tiles];
+		for( uint32_t v = 0; v < num_v; ++v ) {
+			for( uint32_t h = 0; h < num_h; ++h ) {
+				const uint32_t tile = v * num_h + h;
+				start_row[tile] = v * step;
+				start_col[tile] = h * step;
+				const uint16_t *child_min[4] = { NULL };
+				const uint16_t *child_max[4] = { NULL };
+				for( uint32_t i = 0; i < 4; ++i ) {
+					const uint32_t child_v = 2 * v + i / 2;
+					const uint32_t child_h = 2 * h + i % 2;
+					if( child_v < below_v && child_h < below_h ) {
+						child_min[i] = jobs->leaf_min + ( child_v * below_h + child_h ) * num_leaves;
+						child_max[i] = jobs->leaf_max + ( child_v * below_h + child_h ) * num_leaves;
+					}
+				}
+				minmax_tree_leaves_from_children( jobs->header->tilesize, tree, child_min, child_max,
+						level_leaves + tile * num_leaves, level_leaves + ( num_tiles + tile ) * num_leaves );
+			}
+		}
+		free( leaves );
+		leaves = level_leaves;
+		jobs->pack_first += below_h * below_v;
+		jobs->level = level;
+		jobs->num_h_tiles = num_h;
+		jobs->num_v_tiles = num_v;
+		jobs->start_row = start_row;
+		jobs->start_col = start_col;
+		jobs->image_data = grid;
+		jobs->leaf_min = leaves;
+		jobs->leaf_max = leaves + num_tiles * num_leaves;
+		ok = tile_pool_run( num_threads, num_tiles, write_tile_job, jobs );
 	}
-	printf("Read %d of %d value; min %d; max %d\n", value_count, num_values, min_value, max_value );
+	if( below )
+		height_grid_destroy( below );
+	free( leaves );
+	return ok;
 }
 
-void free_image_data( uint16_t **image_data, srtm_header_t *header ) {
-	for( uint32_t i = 0; i < header->num_rows; ++i )
-		free(image_data[i]);
-	free(image_data);
+// A tile asked for with --tile, counted from the north west
+typedef struct tile_request_t {
+	uint32_t tx;
+	uint32_t ty;
+	uint32_t level;
+} tile_request_t;
+
+// The index buffer the meshes of all tiles of this size share
+static bool write_mesh_indices( const uint32_t tilesize ) {
+	char filename[40];
+	snprintf( filename, sizeof(filename), "tile_%u.idx", tilesize );
+	byte_buffer_t indices;
+	byte_buffer_init( &indices );
+	if( !tile_mesh_encode_indices( tilesize, tilesize, &indices ) ) {
+		fputs( "Error allocating memory for the mesh indices\n", stderr );
+		byte_buffer_free( &indices );
+		return false;
+	}
+	const bool ok = write_file( filename, &indices, "index" );
+	if( ok )
+		printf( "Wrote mesh indices to '%s', %zu bytes\n", filename, indices.size );
+	byte_buffer_free( &indices );
+	return ok;
 }
 
-/* Calculate start rows/columns for each tile. The last column/top row must overlap so that the new one
- * starts on the row/column on which the old one ended or there will be gaps between tiles when rendering.
- * @fixme: Apart from this tiles should overlap by 1 on each side because of normal calculation from
- * averaging over adjacent posts and sobel filtering. See shaders of terrain lod. */
-void write_tile( const uint32_t tile, const srtm_header_t *const header,
-		const uint32_t *const start_row, const uint32_t *const start_col,
-		uint16_t *const *const image_data, uint16_t **image ) {
-	uint16_t min_y = 65535;
-	uint16_t max_y = 0;
-	for( uint32_t row = start_row[tile]; row < start_row[tile]+header->tilesize; ++row ) {
-		for( uint32_t col = start_col[tile]; col < start_col[tile]+header->tilesize; ++col ) {
-			const uint16_t value = image_data[col][row];
-			image[col-start_col[tile]][row-start_row[tile]] = value;
-			min_y = min_y > value ? value : min_y;
-			max_y = max_y < value ? value : max_y;
+/* Writes only the requested tiles, made on demand by a virtual raster that parses just the input
+ * rows they need instead of the whole input. Quadtrees of coarser levels also get the leaves of
+ * the tiles below from the raster, so all outputs are those of --lod. Opening the raster counts
+ * as its header stage, making a tile as parsing. */
+static bool write_requested_tiles( const char *const path, const bool use_mosaic, const uint32_t tilesize,
+		const tile_request_t *const requests, const uint32_t num_requests, const lod_filter_t filter,
+		const size_t cache_bytes, const tile_format_t format, const png_profile_t *const png_profile,
+		const char *const pack_path, const bool use_grid_cache, const ellipsoid_t *const ellipsoid,
+		const bool mesh, const uint32_t mesh_attributes, const bool normals, const uint32_t normal_halo,
+		const unsigned num_threads, run_stats_t *run_stats ) {
+	stage_timer_t timer;
+	stage_timer_start( &timer, false );
+	virtual_raster_t raster;
+	if( !virtual_raster_open( path, use_mosaic, tilesize, filter, cache_bytes, num_threads, use_grid_cache, &raster ) )
+		return false;
+	const double open_seconds = run_stats_add( run_stats, RUN_STAGE_HEADER, &timer, 0, 0, 0 );
+	printf( "Indexed '%s' in %.3fs: %u/%u tiles, %u levels, %s filter, cache %zu MB\n", path, open_seconds,
+			raster.num_h_tiles, raster.num_v_tiles, raster.num_levels, lod_filter_name( filter ), cache_bytes >> 20 );
+	const uint32_t step = tilesize - 1;
+	// Levels are never larger than level 0
+	const uint32_t num_tiles = raster.num_h_tiles * raster.num_v_tiles;
+	uint32_t start_row[num_tiles];
+	uint32_t start_col[num_tiles];
+	height_grid_t tile;
+	tile_scratch_t scratch;
+	bool ok = height_grid_create( tilesize, tilesize, false, &tile );
+	ok &= height_grid_create( tilesize, tilesize, false, &scratch.image );
+	byte_buffer_init( &scratch.encoded );
+	ok &= minmax_tree_create( tilesize, MINMAX_TREE_PATCH_SIZE, &scratch.tree );
+	byte_buffer_init( &scratch.tree_encoded );
+	byte_buffer_init( &scratch.mesh );
+	ok &= ellipsoid_columns_create( tilesize + 2, &scratch.columns );
+	scratch.halo = (height_grid_t){ 0 };
+	if( mesh || normals )
+		ok &= height_grid_create( tilesize + 2 * normal_halo + 2, tilesize + 2 * normal_halo + 2, false, &scratch.halo );
+	byte_buffer_init( &scratch.normals );
+	run_stats_init( &scratch.stats );
+	scratch.num_skipped = 0;
+	// With meshes or normal maps the tile and those around it, the halo reads their posts
+	height_grid_t area = { 0 };
+	if( mesh || normals )
+		ok &= height_grid_create( 3 * step + 1, 3 * step + 1, false, &area );
+	const size_t num_leaves = (size_t)scratch.tree.leaves * scratch.tree.leaves;
+	uint16_t *leaves = malloc( 2 * num_tiles * num_leaves * sizeof(uint16_t) );
+	ok &= leaves != NULL;
+	// The container's index has every tile down to the coarsest level asked for, those not written are missing
+	uint32_t num_packed = 0;
+	for( uint32_t i = 0; i < num_requests; ++i ) {
+		uint32_t packed = 0;
+		for( uint32_t level = 0; level <= requests[i].level && level < raster.num_levels; ++level ) {
+			uint32_t num_h, num_v;
+			virtual_raster_level_tiles( &raster, level, &num_h, &num_v );
+			packed += num_h * num_v;
 		}
+		num_packed = packed > num_packed ? packed : num_packed;
 	}
-	char filename[30] = "tile_";
-	sprintf( &filename[5], "%u", header->tilesize );
-	sprintf( &filename[9], "_%u.png", tile+1 );
-	// print writing image x of y
-	printf( "Writing image file '%s'\n", filename );
-	png_structp png_stru = png_create_write_struct( PNG_LIBPNG_VER_STRING, NULL, NULL, NULL );
-	if( !png_stru ) {
-		fputs( "Error creating png struct", stderr );
-		return;
-	}
-	png_infop png_inf = png_create_info_struct( png_stru );
-	if( !png_inf ) {
-		fputs( "Error creating png info struct", stderr );
-		png_destroy_write_struct( &png_stru, &png_inf );
-		return;
-	}
-	FILE *image_file = fopen( filename, "wb" );
-	png_init_io( png_stru, image_file );
-	png_set_IHDR(
-			png_stru, png_inf, header->tilesize, header->tilesize, 16, PNG_COLOR_TYPE_GRAY,
-			PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT
-	);
-	png_write_info( png_stru, png_inf );
-	// Mind endianess
-	png_set_swap( png_stru );
-	for( uint32_t i = 0; i < header->tilesize; ++i )
-		png_write_row( png_stru, (png_const_bytep)&image[i][0] );
-	png_write_end( png_stru, png_inf );
-	//png_destroy_write_struct( &png_stru, (png_infopp)NULL );
-	png_destroy_write_struct( &png_stru, &png_inf );
-	fclose(image_file);
-	// Axis aligned bounding boxes, overwrite ending of filename (1 letter less than be4)
-	sprintf( &filename[strlen(filename)-4], ".bb" );
-	FILE *bb_file = fopen( filename, "w" );
-	// Relative to input data (beginning 0/0/0), used to calculate texture positions during rendering
-	const uint32_t min_x = start_col[tile];
-	const uint32_t min_z = start_row[tile];
-	const uint32_t max_x = header->tilesize - 1 + start_col[tile];
-	const uint32_t max_z = header->tilesize - 1 + start_row[tile];
-	fprintf( bb_file, "%u %u %u %u %u %u\n", min_x, min_y, min_z, max_x, max_y, max_z );
-	printf( "\trelative aabb (%u/%u/%u)/(%u/%u/%u)\n", min_x, min_y, min_z, max_x, max_y, max_z );
-	/* @todo Construct real world bounding box minimum and maximum from geodetic coordinates as follows:
-	 * geodetic lower left x + startColumn[tileNumber] * geodetic cellsize,
-	 * minimum height,
-	 * geodetic lower left y + startRow[tileNumber] * geodetic cellsize,
-	 * geodetic lower left x + startColumn[tileNumber] * geodetic cellsize + (tilesize-1) * geodetic cellsize,
-	 * maximum height,
-	 * geodetic lower left y + startRow[tileNumber] * geodetic cellsize + (tilesize-1) * geodetic cellsize */
-	const double min_lon = header->longitude + (double)start_col[tile] * header->cellsize;
-	const double min_lat = header->latitude + (double)start_row[tile] * header->cellsize;
-	// Write minimum lon and lat for later caclculation of world coords
-	fprintf( bb_file, "%lf %lf %lf\n", min_lon, min_lat, header->cellsize );
-	printf( "\tlower left geodetic coords: lon %lf lat %lf cellsize %lf\n", min_lon, min_lat, header->cellsize );
-	fclose(bb_file);
+	tile_pack_t pack;
+	tile_jobs_t jobs = {
+			.header = &raster.header, .start_row = start_row, .start_col = start_col, .image_data = &tile,
+			.format = format, .png_profile = png_profile, .ellipsoid = ellipsoid,
+			.mesh = mesh, .mesh_attributes = mesh_attributes, .normals = normals, .normal_halo = normal_halo,
+			.pack = pack_path ? &pack : NULL, .leaf_min = leaves, .leaf_max = leaves + num_tiles * num_leaves,
+			.scratch = &scratch
+	};
+	if( !ok ) {
+		fputs( "Error allocating memory for tile data\n", stderr );
+		jobs.pack = NULL;
+	} else if( jobs.pack && !tile_pack_create( pack_path, &raster.header, num_packed, &pack ) ) {
+		fprintf( stderr, "Error creating tile container '%s'\n", pack_path );
+		jobs.pack = NULL;
+		ok = false;
+	}
+	for( uint32_t i = 0; ok && i < num_requests; ++i ) {
+		const tile_request_t *const request = &requests[i];
+		uint32_t num_h, num_v;
+		virtual_raster_level_tiles( &raster, request->level, &num_h, &num_v );
+		const uint32_t n = request->ty * num_h + request->tx;
+		stage_timer_start( &timer, false );
+		const uint64_t first_value = raster.stats.value_count;
+		// Coarser levels' leaves hold the source data below, as those of --lod
+		if( !( ok = virtual_raster_tile( &raster, request->tx, request->ty, request->level, &tile ) &&
+				virtual_raster_leaves_below( &raster, request->tx, request->ty, request->level, &scratch.tree,
+						jobs.leaf_min + n * num_leaves, jobs.leaf_max + n * num_leaves ) ) )
+			break;
+		printf( "Tile %u/%u of level %u made in %.3fs\n", request->tx, request->ty, request->level,
+				run_stats_add( run_stats, RUN_STAGE_PARSE, &timer, 0, (uint64_t)tilesize * tilesize * sizeof(uint16_t),
+						raster.stats.value_count - first_value ) );
+		jobs.pack_first = 0;
+		for( uint32_t level = 0; level < request->level; ++level ) {
+			uint32_t level_h, level_v;
+			virtual_raster_level_tiles( &raster, level, &level_h, &level_v );
+			jobs.pack_first += level_h * level_v;
+		}
+		start_row[n] = request->ty * step;
+		start_col[n] = request->tx * step;
+		jobs.first_row = start_row[n];
+		jobs.first_col = start_col[n];
+		jobs.level = request->level;
+		jobs.num_h_tiles = num_h;
+		jobs.num_v_tiles = num_v;
+		if( mesh || normals ) {
+			// The neighbours there are at this level, the halo doesn't reach further than one tile
+			const uint32_t h0 = request->tx > 0 ? request->tx - 1 : 0;
+			const uint32_t v0 = request->ty > 0 ? request->ty - 1 : 0;
+			const uint32_t h1 = request->tx + 1 < num_h ? request->tx + 1 : request->tx;
+			const uint32_t v1 = request->ty + 1 < num_v ? request->ty + 1 : request->ty;
+			for( uint32_t v = v0; ok && v <= v1; ++v )
+				for( uint32_t h = h0; ok && h <= h1; ++h ) {
+					if( !( ok = virtual_raster_tile( &raster, h, v, request->level, &tile ) ) )
+						break;
+					height_grid_t view;
+					uint16_t lo, hi;
+					height_grid_view( &area, ( h - h0 ) * step, ( v - v0 ) * step, tilesize, tilesize, &view );
+					height_grid_copy_window( &tile, 0, 0, &view, &lo, &hi );
+				}
+			if( !ok )
+				break;
+			jobs.image_data = &area;
+			jobs.first_row = v0 * step;
+			jobs.first_col = h0 * step;
+		}
+		ok = write_tile( &jobs, n, &scratch, stdout );
+	}
+	if( jobs.pack ) {
+		if( !tile_pack_finish( &pack ) ) {
+			fprintf( stderr, "Error writing index of tile container '%s'\n", pack_path );
+			ok = false;
+		} else if( ok )
+			printf( "Packed %u tiles into '%s'\n", num_requests, pack_path );
+	}
+	printf( "Cache: %" PRIu64 " hits, %" PRIu64 " misses, %" PRIu64 " evictions; read %" PRIu64 " values\n",
+			raster.hits, raster.misses, raster.evictions, raster.stats.value_count );
+	run_stats_merge( run_stats, &scratch.stats );
+	free( leaves );
+	height_grid_destroy( &tile );
+	height_grid_destroy( &scratch.image );
+	byte_buffer_free( &scratch.encoded );
+	minmax_tree_destroy( &scratch.tree );
+	byte_buffer_free( &scratch.tree_encoded );
+	byte_buffer_free( &scratch.mesh );
+	ellipsoid_columns_destroy( &scratch.columns );
+	height_grid_destroy( &scratch.halo );
+	byte_buffer_free( &scratch.normals );
+	height_grid_destroy( &area );
+	virtual_raster_close( &raster );
+	return ok;
+}
+
+static bool write_stats( const run_stats_t *const stats, const char *const path, const struct timespec *const start,
+		const char *const input, const uint32_t tilesize, const unsigned num_threads, const tile_format_t format,
+		const png_profile_t *const png_profile ) {
+	if( !run_stats_write_json( stats, path, start, input, tilesize, num_threads, tile_format_name( format ),
+			format == TILE_FORMAT_PNG ? png_profile->name : NULL ) )
+		return false;
+	printf( "Wrote stats to '%s'\n", path );
+	return true;
+}
+
+/* The manifest of the tiles written for this raster and these encoding parameters, without the
+ * last run's hashes with rebuild set */
+static bool open_manifest( const srtm_header_t *const header, const tile_format_t format,
+		const png_profile_t *const png_profile, const char *const lod_filter, const ellipsoid_t *const ellipsoid,
+		const bool mesh, const uint32_t mesh_attributes, const bool normals, const uint32_t normal_halo,
+		const bool rebuild, const uint32_t num_tiles, tile_manifest_t *manifest ) {
+	char path[40];
+	char params[256];
+	snprintf( path, sizeof(path), "tile_%u.manifest", header->tilesize );
+	snprintf( params, sizeof(params), "tilesize %u format %s png %s lod %s columns %u rows %u "
+			"longitude %.17g latitude %.17g cellsize %.17g radii %.17g %.17g %.17g", header->tilesize,
+			tile_format_name( format ), format == TILE_FORMAT_PNG ? png_profile->name : "-", lod_filter,
+			header->num_columns, header->num_rows, header->longitude, header->latitude, header->cellsize,
+			ellipsoid->radii.x, ellipsoid->radii.y, ellipsoid->radii.z );
+	// Runs without meshes or normal maps keep the manifests of before
+	if( mesh )
+		snprintf( &params[strlen(params)], sizeof(params) - strlen(params), " mesh %u", mesh_attributes );
+	if( normals )
+		snprintf( &params[strlen(params)], sizeof(params) - strlen(params), " normals %u", normal_halo );
+	return tile_manifest_open( path, params, num_tiles, !rebuild, manifest );
+}
+
+static void print_usage( const char *const name ) {
+	fprintf( stderr, "Usage: '%s [options] <ascii input file> <tilesize> <semi major axes> <semi minor axis>'\n"
+			"\t--stream     read and convert one strip of tiles at a time, for inputs larger than memory\n"
+			"\t--threads N  threads for parsing and tile encoding, default is the number of cpus\n"
+			"\t--png P      png compression profile fastest, balanced (default) or smallest\n"
+			"\t--format F   tile format png (default) or raw, little endian uint16 with a header\n"
+			"\t--pack FILE  write all tiles and their bounding boxes into one container file\n"
+			"\t--lod F      also write coarser levels down to one tile, filter box or max; not with --stream\n"
+			"\t--mosaic     the input file lists ascii files, one per line, to put together into one raster\n"
+			"\t--tile T     write only tile TX,TY[,LEVEL], parsing just the rows it needs; may be repeated\n"
+			"\t--cache MB   memory for tiles kept between --tile requests, default 256\n"
+			"\t--no-grid-cache  neither use nor save the parsed grid as <input>.int16 for later runs\n"
+			"\t--bbox LON_MIN LAT_MIN LON_MAX LAT_MAX  tile only the posts covering this extent, in degrees\n"
+			"\t--window COL ROW WIDTH HEIGHT  tile only this window of posts, counted from the north west\n"
+			"\t--rebuild    write all tiles, also those unchanged since the last run\n"
+			"\t--stats FILE write time, throughput and memory use of each stage as json\n"
+			"\t--skip-void P  do not write tiles with at least P percent of no data or sea posts, 1 to 100\n"
+			"\t--mesh A     also write a vertex buffer per tile, A is position or a list of position, normal, uv\n"
+			"\t--normals H  also write a normal map per tile with a halo of H posts around it, 0 to 128\n", name );
 }
 
 int main( int argc, char *argv[argc+1] ) {
 	puts("Converter starting ...");
+	struct timespec run_start;
+	clock_gettime( CLOCK_MONOTONIC, &run_start );
+	run_stats_t run_stats;
+	run_stats_init( &run_stats );
+	const char *stats_path = NULL;
 	uint32_t tilesize = 2048;
 	double semi_major = 6378137.0;
 	double semi_minor = 6356752.314245;
+	bool streaming = false;
+	tile_format_t format = TILE_FORMAT_PNG;
+	const png_profile_t *png_profile = png_profile_default();
+	const char *pack_path = NULL;
+	bool lod = false;
+	bool use_mosaic = false;
+	lod_filter_t lod_filter = LOD_FILTER_BOX;
+	tile_request_t *requests = NULL;
+	uint32_t num_requests = 0;
+	size_t cache_bytes = (size_t)256 << 20;
+	bool use_grid_cache = true;
+	bool rebuild = false;
+	uint32_t skip_void = 0;
+	bool mesh = false;
+	uint32_t mesh_attributes = 0;
+	bool normals = false;
+	uint32_t normal_halo = 0;
+	// Region of interest, a geodetic extent or a window of posts
+	bool use_bbox = false;
+	bool use_window = false;
+	geodetic_extent_t bbox;
+	uint32_t window[4];
+	const long num_cpus = sysconf( _SC_NPROCESSORS_ONLN );
+	unsigned num_threads = num_cpus > 0 ? (unsigned)num_cpus : 1;
+	static const struct option long_options[] = {
+			{ "stream", no_argument, NULL, 's' },
+			{ "threads", required_argument, NULL, 't' },
+			{ "png", required_argument, NULL, 'p' },
+			{ "format", required_argument, NULL, 'f' },
+			{ "pack", required_argument, NULL, 'k' },
+			{ "lod", required_argument, NULL, 'l' },
+			{ "mosaic", no_argument, NULL, 'm' },
+			{ "tile", required_argument, NULL, 'T' },
+			{ "cache", required_argument, NULL, 'c' },
+			{ "no-grid-cache", no_argument, NULL, 'n' },
+			{ "bbox", required_argument, NULL, 'b' },
+			{ "window", required_argument, NULL, 'w' },
+			{ "rebuild", no_argument, NULL, 'r' },
+			{ "stats", required_argument, NULL, 'S' },
+			{ "skip-void", required_argument, NULL, 'v' },
+			{ "mesh", required_argument, NULL, 'M' },
+			{ "normals", required_argument, NULL, 'N' },
+			{ NULL, 0, NULL, 0 }
+	};
+	int option;
+	while( ( option = getopt_long( argc, argv, "", long_options, NULL ) ) != -1 ) {
+		switch( option ) {
+		case 's':
+			streaming = true;
+			break;
+		case 't':
+			num_threads = (unsigned)strtoul( optarg, NULL, 10 );
+			if( num_threads < 1 || num_threads > 1024 ) {
+				fprintf( stderr, "Number of threads must be between 1 and 1024, is '%s'\n", optarg );
+				free( requests );
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'p':
+			if( !( png_profile = png_profile_find( optarg ) ) ) {
+				fprintf( stderr, "Png profile must be fastest, balanced or smallest, is '%s'\n", optarg );
+				free( requests );
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'f':
+			if( !tile_format_find( optarg, &format ) ) {
+				fprintf( stderr, "Tile format must be png or raw, is '%s'\n", optarg );
+				free( requests );
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'k':
+			pack_path = optarg;
+			break;
+		case 'l':
+			if( !( lod = lod_filter_find( optarg, &lod_filter ) ) ) {
+				fprintf( stderr, "Level of detail filter must be box or max, is '%s'\n", optarg );
+				free( requests );
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'm':
+			use_mosaic = true;
+			break;
+		case 'T': {
+			tile_request_t request = { 0, 0, 0 };
+			tile_request_t *more = realloc( requests, ( num_requests + 1 ) * sizeof(tile_request_t) );
+			if( !more || sscanf( optarg, "%u,%u,%u", &request.tx, &request.ty, &request.level ) < 2 ) {
+				fprintf( stderr, "Tile must be given as TX,TY or TX,TY,LEVEL, is '%s'\n", optarg );
+				free( more ? more : requests );
+				return EXIT_FAILURE;
+			}
+			requests = more;
+			requests[num_requests++] = request;
+			break;
+		}
+		case 'c':
+			cache_bytes = (size_t)strtoul( optarg, NULL, 10 ) << 20;
+			if( cache_bytes == 0 ) {
+				fprintf( stderr, "Cache size must be > 0 MB, is '%s'\n", optarg );
+				free( requests );
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'n':
+			use_grid_cache = false;
+			break;
+		case 'r':
+			rebuild = true;
+			break;
+		case 'S':
+			stats_path = optarg;
+			break;
+		case 'v':
+			skip_void = (uint32_t)strtoul( optarg, NULL, 10 );
+			if( skip_void < 1 || skip_void > 100 ) {
+				fprintf( stderr, "Percentage of no data or sea posts must be between 1 and 100, is '%s'\n", optarg );
+				free( requests );
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'M':
+			if( !( mesh = tile_mesh_parse_attributes( optarg, &mesh_attributes ) ) ) {
+				fprintf( stderr, "Mesh attributes must be a list of position, normal and uv, is '%s'\n", optarg );
+				free( requests );
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'N': {
+			char *end;
+			normal_halo = (uint32_t)strtoul( optarg, &end, 10 );
+			if( end == optarg || *end != '\0' || normal_halo > 128 ) {
+				fprintf( stderr, "Normal map halo must be between 0 and 128 posts, is '%s'\n", optarg );
+				free( requests );
+				return EXIT_FAILURE;
+			}
+			normals = true;
+			break;
+		}
+		case 'b':
+		case 'w': {
+			// Four values, optarg and the three behind it
+			double values[4];
+			bool valid = optind + 3 <= argc;
+			for( int i = 0; valid && i < 4; ++i ) {
+				const char *const text = i == 0 ? optarg : argv[optind + i - 1];
+				char *end;
+				values[i] = strtod( text, &end );
+				valid = end != text && *end == '\0';
+			}
+			if( valid && option == 'b' ) {
+				const geodetic_t south_west = { values[0], values[1], 0.0 };
+				const geodetic_t north_east = { values[2], values[3], 0.0 };
+				geodetic_extent_create( &south_west, &north_east, &bbox );
+				use_bbox = valid = values[2] > values[0] && values[3] > values[1];
+			} else if( valid ) {
+				for( int i = 0; valid && i < 4; ++i ) {
+					valid = values[i] >= 0.0 && values[i] <= UINT32_MAX && values[i] == floor( values[i] );
+					window[i] = valid ? (uint32_t)values[i] : 0;
+				}
+				use_window = valid = valid && window[2] > 0 && window[3] > 0;
+			}
+			if( !valid ) {
+				if( option == 'b' )
+					fputs( "Bounding box must be LON_MIN LAT_MIN LON_MAX LAT_MAX with min < max\n", stderr );
+				else
+					fputs( "Window must be COL ROW WIDTH HEIGHT, whole numbers with width and height > 0\n", stderr );
+				free( requests );
+				return EXIT_FAILURE;
+			}
+			optind += 3;
+			break;
+		}
+		default:
+			print_usage( argv[0] );
+			free( requests );
+			return EXIT_FAILURE;
+		}
+	}
+	if( lod && streaming ) {
+		fputs( "Levels of detail are built from the whole input, they can't be combined with --stream\n", stderr );
+		free( requests );
+		return EXIT_FAILURE;
+	}
+	if( num_requests > 0 && streaming ) {
+		fputs( "Requested tiles are read at random, they can't be combined with --stream\n", stderr );
+		free( requests );
+		return EXIT_FAILURE;
+	}
+	if( ( mesh || normals ) && pack_path ) {
+		fputs( "Meshes and normal maps are written as files next to the tiles, they can't be combined with --pack\n",
+				stderr );
+		free( requests );
+		return EXIT_FAILURE;
+	}
+	if( ( mesh || normals ) && streaming ) {
+		fputs( "Meshes and normal maps read the posts of the neighbouring tiles, they can't be combined with --stream\n",
+				stderr );
+		free( requests );
+		return EXIT_FAILURE;
+	}
+	const bool crop = use_bbox || use_window;
+	if( use_bbox && use_window ) {
+		fputs( "Give either --bbox or --window, not both\n", stderr );
+		free( requests );
+		return EXIT_FAILURE;
+	}
+	if( crop && num_requests > 0 ) {
+		fputs( "Requested tiles count from the whole raster, they can't be combined with --bbox or --window\n", stderr );
+		free( requests );
+		return EXIT_FAILURE;
+	}
+	// Positional arguments
+	char **args = &argv[optind-1];
+	const int num_args = argc - optind + 1;
 	char *temp;
-	if( argc > 2 ) {
-		tilesize = (uint32_t)strtoimax( argv[2], &temp, 10 );
+	if( num_args > 2 ) {
+		tilesize = (uint32_t)strtoimax( args[2], &temp, 10 );
 		if( !is_pow2u( tilesize ) || tilesize < 256 || tilesize > 16384 ) {
-			fprintf( stderr, "Tilesize must be power of 2 and between 256 and 16384, is '%s'\n", argv[3] );
+			fprintf( stderr, "Tilesize must be power of 2 and between 256 and 16384, is '%s'\n", args[2] );
+			free( requests );
 			return EXIT_FAILURE;
 		}
 	}
-	if( argc == 5 ) {
-		semi_major = strtod( argv[3], &temp );
+	if( num_args == 5 ) {
+		semi_major = strtod( args[3], &temp );
 		if( semi_major <= 0.0 ) {
-			fprintf( stderr, "Semi major axis must be > 0.0, is '%s'\n", argv[3] );
+			fprintf( stderr, "Semi major axis must be > 0.0, is '%s'\n", args[3] );
+			free( requests );
 			return EXIT_FAILURE;
 		}
-		semi_minor = strtod( argv[4], &temp );
+		semi_minor = strtod( args[4], &temp );
 		if( semi_minor <= 0.0 || semi_minor > semi_major ) {
-			fprintf( stderr, "Semi minor axis must be > 0.0 and smaller than semi major axes, is '%s'\n", argv[4] );
+			fprintf( stderr, "Semi minor axis must be > 0.0 and smaller than semi major axes, is '%s'\n", args[4] );
+			free( requests );
 			return EXIT_FAILURE;
 		}
-	} else if( argc != 3 ) {
-		fprintf( stderr, "Usage: '%s <ascii input file> <tilesize> <semi major axes> <semi minor axis>\n", argv[0] );
+	} else if( num_args != 3 ) {
+		print_usage( argv[0] );
+		free( requests );
 		return EXIT_FAILURE;
 	}
-	FILE *in_file;
-	if( !(in_file = fopen( argv[1], "r" )) ) {
-		fprintf( stderr, "Error opening input file '%s'\n", argv[1] );
+	ellipsoid_t eps;
+	ellipsoid_create( semi_major, semi_major, semi_minor, &eps );
+	if( mesh && !write_mesh_indices( tilesize ) ) {
+		free( requests );
 		return EXIT_FAILURE;
 	}
-	printf( "Converting '%s':\nTilesize %d\nEllipsoid (%lf/%lf)\n\n", argv[1], tilesize, semi_major, semi_minor );
+	if( num_requests > 0 ) {
+		const bool ok = write_requested_tiles( args[1], use_mosaic, tilesize, requests, num_requests, lod_filter,
+				cache_bytes, format, png_profile, pack_path, use_grid_cache, &eps, mesh, mesh_attributes,
+				normals, normal_halo, num_threads, &run_stats );
+		free( requests );
+		if( stats_path && !write_stats( &run_stats, stats_path, &run_start, args[1], tilesize, num_threads, format,
+				png_profile ) )
+			return EXIT_FAILURE;
+		puts("\nConverter ending.");
+		return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+	input_file_t in_file;
+	mosaic_t mosaic;
+	grid_cache_t grid_cache;
+	row_source_t source = { &in_file, NULL, use_mosaic ? &mosaic : NULL, NULL, false, 0, 0 };
+	// Opening the input and reading its header, or mapping and verifying the grid cache
+	stage_timer_t header_timer;
+	stage_timer_start( &header_timer, false );
+	// A grid parsed in an earlier run is mapped instead of parsing again
+	uint64_t fingerprint = 0;
+	use_grid_cache = use_grid_cache && strcmp( args[1], "-" ) != 0 &&
+			grid_cache_fingerprint( args[1], use_mosaic, &fingerprint );
+	struct timespec cache_start;
+	clock_gettime( CLOCK_MONOTONIC, &cache_start );
+	if( use_grid_cache && grid_cache_open( args[1], fingerprint, true, &grid_cache ) ) {
+		printf( "Mapped and verified the grid parsed before from '%s.int16' in %.3fs\n", args[1],
+				seconds_since( &cache_start ) );
+		source.cache = &grid_cache;
+		source.mosaic = NULL;
+	} else if( use_mosaic || crop ) {
+		// Windows are read by row index, which the mosaic keeps for its inputs
+		source.mosaic = &mosaic;
+		if( !( use_mosaic ? mosaic_open( args[1], tilesize, &mosaic ) : mosaic_open_file( args[1], tilesize, &mosaic ) ) )
+			return EXIT_FAILURE;
+		if( crop && !mosaic_index_rows( &mosaic ) ) {
+			mosaic_close( &mosaic );
+			return EXIT_FAILURE;
+		}
+	} else if( !input_file_open( args[1], &in_file ) )
+		return EXIT_FAILURE;
+	printf( "Converting '%s':\nTilesize %d\nEllipsoid (%lf/%lf)\nTile format %s",
+			args[1], tilesize, semi_major, semi_minor, tile_format_name( format ) );
+	if( format == TILE_FORMAT_PNG )
+		printf( ", profile %s", png_profile->name );
+	if( lod )
+		printf( "\nLevels of detail, %s filter", lod_filter_name( lod_filter ) );
+	puts( "\n" );
 	srtm_header_t in_header;
 	in_header.tilesize = tilesize;
-	if( !read_srtm_ascii_header( in_file, &in_header ) )
-		fputs( "Error reading image header", stderr );
+	bool header_ok = true;
+	if( source.cache ) {
+		in_header = grid_cache.header;
+		in_header.tilesize = tilesize;
+		if( in_header.num_columns < tilesize || in_header.num_rows < tilesize ) {
+			fputs( "Error, tile size > size of the cached grid\n", stderr );
+			header_ok = false;
+		}
+	} else if( source.mosaic )
+		in_header = mosaic.header;
 	else {
+		source.pos = in_file.data;
+		if( !( header_ok = read_srtm_ascii_header( &source.pos, in_file.data + in_file.size, &in_header ) ) )
+			fputs( "Error reading image header\n", stderr );
+	}
+	run_stats_add( &run_stats, RUN_STAGE_HEADER, &header_timer,
+			source.cache || source.mosaic ? 0 : (uint64_t)( source.pos - in_file.data ), 0, 0 );
+	if( header_ok && crop ) {
+		// From here on the window is the raster
+		const srtm_header_t raster = in_header;
+		uint32_t col = window[0], row = window[1], width = window[2], height = window[3];
+		if( use_bbox && !srtm_header_window( &raster, &bbox, &col, &row, &width, &height ) ) {
+			fputs( "Error, bounding box is outside of the raster\n", stderr );
+			header_ok = false;
+		} else if( use_window && ( (uint64_t)col + width > raster.num_columns || (uint64_t)row + height > raster.num_rows ) ) {
+			fprintf( stderr, "Error, window reaches beyond the raster of %u/%u posts\n", raster.num_columns, raster.num_rows );
+			header_ok = false;
+		} else if( width < tilesize || height < tilesize ) {
+			fprintf( stderr, "Error, window of %u/%u posts is smaller than a tile\n", width, height );
+			header_ok = false;
+		} else {
+			srtm_header_crop( &raster, col, row, width, height, &in_header );
+			source.cropped = true;
+			source.col = col;
+			source.row = row;
+			printf( "Window of columns/rows %u/%u from %u/%u on, lower left lon %lf lat %lf\n", width, height,
+					col, row, in_header.longitude, in_header.latitude );
+		}
+	}
+	if( !header_ok ) {
+		row_source_close( &source );
+		return EXIT_FAILURE;
+	} else {
 		// convert lower left to cartesian
-		ellipsoid_t eps;
-		ellipsoid_create( semi_major, semi_major, semi_minor, &eps );
 		vec3d ll_cart;
 		const geodetic_t ll_geo = { in_header.longitude, in_header.latitude, 0.0 };
 		ellipsoid_to_cartesian( &ll_geo, &eps, &ll_cart );
 		printf( "\nLower left in cartesian coords: (%lf/%lf/%lf)\n", ll_cart.x, ll_cart.y, ll_cart.z );
-		uint16_t **image_data = NULL;
-		read_image( &image_data, &in_header, in_file );
-		fclose(in_file);
-		// Convert images
-		puts("Converting images ...");
 		// Filet the map into tiles starting at row/col
 		const uint32_t num_h_tiles = (uint32_t)floor(in_header.num_columns/tilesize);
 		const uint32_t num_v_tiles = (uint32_t)floor(in_header.num_rows/tilesize);
@@ -259,29 +1237,138 @@ int main( int argc, char *argv[argc+1] ) {
 		const uint32_t num_tiles = num_h_tiles * num_v_tiles;
 		uint32_t start_row[num_tiles];
 		uint32_t start_col[num_tiles];
+		/* Calculate start rows/columns for each tile. The last column/top row must overlap so that the new one
+		 * starts on the row/column on which the old one ended or there will be gaps between tiles when rendering.
+		 * Normals need the posts around a tile as well; normal maps read them from the neighbouring tiles in
+		 * image_data instead of tiles overlapping more, see normal_map.h. */
 		int k = 0;
-		for( uint32_t i = 0; i < num_h_tiles; ++i ) {
-			for( uint32_t j = 0; j < num_v_tiles; ++j ) {
-				// @todo is this right ? 1 overlap ?
+		for( uint32_t i = 0; i < num_v_tiles; ++i ) {
+			for( uint32_t j = 0; j < num_h_tiles; ++j ) {
 				start_row[k] = i*(tilesize-1);
 				start_col[k] = j*(tilesize-1);
 				printf("\tTile %d, starting at col/row %d/%d\n", k, start_col[k], start_row[k] );
 				++k;
 			}
 		}
-		// Make room for tile data
-		uint16_t **image;
-		image = malloc(sizeof(uint16_t*)*tilesize);
-		for( uint32_t row = 0; row < tilesize; ++row )
-			image[row] = malloc(sizeof(uint16_t)*tilesize);
-		// copy over the tile window from the image data, determine min/max values
-		for( uint32_t tile = 0; tile < num_tiles; ++tile )
-			write_tile( tile, &in_header, start_row, start_col, image_data, image );
+		// Make room for tile data, one per worker
+		tile_scratch_t scratch[num_threads];
+		bool ok = true;
+		for( unsigned i = 0; i < num_threads; ++i ) {
+			ok &= height_grid_create( tilesize, tilesize, false, &scratch[i].image );
+			byte_buffer_init( &scratch[i].encoded );
+			ok &= minmax_tree_create( tilesize, MINMAX_TREE_PATCH_SIZE, &scratch[i].tree );
+			byte_buffer_init( &scratch[i].tree_encoded );
+			byte_buffer_init( &scratch[i].mesh );
+			ok &= ellipsoid_columns_create( tilesize + 2, &scratch[i].columns );
+			scratch[i].halo = (height_grid_t){ 0 };
+			if( mesh || normals )
+				ok &= height_grid_create( tilesize + 2 * normal_halo + 2, tilesize + 2 * normal_halo + 2, false,
+						&scratch[i].halo );
+			byte_buffer_init( &scratch[i].normals );
+			run_stats_init( &scratch[i].stats );
+			scratch[i].num_skipped = 0;
+		}
+		// Level 0 tiles come first in the container, then those of each coarser level
+		const uint32_t num_levels = lod ? lod_num_levels( num_h_tiles, num_v_tiles ) : 1;
+		uint32_t num_packed = 0;
+		for( uint32_t level = 0; level < num_levels; ++level )
+			num_packed += lod_level_tiles( num_h_tiles, level ) * lod_level_tiles( num_v_tiles, level );
+		const size_t num_leaves = (size_t)scratch[0].tree.leaves * scratch[0].tree.leaves;
+		uint16_t *leaves = malloc( 2 * num_tiles * num_leaves * sizeof(uint16_t) );
+		ok &= leaves != NULL;
+		tile_pack_t pack;
+		tile_manifest_t manifest;
+		tile_jobs_t jobs = {
+				.header = &in_header, .start_row = start_row, .start_col = start_col,
+				.format = format, .png_profile = png_profile, .ellipsoid = &eps,
+				.mesh = mesh, .mesh_attributes = mesh_attributes, .normals = normals, .normal_halo = normal_halo,
+				.pack = pack_path ? &pack : NULL, .skip_void = skip_void, .num_h_tiles = num_h_tiles,
+				.num_v_tiles = num_v_tiles, .leaf_min = leaves, .leaf_max = leaves + num_tiles * num_leaves,
+				.scratch = scratch
+		};
+		if( !ok ) {
+			fputs( "Error allocating memory for tile data\n", stderr );
+			jobs.pack = NULL;
+		} else if( jobs.pack && !tile_pack_create( pack_path, &in_header, num_packed, &pack ) ) {
+			fprintf( stderr, "Error creating tile container '%s'\n", pack_path );
+			jobs.pack = NULL;
+			ok = false;
+		} else if( !jobs.pack && !open_manifest( &in_header, format, png_profile, lod ? lod_filter_name( lod_filter ) : "none",
+				&eps, mesh, mesh_attributes, normals, normal_halo, rebuild, num_packed, &manifest ) ) {
+			ok = false;
+		} else if( streaming ) {
+			jobs.manifest = jobs.pack ? NULL : &manifest;
+			puts("Converting images while reading ...");
+			ok = convert_streaming( &jobs, &source, num_h_tiles, num_v_tiles, num_threads, &run_stats );
+		} else {
+			jobs.manifest = jobs.pack ? NULL : &manifest;
+			height_grid_t image_data;
+			if( source.cache ) {
+				// A view of the mapping, destroying it leaves the mapping alone
+				height_grid_view( &grid_cache.grid, source.col, source.row, in_header.num_columns, in_header.num_rows,
+						&image_data );
+			} else {
+				ok = read_image( &image_data, &in_header, &source, num_threads, &run_stats );
+				clock_gettime( CLOCK_MONOTONIC, &cache_start );
+				// Only the whole raster, a window would stand in for it in later runs
+				if( ok && use_grid_cache && !source.cropped &&
+					grid_cache_save( args[1], &in_header, &image_data, fingerprint ) )
+					printf( "Saved the parsed grid to '%s.int16' in %.3fs\n", args[1], seconds_since( &cache_start ) );
+				else if( ok && use_grid_cache && !source.cropped )
+					fprintf( stderr, "Warning, could not save the parsed grid to '%s.int16'\n", args[1] );
+			}
+			if( ok ) {
+				// Convert images
+				printf( "Converting images with %u threads ...\n", num_threads );
+				// copy over the tile window from the image data, determine min/max values
+				jobs.image_data = &image_data;
+				ok = tile_pool_run( num_threads, num_tiles, write_tile_job, &jobs );
+			}
+			if( ok && lod )
+				ok = write_lod_levels( &jobs, &image_data, num_h_tiles, num_v_tiles, lod_filter, num_threads, &run_stats );
+			height_grid_destroy( &image_data );
+		}
+		if( jobs.pack ) {
+			// Index and header go in last, also when a tile failed so the file stays readable
+			if( !tile_pack_finish( &pack ) ) {
+				fprintf( stderr, "Error writing index of tile container '%s'\n", pack_path );
+				ok = false;
+			} else if( ok )
+				printf( "Packed %u tiles into '%s'\n", num_packed, pack_path );
+		}
+		if( jobs.manifest ) {
+			// Also after an error, for the tiles that made it
+			const uint32_t num_kept = tile_manifest_count( &manifest, TILE_STATE_KEPT );
+			printf( "Wrote %u tiles, kept %u unchanged ones\n", tile_manifest_count( &manifest, TILE_STATE_WRITTEN ),
+					num_kept );
+			ok &= tile_manifest_save( &manifest );
+			tile_manifest_close( &manifest );
+		}
+		uint32_t num_skipped = 0;
+		for( unsigned i = 0; i < num_threads; ++i )
+			num_skipped += scratch[i].num_skipped;
+		if( num_skipped > 0 )
+			printf( "Skipped %u tiles with at least %u%% of no data or sea posts\n", num_skipped, skip_void );
 		// cleanup
-		for( uint32_t row = 0; row < tilesize; ++row )
-			free(image[row]);
-		free(image);
-		free_image_data( image_data, &in_header );
+		row_source_close( &source );
+		free( leaves );
+		for( unsigned i = 0; i < num_threads; ++i ) {
+			run_stats_merge( &run_stats, &scratch[i].stats );
+			height_grid_destroy( &scratch[i].image );
+			byte_buffer_free( &scratch[i].encoded );
+			minmax_tree_destroy( &scratch[i].tree );
+			byte_buffer_free( &scratch[i].tree_encoded );
+			byte_buffer_free( &scratch[i].mesh );
+			ellipsoid_columns_destroy( &scratch[i].columns );
+			height_grid_destroy( &scratch[i].halo );
+			byte_buffer_free( &scratch[i].normals );
+		}
+		// Also of a failed run, to see how far it came
+		if( stats_path && !write_stats( &run_stats, stats_path, &run_start, args[1], tilesize, num_threads, format,
+				png_profile ) )
+			ok = false;
+		if( !ok )
+			return EXIT_FAILURE;
 	}
 	puts("\nConverter ending.");
 	return EXIT_SUCCESS;